@@ -49,6 +49,8 @@ LOCAL_SRC_FILES := \
   src/node_file.cc \
   src/node_http_parser.cc \
   src/node_io_watcher.cc \
+  src/node_object_pool.cc \
+  src/node_zlib.cc \
   src/node_javascript.cc \
   src/node_net.cc \
   src/node_os.cc \
@@ -91,6 +93,7 @@ LOCAL_C_INCLUDES += \
    bionic/libc/include \
    bionic/libc/include/sys \
    external/openssl/include \
+   external/zlib \
    $(LOCAL_PATH)/deps/uv/include \
    $(LOCAL_PATH)/deps/uv/src/ev \
    $(LOCAL_PATH)/deps/uv/src/ares \
@@ -104,7 +107,7 @@ LOCAL_C_INCLUDES += \
 
 
 LOCAL_STATIC_LIBRARIES := libcares
-LOCAL_SHARED_LIBRARIES := libcutils libdl libssl libcrypto libstlport
+LOCAL_SHARED_LIBRARIES := libcutils libdl libssl libcrypto libstlport libz
 
 # dynamic linkage to v8
 ifeq ($(DYNAMIC_SHARED_LIBV8SO),true)
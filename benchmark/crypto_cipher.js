@@ -0,0 +1,57 @@
+// Throughput of the synchronous and the asynchronous (thread pool) cipher
+// paths for a few input sizes, and the resident set size after each run:
+// the asynchronous run queues all of its updates at once.
+//
+//   node benchmark/crypto_cipher.js [aes-128-cbc|aes-128-ctr]
+
+var crypto = require('crypto');
+
+var algorithm = process.argv[2] || 'aes-128-cbc';
+var key = new Buffer('0123456789abcdef').toString('binary');
+var iv = new Buffer('fedcba9876543210').toString('binary');
+var total = 64 * 1024 * 1024;
+var sizes = [1024, 16 * 1024, 256 * 1024, 1024 * 1024, 16 * 1024 * 1024];
+
+function report(mode, size, start) {
+  var elapsed = (Date.now() - start) / 1000;
+  console.log('%s %s %d bytes: %d MB/s, rss %d MB', algorithm, mode, size,
+              (total / elapsed / (1024 * 1024)).toFixed(1),
+              (process.memoryUsage().rss / (1024 * 1024)).toFixed(1));
+}
+
+function sync(size) {
+  var data = new Buffer(size);
+  var n = Math.max(1, total / size);
+  var start = Date.now();
+  var cipher = crypto.createCipheriv(algorithm, key, iv);
+  for (var i = 0; i < n; i++) {
+    cipher.update(data);
+  }
+  cipher.final();
+  report('sync', size, start);
+}
+
+function async(size, cb) {
+  var data = new Buffer(size);
+  var n = Math.max(1, total / size);
+  var start = Date.now();
+  var cipher = crypto.createCipheriv(algorithm, key, iv);
+  for (var i = 0; i < n; i++) {
+    cipher.update(data, function(err) {
+      if (err) throw err;
+    });
+  }
+  cipher.final(function(err) {
+    if (err) throw err;
+    report('async', size, start);
+    cb();
+  });
+}
+
+var i = 0;
+(function next() {
+  if (i == sizes.length) return;
+  var size = sizes[i++];
+  sync(size);
+  async(size, next);
+})();
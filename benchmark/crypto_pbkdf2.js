@@ -0,0 +1,65 @@
+// crypto.pbkdf2() on the thread pool against PBKDF2 written with
+// crypto.createHmac(), for a few iteration counts. The loop is also timed
+// with a ticker: the JS version blocks it, the native one doesn't.
+//
+//   node benchmark/crypto_pbkdf2.js
+
+var crypto = require('crypto');
+
+var password = 'correct horse battery staple';
+var salt = 'NaCl';
+var keylen = 32;
+var iterations = [1000, 10000, 50000];
+
+function xor(a, b) {
+  var out = '';
+  for (var i = 0; i < a.length; i++) {
+    out += String.fromCharCode(a.charCodeAt(i) ^ b.charCodeAt(i));
+  }
+  return out;
+}
+
+function pbkdf2JS(password, salt, iterations, keylen) {
+  var key = '';
+  for (var block = 1; key.length < keylen; block++) {
+    var index = String.fromCharCode((block >>> 24) & 0xff,
+                                    (block >>> 16) & 0xff,
+                                    (block >>> 8) & 0xff,
+                                    block & 0xff);
+    var u = crypto.createHmac('sha1', password)
+                  .update(salt + index)
+                  .digest('binary');
+    var t = u;
+    for (var i = 1; i < iterations; i++) {
+      u = crypto.createHmac('sha1', password).update(u).digest('binary');
+      t = xor(t, u);
+    }
+    key += t;
+  }
+  return key.slice(0, keylen);
+}
+
+function run(n, cb) {
+  var start = Date.now();
+  var js = pbkdf2JS(password, salt, n, keylen);
+  console.log('js     %d iterations: %d ms', n, Date.now() - start);
+
+  var ticks = 0;
+  var ticker = setInterval(function() { ticks++; }, 1);
+
+  start = Date.now();
+  crypto.pbkdf2(password, salt, n, keylen, function(err, key) {
+    if (err) throw err;
+    clearInterval(ticker);
+    if (key !== js) throw new Error('keys differ');
+    console.log('native %d iterations: %d ms, %d loop ticks meanwhile',
+                n, Date.now() - start, ticks);
+    cb();
+  });
+}
+
+var i = 0;
+(function next() {
+  if (i == iterations.length) return;
+  run(iterations[i++], next);
+})();
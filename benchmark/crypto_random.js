@@ -0,0 +1,60 @@
+// Random bytes from crypto.randomBytes(), synchronous and on the thread
+// pool, against filling a Buffer from Math.random().
+//
+//   node benchmark/crypto_random.js
+
+var crypto = require('crypto');
+
+var total = 16 * 1024 * 1024;
+var sizes = [16, 256, 4096, 64 * 1024];
+
+function report(mode, size, start) {
+  var elapsed = (Date.now() - start) / 1000;
+  console.log('%s %d bytes: %d MB/s', mode, size,
+              (total / elapsed / (1024 * 1024)).toFixed(1));
+}
+
+function mathRandom(size) {
+  var n = total / size;
+  var start = Date.now();
+  for (var i = 0; i < n; i++) {
+    var buf = new Buffer(size);
+    for (var j = 0; j < size; j++) {
+      buf[j] = Math.floor(Math.random() * 256);
+    }
+  }
+  report('Math.random', size, start);
+}
+
+function sync(size) {
+  var n = total / size;
+  var start = Date.now();
+  for (var i = 0; i < n; i++) {
+    crypto.randomBytes(size);
+  }
+  report('randomBytes sync', size, start);
+}
+
+function async(size, cb) {
+  var n = total / size;
+  var left = n;
+  var start = Date.now();
+  for (var i = 0; i < n; i++) {
+    crypto.randomBytes(size, function(err) {
+      if (err) throw err;
+      if (--left == 0) {
+        report('randomBytes async', size, start);
+        cb();
+      }
+    });
+  }
+}
+
+var i = 0;
+(function next() {
+  if (i == sizes.length) return;
+  var size = sizes[i++];
+  mathRandom(size);
+  sync(size);
+  async(size, next);
+})();
@@ -1,48 +1,65 @@
+// Serves a file with fs.createReadStream().pipe(res) and reports the
+// throughput seen by the clients.
+//
+//   node benchmark/static_http_server.js          # sendfile() fast path
+//   node benchmark/static_http_server.js read     # read()/write() through JS
 var http = require("http");
+var fs = require("fs");
+var Buffer = require("buffer").Buffer;
+
+var useSendfile = process.argv[2] != "read";
 
 var concurrency = 30;
 var port = 12346;
-var n = 7; // several orders of magnitude slower
-var bytes = 1024*5;
+var n = 700;
+var bytes = 1024*1024;
+var path = "/tmp/static_http_server.dat";
 
 var requests = 0;
 var responses = 0;
+var received = 0;
 
-var body = "";
+var body = new Buffer(bytes);
 for (var i = 0; i < bytes; i++) {
-  body += "C";
+  body[i] = 67; // "C"
 }
+fs.writeFileSync(path, body);
 
 var server = http.createServer(function (req, res) {
   res.writeHead(200, {
     "Content-Type": "text/plain",
-    "Content-Length": body.length
-  });
-  res.write(body);
-  res.close();
-})
-server.listen(port);
-
-function responseListener (res) {
-  res.addListener("end", function () {
-    if (requests < n) {
-      var req = res.client.request("/");
-      req.addListener('response', responseListener);
-      req.close();
-      requests++;
-    }
-
-    if (++responses == n) {
-      server.close();
-    }
+    "Content-Length": bytes
   });
-}
+  fs.createReadStream(path, { sendfile: useSendfile }).pipe(res);
+});
+
+var start;
 
-for (var i = 0; i < concurrency; i++) {
-  var client = http.createClient(port);
-  client.id = i;
-  var req = client.request("/");
-  req.addListener('response', responseListener);
-  req.close();
+function get() {
   requests++;
+  http.get({ port: port, path: "/" }, function (res) {
+    res.on("data", function (d) {
+      received += d.length;
+    });
+    res.on("end", function () {
+      if (requests < n) get();
+
+      if (++responses == n) {
+        var elapsed = (new Date() - start) / 1000;
+        console.log("%s: %d responses, %d bytes in %ds: %d mB/s",
+                    useSendfile ? "sendfile" : "read/write",
+                    responses, received, elapsed,
+                    Math.round(received / elapsed / 1048576));
+        server.close();
+        fs.unlinkSync(path);
+      }
+    });
+  });
 }
+
+server.listen(port, function () {
+  start = new Date();
+  for (var i = 0; i < concurrency; i++) {
+    get();
+  }
+});
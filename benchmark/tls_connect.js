@@ -0,0 +1,51 @@
+// Latency of TLS connections to a local server, the first one on its own.
+// The client does not pass a CA, so it uses the built-in root
+// certificates.
+//
+//   node benchmark/tls_connect.js [connections]
+
+var tls = require('tls');
+var fs = require('fs');
+var path = require('path');
+
+var start = Date.now();
+var fixtures = path.join(__dirname, '../test/fixtures/keys');
+var options = {
+  key: fs.readFileSync(path.join(fixtures, 'agent1-key.pem')),
+  cert: fs.readFileSync(path.join(fixtures, 'agent1-cert.pem'))
+};
+var port = 12346;
+var n = parseInt(process.argv[2], 10) || 100;
+
+var server = tls.createServer(options, function(s) {
+  s.end();
+});
+
+function connect(cb) {
+  var t = Date.now();
+  var c = tls.connect(port, function() {
+    c.end();
+    cb(Date.now() - t);
+  });
+}
+
+server.listen(port, function() {
+  connect(function(first) {
+    console.log('first connection: %d ms (%d ms after startup)',
+                first, Date.now() - start);
+    var total = 0;
+    var i = 0;
+    (function next() {
+      if (i++ == n) {
+        console.log('%d more: %d ms per connection',
+                    n, (total / n).toFixed(2));
+        server.close();
+        return;
+      }
+      connect(function(t) {
+        total += t;
+        next();
+      });
+    })();
+  });
+});
@@ -25,6 +25,13 @@
 #include <assert.h>
 #include <stddef.h>
 
+#if defined(__SSE4_2__)
+# include <nmmintrin.h>
+# define HTTP_PARSER_SSE42 1
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+# include <arm_neon.h>
+# define HTTP_PARSER_NEON 1
+#endif
 
 #ifndef MIN
 # define MIN(a,b) ((a) < (b) ? (a) : (b))
@@ -326,6 +333,114 @@ enum header_states
 #endif
 
 
+/* Header values and URLs are mostly runs of bytes that the state machine
+ * looks at only to find where they end. The helpers below find that end
+ * 16 bytes at a time where the CPU can do it (SSE4.2 or NEON) and finish
+ * the tail byte by byte. Both return pe if there is no delimiter in
+ * [p, pe).
+ */
+
+/* First CR or LF. */
+static const char *find_crlf(const char *p, const char *pe)
+{
+#if HTTP_PARSER_SSE42
+  const __m128i set = _mm_setr_epi8(CR, LF, 0, 0, 0, 0, 0, 0,
+                                    0, 0, 0, 0, 0, 0, 0, 0);
+
+  for (; pe - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    int i = _mm_cmpestri(set, 2, v, 16,
+                         _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY |
+                         _SIDD_LEAST_SIGNIFICANT);
+    if (i != 16) return p + i;
+  }
+#elif HTTP_PARSER_NEON
+  const uint8x16_t cr = vdupq_n_u8(CR);
+  const uint8x16_t lf = vdupq_n_u8(LF);
+
+  for (; pe - p >= 16; p += 16) {
+    uint8x16_t v = vld1q_u8((const uint8_t *) p);
+    uint8x16_t m = vorrq_u8(vceqq_u8(v, cr), vceqq_u8(v, lf));
+    /* Narrow to 4 bits per byte so the match mask fits in 64 bits. */
+    uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(
+        vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+    if (bits) return p + (__builtin_ctzll(bits) >> 2);
+  }
+#endif
+
+  for (; p != pe; p++) {
+    if (*p == CR || *p == LF) return p;
+  }
+  return pe;
+}
+
+
+/* First byte that is not IS_URL_CHAR(). */
+static const char *skip_url_chars(const char *p, const char *pe)
+{
+#if HTTP_PARSER_SSE42
+  /* Ranges of normal_url_char, plus the high half in non-strict mode. */
+# if HTTP_PARSER_STRICT
+  const __m128i ranges = _mm_setr_epi8(0x21, 0x22, 0x24, 0x3e, 0x40, 0x7e,
+                                       0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  const int nranges = 6;
+# else
+  const __m128i ranges = _mm_setr_epi8(0x21, 0x22, 0x24, 0x3e, 0x40, 0x7e,
+                                       (char) 0x80, (char) 0xff,
+                                       0, 0, 0, 0, 0, 0, 0, 0);
+  const int nranges = 8;
+# endif
+
+  for (; pe - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    int i = _mm_cmpestri(ranges, nranges, v, 16,
+                         _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES |
+                         _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT);
+    if (i != 16) return p + i;
+  }
+#elif HTTP_PARSER_NEON
+  const uint8x16_t sp = vdupq_n_u8(' ');
+  const uint8x16_t hash = vdupq_n_u8('#');
+  const uint8x16_t question = vdupq_n_u8('?');
+  const uint8x16_t del = vdupq_n_u8(0x7f);
+
+  for (; pe - p >= 16; p += 16) {
+    uint8x16_t v = vld1q_u8((const uint8_t *) p);
+    uint8x16_t m = vorrq_u8(vcleq_u8(v, sp),
+                            vorrq_u8(vceqq_u8(v, hash), vceqq_u8(v, question)));
+# if HTTP_PARSER_STRICT
+    m = vorrq_u8(m, vcgeq_u8(v, del));
+# else
+    m = vorrq_u8(m, vceqq_u8(v, del));
+# endif
+    uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(
+        vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+    if (bits) return p + (__builtin_ctzll(bits) >> 2);
+  }
+#endif
+
+  for (; p != pe; p++) {
+    if (!IS_URL_CHAR(*p)) return p;
+  }
+  return pe;
+}
+
+
+/* Consume everything up to (not including) q in one step. Leaves p on the
+ * last skipped byte so that the main loop's p++ lands on q, and keeps the
+ * header size limit honest.
+ */
+#define SKIP_TO(q)                                                   \
+do {                                                                 \
+  const char *q_ = (q);                                              \
+  if (PARSING_HEADER(state)) {                                       \
+    nread += q_ - (p + 1);                                           \
+    if (nread > HTTP_MAX_HEADER_SIZE) goto error;                    \
+  }                                                                  \
+  p = q_ - 1;                                                        \
+} while (0)
+
+
 size_t http_parser_execute (http_parser *parser,
                             const http_parser_settings *settings,
                             const char *data,
@@ -764,7 +879,10 @@ size_t http_parser_execute (http_parser *parser,
 
       case s_req_path:
       {
-        if (IS_URL_CHAR(ch)) break;
+        if (IS_URL_CHAR(ch)) {
+          SKIP_TO(skip_url_chars(p + 1, pe));
+          break;
+        }
 
         switch (ch) {
           case ' ':
@@ -838,7 +956,10 @@ size_t http_parser_execute (http_parser *parser,
 
       case s_req_query_string:
       {
-        if (IS_URL_CHAR(ch)) break;
+        if (IS_URL_CHAR(ch)) {
+          SKIP_TO(skip_url_chars(p + 1, pe));
+          break;
+        }
 
         switch (ch) {
           case '?':
@@ -912,7 +1033,10 @@ size_t http_parser_execute (http_parser *parser,
 
       case s_req_fragment:
       {
-        if (IS_URL_CHAR(ch)) break;
+        if (IS_URL_CHAR(ch)) {
+          SKIP_TO(skip_url_chars(p + 1, pe));
+          break;
+        }
 
         switch (ch) {
           case ' ':
@@ -1294,6 +1418,7 @@ size_t http_parser_execute (http_parser *parser,
 
         switch (header_state) {
           case h_general:
+            SKIP_TO(find_crlf(p + 1, pe));
             break;
 
           case h_connection:
@@ -1518,6 +1643,7 @@ size_t http_parser_execute (http_parser *parser,
           state = s_chunk_size_almost_done;
           break;
         }
+        SKIP_TO(find_crlf(p + 1, pe));
         break;
       }
 
@@ -67,6 +67,7 @@ typedef struct {
   int delayed_error; \
   uv_connection_cb connection_cb; \
   int accepted_fd; \
+  int accept_batch; \
   uv_req_t *connect_req; \
   uv_req_t *shutdown_req; \
   ev_io read_watcher; \
@@ -288,6 +288,30 @@ int uv_tcp_connect6(uv_req_t* req, struct sockaddr_in6);
 
 int uv_tcp_listen(uv_tcp_t* handle, int backlog, uv_connection_cb cb);
 
+/*
+ * Limit the number of connections accepted per readiness event on a
+ * listening handle to `batch`. After the last connection of a batch (the
+ * limit was reached or the listen queue is empty) the connection callback
+ * is made once more with status 1 so the user can flush the connections it
+ * collected. A batch of 0, the default, accepts until the queue is empty and
+ * never signals the end of a batch.
+ */
+int uv_tcp_accept_batch(uv_tcp_t* handle, int batch);
+
+/*
+ * Set SO_REUSEPORT on the handle so that several processes or threads can
+ * each bind a listening socket to the same address and port. Call it before
+ * uv_tcp_bind. Fails with UV_ENOTSUP when the platform does not have it.
+ */
+int uv_tcp_reuseport(uv_tcp_t* handle, int enable);
+
+/*
+ * Set an integer socket option, e.g. TCP_CORK or SO_RCVBUF, on the handle's
+ * socket. The socket must exist, that is the handle must have been bound,
+ * connected or accepted.
+ */
+int uv_tcp_setsockopt(uv_tcp_t* handle, int level, int optname, int value);
+
 
 /*
  * Subclass of uv_handle_t. libev wrapper. Every active prepare handle gets
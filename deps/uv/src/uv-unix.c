@@ -73,7 +73,8 @@ enum {
   UV_CLOSED   = 0x00000002, /* close(2) finished. */
   UV_READING  = 0x00000004, /* uv_read_start() called. */
   UV_SHUTTING = 0x00000008, /* uv_shutdown() called but not complete. */
-  UV_SHUT     = 0x00000010  /* Write side closed. */
+  UV_SHUT     = 0x00000010, /* Write side closed. */
+  UV_REUSEPORT = 0x00000020 /* Set SO_REUSEPORT before bind(2). */
 };
 
 
@@ -138,6 +139,9 @@ static uv_err_code uv_translate_sys_error(int sys_errno) {
     case ECONNREFUSED: return UV_ECONNREFUSED;
     case EADDRINUSE: return UV_EADDRINUSE;
     case EADDRNOTAVAIL: return UV_EADDRNOTAVAIL;
+    case ENOPROTOOPT: return UV_ENOPROTOOPT;
+    case ENOTSUP: return UV_ENOTSUP;
+    case EBADF: return UV_EBADF;
     default: return UV_UNKNOWN;
   }
 }
@@ -254,6 +258,7 @@ int uv_tcp_init(uv_tcp_t* tcp) {
   tcp->alloc_cb = NULL;
   tcp->connect_req = NULL;
   tcp->accepted_fd = -1;
+  tcp->accept_batch = 0;
   tcp->fd = -1;
   tcp->delayed_error = 0;
   ngx_queue_init(&tcp->write_queue);
@@ -289,6 +294,16 @@ int uv__bind(uv_tcp_t* tcp, int domain, struct sockaddr* addr, int addrsize) {
       close(fd);
       return -2;
     }
+
+#ifdef SO_REUSEPORT
+    if (uv_flag_is_set((uv_handle_t*)tcp, UV_REUSEPORT)) {
+      int yes = 1;
+      if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(int))) {
+        uv_err_new((uv_handle_t*)tcp, errno);
+        return -1;
+      }
+    }
+#endif
   }
 
   assert(tcp->fd >= 0);
@@ -365,6 +380,7 @@ int uv_tcp_open(uv_tcp_t* tcp, int fd) {
 
 void uv__server_io(EV_P_ ev_io* watcher, int revents) {
   int fd;
+  int accepted = 0;
   struct sockaddr_storage addr;
   socklen_t addrlen = sizeof(struct sockaddr_storage);
   uv_tcp_t* tcp = watcher->data;
@@ -387,10 +403,10 @@ void uv__server_io(EV_P_ ev_io* watcher, int revents) {
     if (fd < 0) {
       if (errno == EAGAIN) {
         /* No problem. */
-        return;
+        break;
       } else if (errno == EMFILE) {
         /* TODO special trick. unlock reserved socket, accept, close. */
-        return;
+        break;
       } else {
         uv_err_new((uv_handle_t*)tcp, errno);
         tcp->connection_cb((uv_handle_t*)tcp, -1);
@@ -402,9 +418,23 @@ void uv__server_io(EV_P_ ev_io* watcher, int revents) {
       if (tcp->accepted_fd >= 0) {
         /* The user hasn't yet accepted called uv_accept() */
         ev_io_stop(EV_DEFAULT_ &tcp->read_watcher);
-        return;
+        break;
+      }
+      if (++accepted == tcp->accept_batch) {
+        /* Leave the rest of the listen queue for the next loop iteration. */
+        break;
       }
     }
+
+    if (uv_flag_is_set((uv_handle_t*)tcp, UV_CLOSING)) {
+      return;
+    }
+  }
+
+  if (tcp->accept_batch > 0 && accepted > 0 &&
+      !uv_flag_is_set((uv_handle_t*)tcp, UV_CLOSING)) {
+    /* Tell the user that this batch is complete. */
+    tcp->connection_cb((uv_handle_t*)tcp, 1);
   }
 }
 
@@ -431,6 +461,56 @@ int uv_accept(uv_handle_t* server, uv_stream_t* client) {
 }
 
 
+int uv_tcp_accept_batch(uv_tcp_t* tcp, int batch) {
+  if (batch < 0) {
+    uv_err_new((uv_handle_t*)tcp, EINVAL);
+    return -1;
+  }
+
+  tcp->accept_batch = batch;
+  return 0;
+}
+
+
+int uv_tcp_reuseport(uv_tcp_t* tcp, int enable) {
+#ifdef SO_REUSEPORT
+  if (enable) {
+    uv_flag_set((uv_handle_t*)tcp, UV_REUSEPORT);
+  } else {
+    uv_flag_unset((uv_handle_t*)tcp, UV_REUSEPORT);
+  }
+
+  /* The socket already exists, apply the option right away. */
+  if (tcp->fd >= 0) {
+    if (setsockopt(tcp->fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(int))) {
+      uv_err_new((uv_handle_t*)tcp, errno);
+      return -1;
+    }
+  }
+
+  return 0;
+#else
+  uv_err_new((uv_handle_t*)tcp, ENOTSUP);
+  return -1;
+#endif
+}
+
+
+int uv_tcp_setsockopt(uv_tcp_t* tcp, int level, int optname, int value) {
+  if (tcp->fd < 0) {
+    uv_err_new((uv_handle_t*)tcp, EBADF);
+    return -1;
+  }
+
+  if (setsockopt(tcp->fd, level, optname, &value, sizeof(int))) {
+    uv_err_new((uv_handle_t*)tcp, errno);
+    return -1;
+  }
+
+  return 0;
+}
+
+
 int uv_tcp_listen(uv_tcp_t* tcp, int backlog, uv_connection_cb cb) {
   int r;
 
@@ -998,6 +998,35 @@ int uv_tcp_listen(uv_tcp_t* handle, int backlog, uv_connection_cb cb) {
 }
 
 
+int uv_tcp_accept_batch(uv_tcp_t* handle, int batch) {
+  /* Accepts complete one at a time through the completion port. */
+  uv_set_sys_error(WSAEOPNOTSUPP);
+  return -1;
+}
+
+
+int uv_tcp_reuseport(uv_tcp_t* handle, int enable) {
+  uv_set_sys_error(WSAEOPNOTSUPP);
+  return -1;
+}
+
+
+int uv_tcp_setsockopt(uv_tcp_t* handle, int level, int optname, int value) {
+  if (handle->socket == INVALID_SOCKET) {
+    uv_set_sys_error(WSAENOTSOCK);
+    return -1;
+  }
+
+  if (setsockopt(handle->socket, level, optname, (const char*)&value,
+      sizeof(int)) == SOCKET_ERROR) {
+    uv_set_sys_error(WSAGetLastError());
+    return -1;
+  }
+
+  return 0;
+}
+
+
 int uv_accept(uv_handle_t* server, uv_stream_t* client) {
   int rv = 0;
   uv_tcp_t* tcpServer = (uv_tcp_t*)server;
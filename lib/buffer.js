@@ -40,21 +40,6 @@ SlowBuffer.prototype.inspect = function() {
 };
 
 
-SlowBuffer.prototype.hexSlice = function(start, end) {
-  var len = this.length;
-
-  if (!start || start < 0) start = 0;
-  if (!end || end < 0 || end > len) end = len;
-
-  var out = '';
-  for (var i = start; i < end; i++) {
-    out += toHex(this[i]);
-  }
-  return out;
-};
-
-
-
 SlowBuffer.prototype.toString = function(encoding, start, end) {
   encoding = String(encoding || 'utf8').toLowerCase();
   start = +start || 0;
@@ -92,23 +77,6 @@ SlowBuffer.prototype.toString = function(encoding, start, end) {
 };
 
 
-SlowBuffer.prototype.hexWrite = function(string, offset) {
-  var len = string.length;
-  offset = +offset || 0;
-
-  // must be an even number of digits
-  if (len % 2) {
-    throw new Error('Invalid hex string');
-  }
-  for (var i = 0; i < len / 2; i++) {
-    var byte = parseInt(string.substr(i * 2, 2), 16);
-    if (isNaN(byte)) throw new Error('Invalid hex string');
-    this[offset + i] = byte;
-  }
-  return i;
-};
-
-
 SlowBuffer.prototype.write = function(string, offset, encoding) {
   // Support both (string, offset, encoding)
   // and the legacy (string, encoding, offset)
@@ -77,7 +77,9 @@ exports.createCredentials = function(options, context) {
 
   if (options.cert) c.context.setCert(options.cert);
 
-  if (options.ciphers) c.context.setCiphers(options.ciphers);
+  if (options.ciphers && !c.context.setCiphers(options.ciphers)) {
+    throw new Error('Invalid ciphers: ' + options.ciphers);
+  }
 
   if (options.ca) {
     if (Array.isArray(options.ca)) {
@@ -105,18 +107,163 @@ exports.createCredentials = function(options, context) {
 };
 
 
+// The options createCredentials() builds the SSL_CTX from.
+var credentialsFields = ['secureProtocol', 'secureOptions', 'key', 'cert',
+                         'ciphers', 'ca', 'crl'];
+
+
+// Credentials by a digest of their options. Connections that are set up
+// the same way share one SSL_CTX, and the keys and certificates are only
+// parsed once. The least recently used one goes when there are more than
+// max. The contexts must not be changed after they have been handed out.
+function CredentialsCache(max) {
+  this.max = typeof max == 'number' ? max : 32;
+  this.credentials = {};
+  this.keys = [];
+  this.stats = { hits: 0, misses: 0 };
+}
+exports.CredentialsCache = CredentialsCache;
+
+
+CredentialsCache.prototype.digest = function(options) {
+  var hash = new Hash('sha1');
+
+  function update(name, value) {
+    if (Buffer.isBuffer(value)) {
+      hash.update(name + ':' + value.length + ':');
+      hash.update(value);
+    } else {
+      value = String(value);
+      hash.update(name + ':' + Buffer.byteLength(value) + ':');
+      hash.update(value, 'utf8');
+    }
+  }
+
+  for (var i = 0; i < credentialsFields.length; i++) {
+    var name = credentialsFields[i];
+    var value = options[name];
+    if (!value) continue;
+
+    if (Array.isArray(value)) {
+      for (var j = 0; j < value.length; j++) update(name, value[j]);
+    } else {
+      update(name, value);
+    }
+  }
+
+  return hash.digest('hex');
+};
+
+
+CredentialsCache.prototype.get = function(options) {
+  if (!options) options = {};
+
+  if (this.max <= 0) return exports.createCredentials(options);
+
+  var key = this.digest(options);
+  var c = this.credentials[key];
+
+  if (c) {
+    this.stats.hits++;
+    this.keys.splice(this.keys.indexOf(key), 1);
+  } else {
+    this.stats.misses++;
+    c = this.credentials[key] = exports.createCredentials(options);
+    if (this.keys.length >= this.max) {
+      delete this.credentials[this.keys.shift()];
+    }
+  }
+  this.keys.push(key);
+
+  return c;
+};
+
+
+CredentialsCache.prototype.clear = function() {
+  this.credentials = {};
+  this.keys = [];
+};
+
+
+// The cache tls.connect() and tls.createSecurePair() take their
+// credentials from.
+exports.sharedCredentials = new CredentialsCache();
+
+
 exports.Hash = Hash;
 exports.createHash = function(hash) {
   return new Hash(hash);
 };
 
 
+// Hashes a whole file on the thread pool.
+exports.hashFile = function(path, algorithm, encoding, callback) {
+  if (typeof encoding === 'function') {
+    callback = encoding;
+    encoding = undefined;
+  }
+  binding.hashFile(path, algorithm, encoding, callback);
+};
+
+
+// randomBytes(size, [callback]): a Buffer of cryptographically strong
+// random bytes, filled on the thread pool when there is a callback. The
+// binding fills a SlowBuffer that holds nothing else.
+exports.randomBytes = function(size, callback) {
+  if (callback !== undefined && typeof callback !== 'function') {
+    throw new TypeError('Callback must be a function');
+  }
+  if (!callback) return binding.randomBytes(size).slice(0, size);
+
+  binding.randomBytes(size, function(err, bytes) {
+    if (err) return callback(err);
+    callback(null, bytes.slice(0, size));
+  });
+};
+
+
+// Derives a key of keylen bytes with PBKDF2 and HMAC-SHA1, on the thread
+// pool. The key is passed to the callback as a binary string.
+exports.pbkdf2 = function(password, salt, iterations, keylen, callback) {
+  binding.pbkdf2(password, salt, iterations, keylen, callback);
+};
+
+
 exports.Hmac = Hmac;
 exports.createHmac = function(hmac, key) {
   return (new Hmac).init(hmac, key);
 };
 
 
+// With a callback, update() and final() run on the thread pool, and the
+// binding calls back with the slab the output was written to, an offset
+// and a length, like tcp_wrap does with its reads.
+function sliceOutput(method) {
+  return function() {
+    var last = arguments.length - 1;
+    var callback = arguments[last];
+    if (typeof callback !== 'function') return method.apply(this, arguments);
+
+    var args = Array.prototype.slice.call(arguments);
+    args[last] = function(err, slab, offset, length) {
+      if (err) return callback(err);
+      callback(null, slab.slice(offset, offset + length));
+    };
+    return method.apply(this, args);
+  };
+}
+
+function sliceAsyncOutput(constructor) {
+  constructor.prototype.update = sliceOutput(constructor.prototype.update);
+  constructor.prototype.final = sliceOutput(constructor.prototype.final);
+}
+
+if (crypto) {
+  sliceAsyncOutput(Cipher);
+  sliceAsyncOutput(Decipher);
+}
+
+
 exports.Cipher = Cipher;
 exports.createCipher = function(cipher, key) {
   return (new Cipher).init(cipher, key);
@@ -150,7 +297,21 @@ exports.createVerify = function(algorithm) {
 };
 
 exports.DiffieHellman = DiffieHellman;
-exports.createDiffieHellman = function(size_or_key, enc) {
+// With a callback, the prime of the given length is generated on the thread
+// pool: createDiffieHellman(primeLength, function(err, dh) { ... }).
+exports.createDiffieHellman = function(size_or_key, enc, callback) {
+  if (typeof enc === 'function') {
+    callback = enc;
+    enc = undefined;
+  }
+  if (callback) {
+    if (typeof size_or_key !== 'number') {
+      throw new TypeError('Only a prime length can be generated asynchronously');
+    }
+    new DiffieHellman(size_or_key, callback);
+    return;
+  }
+
   if (!size_or_key) {
     return new DiffieHellman();
   } else if (!enc) {
@@ -160,3 +321,57 @@ exports.createDiffieHellman = function(size_or_key, enc) {
   }
 
 }
+
+
+// The ciphers and the digests OpenSSL knows, by the names createCipher()
+// and createHash() take.
+function lowerCaseNames(names) {
+  var seen = {};
+  return names.map(function(name) {
+    return name.toLowerCase();
+  }).filter(function(name) {
+    if (seen.hasOwnProperty(name)) return false;
+    return seen[name] = true;
+  });
+}
+
+exports.getCiphers = function() {
+  return lowerCaseNames(binding.getCiphers());
+};
+
+exports.getHashes = function() {
+  return lowerCaseNames(binding.getHashes());
+};
+
+
+// The hardware engines OpenSSL can use, as [{ id, name }]. setEngine(id,
+// [flags]) makes one the default, for the ENGINE_METHOD_* flags of
+// process.binding('constants'), or for everything.
+exports.getEngines = function() {
+  return binding.getEngines ? binding.getEngines() : [];
+};
+
+exports.setEngine = function(id, flags) {
+  if (!binding.setEngine) {
+    throw new Error('node.js not compiled with OpenSSL engine support.');
+  }
+  binding.setEngine(id, flags);
+};
+
+
+// What the device offers: the crypto extensions of the CPU, the engines,
+// and the throughput of a few algorithms in kilobytes per second. The
+// throughput is measured once per process at startup; the first call waits
+// for that if it is still running.
+exports.getCapabilities = function() {
+  return {
+    cpu: binding.getCPUFeatures(),
+    engines: exports.getEngines(),
+    throughput: binding.getThroughput()
+  };
+};
+
+
+// The cipher suites servers use unless they are given others: AES first
+// when the CPU has AES instructions, RC4 first otherwise.
+if (crypto) exports.DEFAULT_CIPHERS = binding.DEFAULT_CIPHERS;
@@ -30,18 +30,47 @@ var constants = process.binding('constants');
 
 var socket = binding.socket;
 var recvfrom = binding.recvfrom;
+var recvmmsg = binding.recvmmsg;
+var sendmmsg = binding.sendmmsg;
 var close = binding.close;
 
 var ENOENT = constants.ENOENT;
 
+var SocketAddress = binding.SocketAddress;
+
 function isPort(x) { return parseInt(x) >= 0; }
+
+// Parsed destination addresses. Senders usually talk to the same few
+// peers, so keep the sockaddr around instead of parsing the ip again on
+// every send.
+var addressCache = {};
+var addressCacheSize = 0;
+var kAddressCacheMax = 128;
+
+function getAddress(port, addr) {
+  var key = addr + ':' + port;
+  var a = addressCache[key];
+
+  if (!a) {
+    if (addressCacheSize >= kAddressCacheMax) {
+      addressCache = {};
+      addressCacheSize = 0;
+    }
+    a = addressCache[key] = new SocketAddress(port, addr);
+    addressCacheSize++;
+  }
+
+  return a;
+}
 var pool = null;
 
-function getPool() {
-  /* TODO: this effectively limits you to 8kb maximum packet sizes */
-  var minPoolAvail = 1024 * 8;
+/* TODO: this effectively limits you to 8kb maximum packet sizes */
+var kMaxPacketSize = 1024 * 8;
+
+function getPool(minPoolAvail) {
+  minPoolAvail = minPoolAvail || kMaxPacketSize;
 
-  var poolSize = 1024 * 64;
+  var poolSize = Math.max(1024 * 64, minPoolAvail * 4);
 
   if (pool === null || (pool.used + minPoolAvail > pool.length)) {
     pool = new Buffer(poolSize);
@@ -81,6 +110,8 @@ function Socket(type, listener) {
   self.watcher = new IOWatcher();
   self.watcher.host = self;
   self.watcher.callback = function() {
+    if (self._recvBatch > 1) return self._readBatch();
+
     while (self.fd) {
       var p = getPool();
       var rinfo = recvfrom(self.fd, p, p.used, p.length - p.used, 0);
@@ -155,6 +186,86 @@ Socket.prototype.bind = function() {
   }
 };
 
+// Read up to _recvBatch datagrams per system call. recvmmsg packs them
+// into the pool back to back, so small datagrams don't waste pool space.
+Socket.prototype._readBatch = function() {
+  var batch = this._recvBatch;
+
+  while (this.fd) {
+    var p = getPool(batch * kMaxPacketSize);
+    var records = recvmmsg(this.fd, p, p.used, kMaxPacketSize, batch);
+
+    if (!records) return;
+
+    var last = records[records.length - 1];
+    p.used = last.offset + last.length;
+
+    for (var i = 0; i < records.length; i++) {
+      var rinfo = records[i];
+      rinfo.size = rinfo.length;
+      this.emit('message',
+                p.slice(rinfo.offset, rinfo.offset + rinfo.length),
+                rinfo);
+      if (!this.fd) return;
+    }
+
+    // Socket drained.
+    if (records.length < batch) return;
+  }
+};
+
+// Receive up to n datagrams per system call (recvmmsg on Linux).
+Socket.prototype.setRecvBatch = function(n) {
+  n = parseInt(n, 10);
+  if (!(n >= 1 && n <= 64)) {
+    throw new Error('Receive batch must be between 1 and 64');
+  }
+  this._recvBatch = recvmmsg ? n : 1;
+};
+
+// Sends several datagrams with as few system calls as possible (sendmmsg
+// on Linux). messages is an array of objects with the properties buffer,
+// offset, length, port and address. Addresses must be IPs. For
+// unix_dgram sockets address is the path and port is ignored.
+// callback(err, sent) gets the number of datagrams handed to the kernel.
+Socket.prototype.sendBatch = function(messages, callback) {
+  var sent = 0;
+
+  if (this.type === 'unix_dgram') {
+    messages = messages.map(function(m) {
+      return { buffer: m.buffer, offset: m.offset, length: m.length,
+               port: m.address };
+    });
+  }
+
+  try {
+    if (sendmmsg) {
+      while (sent < messages.length) {
+        var batch = sent ? messages.slice(sent) : messages;
+        var n = sendmmsg(this.fd, batch, 0);
+        if (!n) break;  // EAGAIN, drop the rest like sendto() does.
+        sent += n;
+      }
+    } else {
+      for (; sent < messages.length; sent++) {
+        var m = messages[sent];
+        var bytes = binding.sendto(this.fd, m.buffer, m.offset, m.length, 0,
+                                   m.port, m.address);
+        if (bytes === null) break;
+      }
+    }
+  } catch (err) {
+    if (callback) {
+      callback(err, sent);
+    }
+    return;
+  }
+
+  if (callback) {
+    callback(null, sent);
+  }
+};
+
 Socket.prototype._startWatcher = function() {
   if (! this._watcherStarted) {
     // listen for read ready, not write ready
@@ -277,7 +388,8 @@ Socket.prototype.sendto = function(buffer,
                                    addr,
                                    callback) {
   try {
-    var bytes = binding.sendto(this.fd, buffer, offset, length, 0, port, addr);
+    var bytes = binding.sendto(this.fd, buffer, offset, length, 0,
+                               getAddress(port, addr));
   } catch (err) {
     if (callback) {
       callback(err);
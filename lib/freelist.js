@@ -19,25 +19,32 @@
 // OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
 // USE OR OTHER DEALINGS IN THE SOFTWARE.
 
-// This is a free list to avoid creating so many of the same object.
+var ObjectPool = process.binding('object_pool').ObjectPool;
+
+// This is a free list to avoid creating so many of the same object. It is a
+// stack: alloc() returns the object that was freed last.
 exports.FreeList = function(name, max, constructor) {
   this.name = name;
   this.constructor = constructor;
   this.max = max;
-  this.list = [];
+  this.pool = new ObjectPool(max);
 };
 
 
 exports.FreeList.prototype.alloc = function() {
-  //debug("alloc " + this.name + " " + this.list.length);
-  return this.list.length ? this.list.shift() :
-                            this.constructor.apply(this, arguments);
+  //debug("alloc " + this.name + " " + this.pool.stats().length);
+  var obj = this.pool.alloc();
+  return obj !== undefined ? obj : this.constructor.apply(this, arguments);
 };
 
 
 exports.FreeList.prototype.free = function(obj) {
-  //debug("free " + this.name + " " + this.list.length);
-  if (this.list.length < this.max) {
-    this.list.push(obj);
-  }
+  //debug("free " + this.name + " " + this.pool.stats().length);
+  return this.pool.free(obj);
+};
+
+
+// { length, max, hits, misses }
+exports.FreeList.prototype.stats = function() {
+  return this.pool.stats();
 };
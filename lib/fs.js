@@ -913,6 +913,7 @@ var ReadStream = fs.ReadStream = function(path, options) {
   this.flags = 'r';
   this.mode = parseInt('0666', 8);
   this.bufferSize = 64 * 1024;
+  this.sendfile = true;
 
   options = options || {};
 
@@ -963,10 +964,112 @@ ReadStream.prototype.setEncoding = function(encoding) {
 };
 
 
+// Bytes handed to the kernel per sendfile() call when piping to a socket.
+var kSendfileSize = 512 * 1024;
+
+// pipe() to a net socket (or an http response on top of one) copies the
+// file with sendfile() instead of reading it into the pool and writing it
+// back out. This only kicks in if no data has been read yet, we know the
+// file offset and, when the first chunk is due, the pipe is the only 'data'
+// listener; otherwise the stream behaves as usual. No 'data' events are
+// emitted in this mode.
+ReadStream.prototype.pipe = function(dest, options) {
+  if (this.sendfile &&
+      !this._decoder &&
+      !this.reading &&
+      !this._dataEmitted &&
+      !this.buffer &&
+      (this.fd === null || this.start !== undefined) &&
+      typeof dest._sendfileSocket === 'function') {
+    this._sendfileDest = dest;
+  }
+  return Stream.prototype.pipe.call(this, dest, options);
+};
+
+
+ReadStream.prototype._sendfile = function() {
+  var self = this;
+  var socket = self._sendfileSocket;
+
+  if (!socket) {
+    // Resolved on the first chunk so that an http response has had a
+    // chance to set its headers. The data never goes through JavaScript,
+    // so when something besides the pipe listens for 'data' the file is
+    // read the normal way.
+    if (self.listeners('data').length == 1) {
+      socket = self._sendfileDest._sendfileSocket();
+    }
+    if (!socket) {
+      self._sendfileDest = null;
+      self._read();
+      return;
+    }
+    self._sendfileSocket = socket;
+  }
+
+  if (self.pos === undefined) self.pos = 0;
+
+  var toSend = kSendfileSize;
+  if (self.end !== undefined) {
+    toSend = Math.min(self.end - self.pos + 1, toSend);
+  }
+
+  if (toSend <= 0) {
+    self.emit('end');
+    self.destroy();
+    return;
+  }
+
+  if (self.pos + toSend > 0xffffffff) {
+    // The binding takes 32 bit offsets, read the rest the normal way.
+    self._sendfileDest = self._sendfileSocket = null;
+    self._read();
+    return;
+  }
+
+  self.reading = true;
+
+  socket._sendfile(self.fd, self.pos, toSend, function(err, bytesSent) {
+    self.reading = false;
+    if (err) {
+      self.readable = false;
+      if (!socket.writable) {
+        // The other end went away, the pipe has been torn down already.
+        self.destroy();
+      } else {
+        self.emit('error', err);
+      }
+      return;
+    }
+
+    if (bytesSent === 0) {
+      self.emit('end');
+      self.destroy();
+      return;
+    }
+
+    self.pos += bytesSent;
+
+    if (!self.readable) return;
+    self._read();
+  });
+};
+
+
 ReadStream.prototype._read = function() {
   var self = this;
   if (!self.readable || self.paused || self.reading) return;
 
+  if (self.start !== undefined && self._firstRead) {
+    self.pos = self.start;
+    self._firstRead = false;
+  }
+
+  if (self._sendfileDest) {
+    self._sendfile();
+    return;
+  }
+
   self.reading = true;
 
   if (!pool || pool.length - pool.used < kMinPoolSpace) {
@@ -976,11 +1079,6 @@ ReadStream.prototype._read = function() {
     allocNewPool();
   }
 
-  if (self.start !== undefined && self._firstRead) {
-    self.pos = self.start;
-    self._firstRead = false;
-  }
-
   // Grab another reference to the pool in the case that while we're in the
   // thread pool another read() finishes up the pool, and allocates a new
   // one.
@@ -1035,6 +1133,7 @@ ReadStream.prototype._read = function() {
 
 
 ReadStream.prototype._emitData = function(d) {
+  this._dataEmitted = true;
   if (this._decoder) {
     var string = this._decoder.write(d);
     if (string.length) this.emit('data', string);
@@ -24,7 +24,9 @@ var net = require('net');
 var stream = require('stream');
 var EventEmitter = require('events').EventEmitter;
 var FreeList = require('freelist').FreeList;
-var HTTPParser = process.binding('http_parser').HTTPParser;
+var binding = process.binding('http_parser');
+var HTTPParser = binding.HTTPParser;
+var serializeHeader = binding.serializeHeader;
 var assert = require('assert').ok;
 
 // proteus: disable dtrace calls
@@ -41,49 +43,40 @@ var parsers = new FreeList('parsers', 1000, function() {
 
   parser.onMessageBegin = function() {
     parser.incoming = new IncomingMessage(parser.socket);
-    parser.field = null;
-    parser.value = null;
+    parser._headers = [];
+    parser._url = '';
   };
 
-  // Only servers will get URL events.
-  parser.onURL = function(b, start, len) {
-    var slice = b.toString('ascii', start, start + len);
-    if (parser.incoming.url) {
-      parser.incoming.url += slice;
-    } else {
-      // Almost always will branch here.
-      parser.incoming.url = slice;
-    }
+  // Only called in the slow case: the message has so many headers that
+  // the binding passes them up in chunks, or it has trailers.
+  parser.onHeaders = function(headers, url) {
+    parser._headers = parser._headers.concat(headers);
+    parser._url += url;
   };
 
-  parser.onHeaderField = function(b, start, len) {
-    var slice = b.toString('ascii', start, start + len).toLowerCase();
-    if (parser.value != undefined) {
-      parser.incoming._addHeaderLine(parser.field, parser.value);
-      parser.field = null;
-      parser.value = null;
+  // info.headers and info.url are only set in the fast case, when the
+  // binding did not need to call onHeaders.
+  parser.onHeadersComplete = function(info) {
+    var headers = info.headers;
+    var url = info.url;
+
+    if (!headers) {
+      headers = parser._headers;
+      parser._headers = [];
     }
-    if (parser.field) {
-      parser.field += slice;
-    } else {
-      parser.field = slice;
+
+    if (!url) {
+      url = parser._url;
+      parser._url = '';
     }
-  };
 
-  parser.onHeaderValue = function(b, start, len) {
-    var slice = b.toString('ascii', start, start + len);
-    if (parser.value) {
-      parser.value += slice;
-    } else {
-      parser.value = slice;
+    for (var i = 0, n = headers.length; i < n; i += 2) {
+      parser.incoming._addHeaderLine(headers[i], headers[i + 1]);
     }
-  };
 
-  parser.onHeadersComplete = function(info) {
-    if (parser.field && (parser.value != undefined)) {
-      parser.incoming._addHeaderLine(parser.field, parser.value);
-      parser.field = null;
-      parser.value = null;
+    if (url) {
+      // server only
+      parser.incoming.url = url;
     }
 
     parser.incoming.httpVersionMajor = info.versionMajor;
@@ -111,6 +104,17 @@ var parsers = new FreeList('parsers', 1000, function() {
     return isHeadResponse;
   };
 
+  // Server side: the heads of all the (pipelined) requests that one
+  // execute() call parsed, in one go. onMessageBegin is not called.
+  parser.onHeadersBatch = function(batch) {
+    for (var i = 0, n = batch.length; i < n; i++) {
+      var info = batch[i];
+      parser.incoming = new IncomingMessage(parser.socket);
+      parser.onHeadersComplete(info);
+      if (info.complete) parser.onMessageComplete();
+    }
+  };
+
   parser.onBody = function(b, start, len) {
     // TODO body encoding?
     var slice = b.slice(start, start + len);
@@ -124,9 +128,14 @@ var parsers = new FreeList('parsers', 1000, function() {
 
   parser.onMessageComplete = function() {
     this.incoming.complete = true;
-    if (parser.field && (parser.value != undefined)) {
-      parser.incoming._addHeaderLine(parser.field, parser.value);
+
+    // Trailers.
+    var headers = parser._headers;
+    for (var i = 0, n = headers.length; i < n; i += 2) {
+      parser.incoming._addHeaderLine(headers[i], headers[i + 1]);
     }
+    parser._headers = [];
+
     if (!parser.incoming.upgrade) {
       // For upgraded connections, also emit this after parser.execute
       parser.incoming.readable = false;
@@ -196,15 +205,21 @@ var STATUS_CODES = exports.STATUS_CODES = {
 };
 
 
-var connectionExpression = /Connection/i;
-var transferEncodingExpression = /Transfer-Encoding/i;
-var closeExpression = /close/i;
-var chunkExpression = /chunk/i;
-var contentLengthExpression = /Content-Length/i;
-var expectExpression = /Expect/i;
 var continueExpression = /100-continue/i;
 
 
+// Outgoing headers are serialized straight into slices of a shared buffer,
+// much like net.Socket pools the strings it writes.
+var kHeaderPoolSize = 40 * 1024;
+var kMinHeaderSpace = 1024;
+var headerPool = null;
+
+function allocHeaderPool(minSize) {
+  headerPool = new process.Buffer(Math.max(kHeaderPoolSize, minSize));
+  headerPool.used = 0;
+}
+
+
 /* Abstract base class for ServerRequest and ClientResponse. */
 function IncomingMessage(socket) {
   stream.Stream.call(this);
@@ -361,11 +376,13 @@ OutgoingMessage.prototype._send = function(data, encoding) {
   // the same packet. Future versions of Node are going to take care of
   // this at a lower level and in a more general way.
   if (!this._headerSent) {
-    if (typeof data === 'string') {
-      data = this._header + data;
+    var joined = typeof data === 'string' && this._joinHeader(data, encoding);
+    if (joined) {
+      data = joined;
+      encoding = null;
     } else {
       this.output.unshift(this._header);
-      this.outputEncodings.unshift('ascii');
+      this.outputEncodings.unshift(null);
     }
     this._headerSent = true;
   }
@@ -373,14 +390,30 @@ OutgoingMessage.prototype._send = function(data, encoding) {
 };
 
 
+// When several writes go out back to back (headers, chunk framing, body)
+// cork the socket so the kernel coalesces them instead of sending a train
+// of small segments. Returns the corked socket, or null if corking is not
+// supported, so the caller can uncork the same socket afterwards.
+OutgoingMessage.prototype._cork = function() {
+  var conn = this.connection;
+  if (conn && conn.cork && conn._httpMessage === this && conn.writable) {
+    conn.cork();
+    return conn;
+  }
+  return null;
+};
+
+
 OutgoingMessage.prototype._writeRaw = function(data, encoding) {
   if (this.connection &&
       this.connection._httpMessage === this &&
       this.connection.writable) {
     // There might be pending data in the this.output buffer.
+    var corked = this.output.length ? this._cork() : null;
     while (this.output.length) {
       if (!this.connection.writable) {
         this._buffer(data, encoding);
+        if (corked) corked.uncork();
         return false;
       }
       var c = this.output.shift();
@@ -389,7 +422,9 @@ OutgoingMessage.prototype._writeRaw = function(data, encoding) {
     }
 
     // Directly write to socket.
-    return this.connection.write(data, encoding);
+    var ret = this.connection.write(data, encoding);
+    if (corked) corked.uncork();
+    return ret;
   } else {
     this._buffer(data, encoding);
     return false;
@@ -397,6 +432,34 @@ OutgoingMessage.prototype._writeRaw = function(data, encoding) {
 };
 
 
+// Called by fs.ReadStream.pipe() before it sendfile()s the body straight
+// into the connection. Puts the headers on the wire and hands back the
+// socket, or null when the body has to be framed (chunked) or the socket
+// is busy with another message.
+OutgoingMessage.prototype._sendfileSocket = function() {
+  if (!this._header) {
+    this._implicitHeader();
+  }
+
+  var conn = this.connection;
+  if (this.chunkedEncoding ||
+      !this._hasBody ||
+      this.finished ||
+      !conn ||
+      conn._httpMessage !== this ||
+      typeof conn._sendfileSocket !== 'function') {
+    return null;
+  }
+
+  var socket = conn._sendfileSocket();
+  if (socket) {
+    // Flush the headers and anything buffered before the file data.
+    this._send('');
+  }
+  return socket;
+};
+
+
 OutgoingMessage.prototype._buffer = function(data, encoding) {
   if (data.length === 0) return;
 
@@ -425,96 +488,63 @@ OutgoingMessage.prototype._buffer = function(data, encoding) {
 
 
 OutgoingMessage.prototype._storeHeader = function(firstLine, headers) {
-  var sentConnectionHeader = false;
-  var sentContentLengthHeader = false;
-  var sentTransferEncodingHeader = false;
-  var sentExpect = false;
-
   // firstLine in the case of request is: 'GET /index.html HTTP/1.1\r\n'
   // in the case of response it is: 'HTTP/1.1 200 OK\r\n'
-  var messageHeader = firstLine;
-  var field, value;
-  var self = this;
-
-  function store(field, value) {
-    messageHeader += field + ': ' + value + CRLF;
-
-    if (connectionExpression.test(field)) {
-      sentConnectionHeader = true;
-      if (closeExpression.test(value)) {
-        self._last = true;
-      } else {
-        self.shouldKeepAlive = true;
-      }
-
-    } else if (transferEncodingExpression.test(field)) {
-      sentTransferEncodingHeader = true;
-      if (chunkExpression.test(value)) self.chunkedEncoding = true;
+  //
+  // serializeHeader() writes it and the headers, adds Connection and
+  // Transfer-Encoding headers as needed, and tells us what it saw.
+  var flags = 0;
+  if (this.shouldKeepAlive) flags |= binding.HEADER_SHOULD_KEEP_ALIVE;
+  if (this.useChunkedEncodingByDefault) {
+    flags |= binding.HEADER_CHUNKED_BY_DEFAULT;
+  }
+  if (this._hasBody) flags |= binding.HEADER_HAS_BODY;
+  if (this.sendDate) flags |= binding.HEADER_SEND_DATE;
 
-    } else if (contentLengthExpression.test(field)) {
-      sentContentLengthHeader = true;
+  if (!headerPool || headerPool.length - headerPool.used < kMinHeaderSpace) {
+    allocHeaderPool(0);
+  }
 
-    } else if (expectExpression.test(field)) {
-      sentExpect = true;
-    }
+  var r;
+  while ((r = serializeHeader(headerPool, headerPool.used,
+                              firstLine, headers, flags)) < 0) {
+    // Did not fit.
+    allocHeaderPool(2 * (headerPool.length - headerPool.used));
   }
 
-  if (headers) {
-    var keys = Object.keys(headers);
-    var isArray = (Array.isArray(headers));
-    var field, value;
+  var length = r >> binding.HEADER_FLAG_BITS;
+  this._header = headerPool.slice(headerPool.used, headerPool.used + length);
+  this._headerSent = false;
+  headerPool.used += length;
 
-    for (var i = 0, l = keys.length; i < l; i++) {
-      var key = keys[i];
-      if (isArray) {
-        field = headers[key][0];
-        value = headers[key][1];
-      } else {
-        field = key;
-        value = headers[key];
-      }
+  if (r & binding.HEADER_LAST) this._last = true;
+  if (r & binding.HEADER_KEEP_ALIVE) this.shouldKeepAlive = true;
+  this.chunkedEncoding = (r & binding.HEADER_CHUNKED) != 0;
 
-      if (Array.isArray(value)) {
-        for (var j = 0; j < value.length; j++) {
-          store(field, value[j]);
-        }
-      } else {
-        store(field, value);
-      }
-    }
-  }
+  // wait until the first body chunk, or close(), is sent to flush,
+  // UNLESS we're sending Expect: 100-continue.
+  if (r & binding.HEADER_EXPECT) this._send('');
+};
 
-  // keep-alive logic
-  if (sentConnectionHeader == false) {
-    if (this.shouldKeepAlive &&
-        (sentContentLengthHeader || this.useChunkedEncodingByDefault)) {
-      messageHeader += 'Connection: keep-alive\r\n';
-    } else {
-      this._last = true;
-      messageHeader += 'Connection: close\r\n';
-    }
-  }
 
-  if (sentContentLengthHeader == false && sentTransferEncodingHeader == false) {
-    if (this._hasBody) {
-      if (this.useChunkedEncodingByDefault) {
-        messageHeader += 'Transfer-Encoding: chunked\r\n';
-        this.chunkedEncoding = true;
-      } else {
-        this._last = true;
-      }
-    } else {
-      // Make sure we don't end the 0\r\n\r\n at the end of the message.
-      this.chunkedEncoding = false;
-    }
+// If the header is still the last thing in the header pool, and the string
+// fits behind it, writes it there and returns header and data as one
+// buffer. Otherwise returns null.
+OutgoingMessage.prototype._joinHeader = function(data, encoding) {
+  var header = this._header;
+  var start = headerPool.used - header.length;
+
+  if (header.parent !== headerPool.parent ||
+      header.offset !== headerPool.offset + start) {
+    return null;
   }
 
-  this._header = messageHeader + CRLF;
-  this._headerSent = false;
+  var length = process.Buffer.byteLength(data, encoding);
+  if (length > headerPool.length - headerPool.used) return null;
 
-  // wait until the first body chunk, or close(), is sent to flush,
-  // UNLESS we're sending Expect: 100-continue.
-  if (sentExpect) this._send('');
+  headerPool.write(data, headerPool.used, encoding);
+  headerPool.used += length;
+  return headerPool.slice(start, headerPool.used);
 };
 
 
@@ -614,9 +644,11 @@ OutgoingMessage.prototype.write = function(chunk, encoding) {
     } else {
       // buffer
       len = chunk.length;
+      var corked = this._cork();
       this._send(len.toString(16) + CRLF);
       this._send(chunk);
       ret = this._send(CRLF);
+      if (corked) corked.uncork();
     }
   } else {
     ret = this._send(chunk, encoding);
@@ -669,26 +701,37 @@ OutgoingMessage.prototype.end = function(data, encoding) {
     // HACKY.
     if (this.chunkedEncoding) {
       var l = process.Buffer.byteLength(data, encoding).toString(16);
-      ret = this.connection.write(this._header + l + CRLF +
-                                  data + '\r\n0\r\n' +
-                                  this._trailer + '\r\n', encoding);
+      data = l + CRLF + data + '\r\n0\r\n' + this._trailer + '\r\n';
+    }
+    var joined = this._joinHeader(data, encoding);
+    if (joined) {
+      ret = this.connection.write(joined);
     } else {
-      ret = this.connection.write(this._header + data, encoding);
+      var corked = this._cork();
+      this.connection.write(this._header);
+      ret = this.connection.write(data, encoding);
+      if (corked) corked.uncork();
     }
     this._headerSent = true;
 
-  } else if (data) {
-    // Normal body write.
-    ret = this.write(data, encoding);
-  }
+  } else {
+    // Keep pending output, the last body chunk and the terminating
+    // chunk together.
+    var corked = (data || this.output.length) ? this._cork() : null;
+
+    if (data) {
+      // Normal body write.
+      ret = this.write(data, encoding);
+    }
 
-  if (!hot) {
     if (this.chunkedEncoding) {
       ret = this._send('0\r\n' + this._trailer + '\r\n'); // Last chunk.
     } else {
       // Force a flush, HACK.
       ret = this._send('');
     }
+
+    if (corked) corked.uncork();
   }
 
   this.finished = true;
@@ -779,6 +822,10 @@ exports.ServerResponse = ServerResponse;
 
 ServerResponse.prototype.statusCode = 200;
 
+// Add a Date header unless the response has one. The date comes from a
+// cache in the http_parser binding that is refreshed once a second.
+ServerResponse.prototype.sendDate = false;
+
 ServerResponse.prototype.writeContinue = function() {
   this._writeRaw('HTTP/1.1 100 Continue' + CRLF + CRLF, 'ascii');
   this._sent100 = true;
@@ -1000,13 +1047,27 @@ function connectionListener(socket) {
   parser.reinitialize('request');
   parser.socket = socket;
   parser.incoming = null;
+  parser._headers = [];
+  parser._url = '';
 
   socket.addListener('error', function(e) {
     self.emit('clientError', e);
   });
 
   socket.ondata = function(d, start, end) {
-    var ret = parser.execute(d, start, end - start);
+    // Responses to pipelined requests that are answered right away go out
+    // together, in one write.
+    var ret;
+    if (socket._batchWrites) {
+      socket._batchWrites();
+      try {
+        ret = parser.execute(d, start, end - start);
+      } finally {
+        socket._flushBatch();
+      }
+    } else {
+      ret = parser.execute(d, start, end - start);
+    }
     if (ret instanceof Error) {
       debug('parse error');
       socket.destroy(ret);
@@ -1127,14 +1188,20 @@ function Agent(options) {
 
   this.queue = [];
   this.sockets = [];
+  this.idleSockets = []; // keep-alive sockets without a request, LRU first
   this.maxSockets = Agent.defaultMaxSockets;
+  this.maxIdleSockets = Agent.defaultMaxIdleSockets;
+  this.idleTimeout = Agent.defaultIdleTimeout;
 
+  this.stats = { created: 0, reused: 0, evicted: 0 };
 }
 util.inherits(Agent, EventEmitter);
 exports.Agent = Agent;
 
 
 Agent.defaultMaxSockets = 5;
+Agent.defaultMaxIdleSockets = 5;
+Agent.defaultIdleTimeout = 15 * 1000;
 
 Agent.prototype.defaultPort = 80;
 Agent.prototype.appendMessage = function(options) {
@@ -1153,6 +1220,55 @@ Agent.prototype.appendMessage = function(options) {
 Agent.prototype._removeSocket = function(socket) {
   var i = this.sockets.indexOf(socket);
   if (i >= 0) this.sockets.splice(i, 1);
+  this._removeIdleSocket(socket);
+};
+
+
+Agent.prototype._removeIdleSocket = function(socket) {
+  socket._idleDeadline = 0;
+  var i = this.idleSockets.indexOf(socket);
+  if (i >= 0) this.idleSockets.splice(i, 1);
+};
+
+
+// A keep-alive socket is done with its request. Hand it to the next one
+// in the queue, or keep it around for a while.
+Agent.prototype._releaseSocket = function(socket) {
+  if (!socket.writable || !socket.readable) return;
+
+  if (this.queue.length) {
+    this._assignSocket(this.queue.shift(), socket);
+    this.stats.reused++;
+    return;
+  }
+
+  if (this.maxIdleSockets <= 0 || this.idleTimeout <= 0) {
+    socket.destroySoon();
+    return;
+  }
+
+  if (this.idleSockets.length >= this.maxIdleSockets) {
+    this._evictIdleSocket(this.idleSockets[0]);
+  }
+
+  this.idleSockets.push(socket);
+  addToIdleWheel(this, socket);
+};
+
+
+Agent.prototype._evictIdleSocket = function(socket) {
+  debug('AGENT evict idle socket');
+  this._removeIdleSocket(socket);
+  this.stats.evicted++;
+  socket.destroy();
+};
+
+
+Agent.prototype._assignSocket = function(req, socket) {
+  assert(req._queue === this.queue);
+  req._queue = null;
+  req.assignSocket(socket);
+  httpSocketSetup(socket);
 };
 
 
@@ -1175,10 +1291,10 @@ Agent.prototype._establishNewConnection = function() {
   socket._httpConnecting = true;
 
   this.sockets.push(socket);
+  this.stats.created++;
 
-  // Cycle so the request can be assigned to this new socket.
-  self._cycle();
-  assert(socket._httpMessage);
+  // The first request in the queue goes to this new socket.
+  this._assignSocket(this.queue.shift(), socket);
 
   // Add a parser to the socket.
   var parser = parsers.alloc();
@@ -1191,7 +1307,7 @@ Agent.prototype._establishNewConnection = function() {
     var req;
     if (socket._httpMessage) {
       req = socket._httpMessage;
-    } else if (self.queue.length) {
+    } else if (self.queue.length && !socket._idleDeadline) {
       req = self.queue.shift();
       assert(req._queue === self.queue);
       req._queue = null;
@@ -1329,6 +1445,7 @@ Agent.prototype._establishNewConnection = function() {
 
       assert(!socket._httpMessage);
 
+      if (req.shouldKeepAlive) self._releaseSocket(socket);
       self._cycle();
     });
 
@@ -1337,6 +1454,9 @@ Agent.prototype._establishNewConnection = function() {
 
     return isHeadResponse;
   };
+
+  // Open more connections if more requests are waiting.
+  this._cycle();
 };
 
 
@@ -1359,40 +1479,27 @@ Agent.prototype._getConnection = function(options, cb) {
 };
 
 
-// This method attempts to shuffle items along the queue into one of the
-// waiting sockets. If a waiting socket cannot be found, it will
-// start the process of establishing one.
+// This method attempts to shuffle items along the queue onto idle
+// sockets, most recently used first. If there are none left, it will start
+// the process of establishing a new connection.
 Agent.prototype._cycle = function() {
-  debug('Agent _cycle sockets=' + this.sockets.length + ' queue=' + this.queue.length);
-  var self = this;
-
-  var first = this.queue[0];
-  if (!first) return;
-
-  // First try to find an available socket.
-  for (var i = 0; i < this.sockets.length; i++) {
-    var socket = this.sockets[i];
-    // If the socket doesn't already have a message it's sending out
-    // and the socket is available for writing or it's connecting.
-    // In particular this rules out sockets that are closing.
-    if (!socket._httpMessage &&
-        ((socket.writable && socket.readable) || socket._httpConnecting)) {
-      debug('Agent found socket, shift');
-      // We found an available connection!
-      this.queue.shift(); // remove first from queue.
-      assert(first._queue === this.queue);
-      first._queue = null;
-
-      first.assignSocket(socket);
-      httpSocketSetup(socket);
-      self._cycle(); // try to dispatch another
-      return;
+  debug('Agent _cycle sockets=' + this.sockets.length +
+        ' idle=' + this.idleSockets.length + ' queue=' + this.queue.length);
+
+  while (this.queue.length && this.idleSockets.length) {
+    var socket = this.idleSockets.pop();
+    socket._idleDeadline = 0;
+    // Skip sockets that are closing; they are removed on 'close'.
+    if (socket.writable && socket.readable) {
+      debug('Agent found idle socket');
+      this._assignSocket(this.queue.shift(), socket);
+      this.stats.reused++;
     }
   }
 
-  // If no sockets are connecting, and we have space for another we should
-  // be starting a new connection to handle this request.
-  if (this.sockets.length < this.maxSockets) {
+  // Start a new connection if there is room for one. Establishing it
+  // cycles again for the rest of the queue.
+  if (this.queue.length && this.sockets.length < this.maxSockets) {
     this._establishNewConnection();
   }
 
@@ -1400,6 +1507,60 @@ Agent.prototype._cycle = function() {
 };
 
 
+// Idle sockets of all agents expire through one shared timer wheel with a
+// slot per second. A socket goes into the slot of the second it expires
+// in; the timer only runs while the wheel is not empty. Entries are not
+// removed when a socket is reused, they are skipped when their deadline
+// no longer matches the socket's.
+var kIdleWheelSlots = 64;
+var idleWheel = new Array(kIdleWheelSlots);
+var idleWheelPos = 0;
+var idleWheelCount = 0;
+var idleWheelTimer = null;
+
+function addToIdleWheel(agent, socket, deadline) {
+  var now = Date.now();
+  if (!deadline) deadline = now + agent.idleTimeout;
+  socket._idleDeadline = deadline;
+
+  var ticks = Math.ceil((deadline - now) / 1000);
+  ticks = Math.max(1, Math.min(ticks, kIdleWheelSlots - 1));
+
+  var slot = (idleWheelPos + ticks) % kIdleWheelSlots;
+  if (!idleWheel[slot]) idleWheel[slot] = [];
+  idleWheel[slot].push(agent, socket, deadline);
+  idleWheelCount++;
+
+  if (!idleWheelTimer) idleWheelTimer = setTimeout(idleWheelTick, 1000);
+}
+
+function idleWheelTick() {
+  idleWheelTimer = null;
+  idleWheelPos = (idleWheelPos + 1) % kIdleWheelSlots;
+
+  var entries = idleWheel[idleWheelPos];
+  idleWheel[idleWheelPos] = null;
+
+  if (entries) {
+    var now = Date.now();
+    idleWheelCount -= entries.length / 3;
+
+    for (var i = 0; i < entries.length; i += 3) {
+      var agent = entries[i], socket = entries[i + 1], deadline = entries[i + 2];
+      if (socket._idleDeadline !== deadline) continue; // reused or gone
+      if (deadline > now) {
+        // Longer than one turn of the wheel, or the timer was early.
+        addToIdleWheel(agent, socket, deadline);
+      } else {
+        agent._evictIdleSocket(socket);
+      }
+    }
+  }
+
+  if (idleWheelCount > 0) idleWheelTimer = setTimeout(idleWheelTick, 1000);
+}
+
+
 // process-wide hash of agents.
 // keys: "host:port" string
 // values: instance of Agent
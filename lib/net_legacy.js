@@ -26,6 +26,7 @@ var timers = require('timers');
 
 var kMinPoolSpace = 128;
 var kPoolSize = 40 * 1024;
+var kMaxBatchSize = 64 * 1024;
 
 // proteus: log net unconditionally
 var debug = function(x) { console.debug('NET:', x); };
@@ -64,12 +65,21 @@ var write = binding.write;
 var toRead = binding.toRead;
 var setNoDelay = binding.setNoDelay;
 var setKeepAlive = binding.setKeepAlive;
+var setRecvBufferSize = binding.setRecvBufferSize;
+var setSendBufferSize = binding.setSendBufferSize;
+// The following are only defined on platforms that support them.
+var setCork = binding.setCork;
+var setQuickAck = binding.setQuickAck;
+var setDeferAccept = binding.setDeferAccept;
+var setFastOpen = binding.setFastOpen;
 var socketError = binding.socketError;
 var getsockname = binding.getsockname;
 var errnoException = binding.errnoException;
 var sendMsg = binding.sendMsg;
 var recvMsg = binding.recvMsg;
+var sendfile = process.binding('fs').sendfile;
 
+var EAGAIN = constants.EAGAIN;
 var EINPROGRESS = constants.EINPROGRESS || constants.WSAEINPROGRESS;
 var ENOENT = constants.ENOENT;
 var EMFILE = constants.EMFILE;
@@ -220,6 +230,9 @@ function Socket(options) {
   this.fd = null;
   this.type = null;
   this.allowHalfOpen = false;
+  this._corked = 0;
+  this._batch = null;
+  this._batchBytes = 0;
 
   if (typeof options == 'object') {
     this.fd = options.fd !== undefined ? parseInt(options.fd, 10) : null;
@@ -321,6 +334,19 @@ Socket.prototype.write = function(data /* [encoding], [fd], [cb] */) {
 
   // TODO - actually use cb
 
+  if (this._batch) {
+    if (fd === undefined && !this._connecting &&
+        !(this._writeQueue && this._writeQueue.length) &&
+        this._batchBytes + data.length <= kMaxBatchSize) {
+      this._batch.push(data, encoding, cb);
+      this._batchBytes += data.length;
+      return true;
+    }
+    // Anything that is not batched goes out after what has been, so send
+    // that first.
+    this._flushBatch();
+  }
+
   if (this._connecting || (this._writeQueue && this._writeQueue.length)) {
     if (!this._writeQueue) {
       this.bufferSize = 0;
@@ -509,9 +535,86 @@ Socket.prototype._onBufferChange = function() {
 };
 
 
+// Between _batchWrites() and _flushBatch() small writes are only collected,
+// and then copied into one buffer and sent with a single write. Used by
+// the HTTP server while it handles what came in with one read, so that
+// responses to pipelined requests don't each cost a system call and a
+// packet. When the socket stops being writable before the batch is sent,
+// the callbacks of its writes get an error.
+Socket.prototype._batchWrites = function() {
+  if (!this._batch) {
+    this._batch = [];
+    this._batchBytes = 0;
+  }
+};
+
+
+Socket.prototype._flushBatch = function() {
+  var batch = this._batch;
+  if (!batch) return;
+
+  this._batch = null;
+  this._batchBytes = 0;
+
+  if (!this.writable) {
+    failBatch(batch);
+    return;
+  }
+
+  if (batch.length === 0) return;
+
+  if (batch.length === 3) {
+    this.write(batch[0], batch[1], batch[2]);
+    return;
+  }
+
+  var length = 0, i, data;
+  for (i = 0; i < batch.length; i += 3) {
+    data = batch[i];
+    length += typeof data == 'string' ?
+              process.Buffer.byteLength(data, batch[i + 1]) :
+              data.length;
+  }
+
+  var buffer = new process.Buffer(length);
+  var offset = 0;
+  var callbacks = [];
+
+  for (i = 0; i < batch.length; i += 3) {
+    data = batch[i];
+    if (typeof data == 'string') {
+      offset += buffer.write(data, offset, batch[i + 1]);
+    } else {
+      data.copy(buffer, offset, 0, data.length);
+      offset += data.length;
+    }
+    if (batch[i + 2]) callbacks.push(batch[i + 2]);
+  }
+
+  this.write(buffer, callbacks.length ? function() {
+    for (var j = 0; j < callbacks.length; j++) callbacks[j]();
+  } : undefined);
+};
+
+
+function failBatch(batch) {
+  var callbacks = [];
+  for (var i = 2; i < batch.length; i += 3) {
+    if (batch[i]) callbacks.push(batch[i]);
+  }
+  if (callbacks.length === 0) return;
+
+  process.nextTick(function() {
+    var err = new Error('Socket is not writable');
+    for (var j = 0; j < callbacks.length; j++) callbacks[j](err);
+  });
+}
+
+
 // Flushes the write buffer out.
 // Returns true if the entire buffer was flushed.
 Socket.prototype.flush = function() {
+  if (this._batch) this._flushBatch();
   while (this._writeQueue && this._writeQueue.length) {
     var data = this._writeQueue.shift();
     var encoding = this._writeQueueEncoding.shift();
@@ -737,6 +840,72 @@ Socket.prototype.connect = function() {
 };
 
 
+// Returns the socket that fs.ReadStream.pipe() may sendfile() into, or
+// null if the data has to go through write().
+Socket.prototype._sendfileSocket = function() {
+  if (!this.writable || this._connecting || typeof this.fd !== 'number') {
+    return null;
+  }
+  if (this.type != 'tcp4' && this.type != 'tcp6' && this.type != 'unix') {
+    return null;
+  }
+  return this;
+};
+
+
+// Copies up to length bytes at position of file descriptor fd straight
+// to the socket. The copy runs in the thread pool so reading a cold file
+// never blocks the event loop, and since the socket is non-blocking the
+// kernel sends only what fits: callback(err, bytesSent) reports how much.
+// Data queued by write() goes out first. When the socket buffer is full
+// we wait for it to become writable again before retrying.
+Socket.prototype._sendfile = function(fd, position, length, callback) {
+  var self = this;
+
+  function retry() {
+    self.removeListener('drain', retry);
+    self.removeListener('close', onclose);
+    self._sendfile(fd, position, length, callback);
+  }
+
+  function onclose() {
+    self.removeListener('drain', retry);
+    self.removeListener('close', onclose);
+    callback(new Error('Socket closed'));
+  }
+
+  if (!this.writable || typeof this.fd !== 'number') {
+    callback(new Error('Socket is not writable'));
+    return;
+  }
+
+  if (this._batch) this._flushBatch();
+
+  if (this._writeQueue.length) {
+    // Let pending writes (e.g. HTTP headers) drain first.
+    this.on('drain', retry);
+    this.on('close', onclose);
+    return;
+  }
+
+  sendfile(this.fd, fd, position, length, function(err, bytesSent) {
+    if (err && err.errno === EAGAIN && self._writeWatcher) {
+      // Socket buffer is full, wait until the kernel drains it.
+      self.on('drain', retry);
+      self.on('close', onclose);
+      self._writeWatcher.start();
+      return;
+    }
+    if (err) {
+      callback(err);
+      return;
+    }
+    timers.active(self);
+    callback(null, bytesSent);
+  });
+};
+
+
 Socket.prototype.address = function() {
   return getsockname(this.fd);
 };
@@ -755,6 +924,46 @@ Socket.prototype.setKeepAlive = function(enable, time) {
   }
 };
 
+Socket.prototype.setRecvBufferSize = function(size) {
+  if (setRecvBufferSize && typeof this.fd === 'number') {
+    setRecvBufferSize(this.fd, size);
+  }
+};
+
+Socket.prototype.setSendBufferSize = function(size) {
+  if (setSendBufferSize && typeof this.fd === 'number') {
+    setSendBufferSize(this.fd, size);
+  }
+};
+
+Socket.prototype.setQuickAck = function(v) {
+  if (setQuickAck && ((this.type == 'tcp4') || (this.type == 'tcp6'))) {
+    setQuickAck(this.fd, v);
+  }
+};
+
+Socket.prototype.setCork = function(v) {
+  if (setCork && ((this.type == 'tcp4') || (this.type == 'tcp6'))) {
+    setCork(this.fd, v);
+  }
+};
+
+// cork() and uncork() nest: the socket is only uncorked, flushing any
+// partial frame, once every cork() has been matched by an uncork(). Both
+// are no-ops where TCP_CORK is not available.
+Socket.prototype.cork = function() {
+  if (!setCork || typeof this.fd !== 'number') return;
+  if ((this.type != 'tcp4') && (this.type != 'tcp6')) return;
+  if (this._corked++ === 0) setCork(this.fd, true);
+};
+
+Socket.prototype.uncork = function() {
+  if (!this._corked) return;
+  if (--this._corked === 0 && typeof this.fd === 'number') {
+    setCork(this.fd, false);
+  }
+};
+
 Socket.prototype.setTimeout = function(msecs, callback) {
   if (msecs > 0) {
     timers.enroll(this, msecs);
@@ -807,6 +1016,12 @@ Socket.prototype.destroy = function(exception) {
   this._writeQueueFD = [];
   this.bufferSize = 0;
 
+  if (this._batch) {
+    failBatch(this._batch);
+    this._batch = null;
+    this._batchBytes = 0;
+  }
+
   this.readable = this.writable = false;
 
   if (this._writeWatcher) {
@@ -872,6 +1087,7 @@ Socket.prototype._shutdown = function() {
 
 
 Socket.prototype.end = function(data, encoding) {
+  if (this._batch) this._flushBatch();
   if (this.writable) {
     if (this._writeQueueLast() !== END_OF_FILE) {
       DTRACE_NET_STREAM_END(this);
@@ -906,6 +1122,8 @@ function Server(/* [ options, ] listener */) {
   self.connections = 0;
 
   self.allowHalfOpen = options.allowHalfOpen || false;
+  self.deferAccept = options.deferAccept || 0;
+  self.fastOpen = options.fastOpen || 0;
 
   self.watcher = new IOWatcher();
   self.watcher.host = self;
@@ -1112,6 +1330,21 @@ Server.prototype._doListen = function() {
     return;
   }
 
+  if ((self.type == 'tcp4') || (self.type == 'tcp6')) {
+    // These are optimizations only; a kernel that does not know about
+    // them rejects the option and we simply listen without it.
+    try {
+      if (self.deferAccept && setDeferAccept) {
+        setDeferAccept(self.fd, self.deferAccept);
+      }
+      if (self.fastOpen && setFastOpen) {
+        setFastOpen(self.fd, self.fastOpen);
+      }
+    } catch (err) {
+      debug('listen option not supported: ' + err.message);
+    }
+  }
+
   // Need to the listening in the nextTick so that people potentially have
   // time to register 'listening' listeners.
   process.nextTick(function() {
@@ -450,6 +450,19 @@ function Server(/* [ options, ] listener */) {
   this.connections = 0;
   this.allowHalfOpen = options.allowHalfOpen || false;
 
+  // Number of connections to accept per readiness event. Batched
+  // connections cross into JavaScript as a single array.
+  this._acceptBatch = options.acceptBatch || 0;
+
+  // Bind with SO_REUSEPORT so that several processes can listen on the
+  // same port and the kernel spreads incoming connections between them.
+  this._reusePort = options.reusePort || false;
+
+  // TCP_DEFER_ACCEPT timeout in seconds and TCP_FASTOPEN queue length.
+  // Both are hints; they are skipped where the platform lacks them.
+  this._deferAccept = options.deferAccept || 0;
+  this._fastOpen = options.fastOpen || 0;
+
   this._handle = null;
 }
 util.inherits(Server, events.EventEmitter);
@@ -466,13 +479,14 @@ function listenip(self, ip, port, addressType) {
   self._handle = new TCP();
   self._handle.socket = self;
   self._handle.onconnection = onconnection;
+  self._handle.onconnections = onconnections;
 
   if (ip && port) {
     debug("bind to " + ip);
     if (addressType == 6) {
-      r = self._handle.bind6(ip, port);
+      r = self._handle.bind6(ip, port, self._reusePort);
     } else {
-      r = self._handle.bind(ip, port);
+      r = self._handle.bind(ip, port, self._reusePort);
     }
   }
   if (r) {
@@ -483,7 +497,18 @@ function listenip(self, ip, port, addressType) {
       self.emit('error', errnoException(errno, 'listen'));
     });
   } else {
-    r = self._handle.listen(self._backlog || 128);
+    if (self._deferAccept && self._handle.setDeferAccept) {
+      self._handle.setDeferAccept(self._deferAccept);
+    }
+    if (self._fastOpen && self._handle.setFastOpen) {
+      self._handle.setFastOpen(self._fastOpen);
+    }
+    if (self._acceptBatch > 1) {
+      r = self._handle.setAcceptBatch(self._acceptBatch);
+    }
+    if (!r) {
+      r = self._handle.listen(self._backlog || 128);
+    }
     if (r) {
       self._handle.close();
       self._handle = null;
@@ -554,6 +579,15 @@ function onconnection(clientHandle) {
 }
 
 
+function onconnections(clientHandles) {
+  debug("onconnections " + clientHandles.length);
+
+  for (var i = 0; i < clientHandles.length; i++) {
+    onconnection.call(this, clientHandles[i]);
+  }
+}
+
+
 Server.prototype.close = function() {
   if (this._handle != null) {
     this._handle.close();
@@ -28,6 +28,9 @@ var END_OF_FILE = 42;
 var assert = require('assert').ok;
 
 var NPN_ENABLED = process.binding('constants').NPN_ENABLED;
+var SSL_OP_CIPHER_SERVER_PREFERENCE =
+    process.binding('constants').SSL_OP_CIPHER_SERVER_PREFERENCE;
+var shutdown = process.binding('net').shutdown;
 
 // proteus: unconditional log
 var debug = function(a) { console.debug('TLS:', a); };
@@ -40,6 +43,12 @@ try {
   throw new Error('node.js not compiled with openssl crypto support.');
 }
 
+// getCiphers([list]) returns the cipher suites a cipher list stands for, in
+// order of preference. Without a list, those of crypto.DEFAULT_CIPHERS.
+exports.getCiphers = function(ciphers) {
+  return process.binding('crypto').getSSLCiphers(ciphers);
+};
+
 // Convert protocols array into valid OpenSSL protocols list
 // ("\x06spdy/2\x08http/1.1\x08http/1.0")
 function convertNPNProtocols(NPNProtocols, out) {
@@ -168,15 +177,22 @@ function parseCertString(s) {
 }
 
 
+function peerCertificate(ssl) {
+  var c = ssl.getPeerCertificate();
+
+  if (c) {
+    if (c.issuer) c.issuer = parseCertString(c.issuer);
+    if (c.subject) c.subject = parseCertString(c.subject);
+    return c;
+  }
+
+  return null;
+}
+
+
 CryptoStream.prototype.getPeerCertificate = function() {
   if (this.pair.ssl) {
-    var c = this.pair.ssl.getPeerCertificate();
-
-    if (c) {
-      if (c.issuer) c.issuer = parseCertString(c.issuer);
-      if (c.subject) c.subject = parseCertString(c.subject);
-      return c;
-    }
+    return peerCertificate(this.pair.ssl);
   }
 
   return null;
@@ -192,6 +208,24 @@ CryptoStream.prototype.getCipher = function(err) {
 };
 
 
+CryptoStream.prototype.getSession = function() {
+  if (this.pair.ssl) {
+    return this.pair.ssl.getSession();
+  } else {
+    return null;
+  }
+};
+
+
+CryptoStream.prototype.isSessionReused = function() {
+  if (this.pair.ssl) {
+    return this.pair.ssl.isSessionReused();
+  } else {
+    return false;
+  }
+};
+
+
 CryptoStream.prototype.end = function(d) {
   if (this.pair._doneFlag) return;
   if (!this.writable) return;
@@ -493,7 +527,7 @@ function SecurePair(credentials, isServer, requestCert, rejectUnauthorized,
   this._doneFlag = false;
 
   if (!credentials) {
-    this.credentials = crypto.createCredentials();
+    this.credentials = crypto.sharedCredentials.get();
   } else {
     this.credentials = credentials;
   }
@@ -670,9 +704,239 @@ SecurePair.prototype.error = function() {
   }
 };
 
+
+// Binds an SSL Connection straight to the file descriptor of a net socket.
+// OpenSSL reads and writes the records on the socket itself, only the
+// cleartext goes through the read and write methods of the socket, and
+// there is no SecurePair with its two CryptoStreams to cycle.
+//
+// Emits 'secure' on the socket once the handshake is done. Data written
+// before that is queued by the socket as usual.
+function secureSocket(socket, ssl) {
+  socket.ssl = ssl;
+  socket.authorized = false;
+  socket._secureEstablished = false;
+  socket._writeWantsRead = false;
+  socket._paused = false;
+
+  var proto = net.Socket.prototype;
+
+  function sslError() {
+    var err = ssl.error;
+    ssl.error = null;
+    return err;
+  }
+
+  // The rest of a record is already decrypted when it doesn't fit in one
+  // read, and the socket won't tell us about it.
+  function readPending() {
+    process.nextTick(function() {
+      if (socket._paused || !socket.readable || !socket._readWatcher) return;
+      if (ssl.clearPending() > 0) socket._onReadable();
+    });
+  }
+
+  function handshake() {
+    ssl.start();
+
+    var err = sslError();
+    if (err) {
+      // Like SecurePair, a failed handshake just closes the connection.
+      debug('handshake failed: ' + err.message);
+      socket.destroy();
+      return;
+    }
+
+    if (!ssl.isInitFinished()) {
+      if (ssl.wantWrite()) socket._writeWatcher.start();
+      return;
+    }
+
+    socket._secureEstablished = true;
+    if (NPN_ENABLED) socket.npnProtocol = ssl.getNegotiatedProtocol();
+    debug('secure established');
+    socket.emit('secure');
+
+    if (socket.writable && socket._writeQueue && socket._writeQueue.length) {
+      socket._onWritable();
+    }
+  }
+
+  socket._readImpl = function(buf, off, len) {
+    var bytesRead = ssl.clearOut(buf, off, len);
+
+    var err = sslError();
+    if (err) throw err;
+
+    if (this._writeWantsRead) {
+      this._writeWantsRead = false;
+      this._writeWatcher.start();
+    }
+
+    if (bytesRead > 0 && !this._paused && ssl.clearPending() > 0) {
+      readPending();
+    }
+
+    // -1 when the record isn't complete yet, 0 at the end of the stream.
+    return bytesRead;
+  };
+
+  socket._writeImpl = function(buf, off, len) {
+    if (!this._secureEstablished || len == 0) return 0;
+
+    var bytesWritten = ssl.clearIn(buf, off, len);
+
+    var err = sslError();
+    if (err) throw err;
+
+    if (bytesWritten > 0) return bytesWritten;
+
+    // Renegotiation. Don't spin on the write watcher until a read went
+    // through.
+    if (!ssl.wantWrite()) this._writeWantsRead = true;
+    return 0;
+  };
+
+  socket._shutdownImpl = function() {
+    ssl.shutdown();
+    ssl.error = null;
+    shutdown(this.fd, 'write');
+  };
+
+  socket._onReadable = function() {
+    if (!this._secureEstablished) {
+      handshake();
+      if (!this._secureEstablished || !this.readable) return;
+    }
+    proto._onReadable.call(this);
+  };
+
+  socket._onWritable = function() {
+    if (!this._secureEstablished) {
+      this._writeWatcher.stop();
+      handshake();
+      return;
+    }
+    if (this._writeWantsRead) {
+      this._writeWatcher.stop();
+      return;
+    }
+    proto._onWritable.call(this);
+  };
+
+  socket.pause = function() {
+    this._paused = true;
+    proto.pause.call(this);
+  };
+
+  socket.resume = function() {
+    proto.resume.call(this);
+    this._paused = false;
+    // What was decrypted before the pause goes out ahead of anything new
+    // from the socket: the tick comes before the watcher.
+    if (this._secureEstablished && ssl.clearPending() > 0) readPending();
+  };
+
+  // sendfile() would bypass the encryption.
+  socket._sendfileSocket = function() {
+    return null;
+  };
+
+  socket.getPeerCertificate = function() {
+    return peerCertificate(ssl);
+  };
+
+  socket.getCipher = function() {
+    return ssl.getCurrentCipher();
+  };
+
+  socket.getSession = function() {
+    return ssl.getSession();
+  };
+
+  socket.isSessionReused = function() {
+    return ssl.isSessionReused();
+  };
+
+  socket.on('close', function() {
+    ssl.error = null;
+    ssl.close();
+  });
+
+  function start() {
+    ssl.setFD(socket.fd);
+    handshake();
+  }
+
+  if (socket._connecting || typeof socket.fd !== 'number') {
+    socket.once('connect', start);
+  } else {
+    start();
+  }
+
+  return socket;
+}
+
 // TODO: support anonymous (nocert) and PSK
 
 
+// Client sessions by server and credentials, see sessionKey(). tls.connect()
+// offers the session it has for a server, and a full handshake is only done
+// when the server no longer knows about it. The oldest session goes when
+// there are more than max.
+function SessionCache(max) {
+  this.max = typeof max == 'number' ? max : 100;
+  this.sessions = {};
+  this.keys = [];
+  this.stats = { handshakes: 0, resumed: 0 };
+}
+exports.SessionCache = SessionCache;
+
+
+SessionCache.prototype.get = function(key) {
+  return this.sessions.hasOwnProperty(key) ? this.sessions[key] : null;
+};
+
+
+SessionCache.prototype.set = function(key, session) {
+  if (this.max <= 0 || !session) return;
+
+  if (!this.sessions.hasOwnProperty(key)) {
+    if (this.keys.length >= this.max) {
+      delete this.sessions[this.keys.shift()];
+    }
+    this.keys.push(key);
+  }
+  this.sessions[key] = session;
+};
+
+
+SessionCache.prototype.remove = function(key) {
+  if (!this.sessions.hasOwnProperty(key)) return;
+  delete this.sessions[key];
+  this.keys.splice(this.keys.indexOf(key), 1);
+};
+
+
+SessionCache.prototype.clear = function() {
+  this.sessions = {};
+  this.keys = [];
+};
+
+
+exports.clientSessions = new SessionCache();
+
+
+// A resumed session skips the certificate checks, so it is only offered to
+// connections that verify the server the way the one that made it did: a
+// connection with a ca or crl of its own must not pick up a session made
+// with the default roots.
+function sessionKey(host, port, options) {
+  return (host || 'localhost') + ':' + port + ':' +
+         crypto.sharedCredentials.digest(options);
+}
+
+
 // AUTHENTICATION MODES
 //
 // There are several levels of authentication that TLS/SSL supports.
@@ -719,6 +983,12 @@ SecurePair.prototype.error = function() {
 // - key. string.
 // - cert: string.
 // - ca: string or array of strings.
+// - sessionCacheSize: number of sessions the server keeps for resumption.
+// - sessionTimeout: seconds after which a session can't be resumed.
+// - sessionIdContext: string, sessions are only resumed within the same
+//   context. Defaults to a digest of the command line.
+// - directSocket: boolean, bind the SSL connections to the socket instead
+//   of a SecurePair. 'secureConnection' then gets the net.Stream.
 //
 // emit 'secureConnection'
 //   function (cleartextStream, encryptedStream) { }
@@ -772,10 +1042,61 @@ function Server(/* [options], listener */) {
     crl: self.crl
   });
 
-  sharedCreds.context.setCiphers('RC4-SHA:AES128-SHA:AES256-SHA');
+  // Without ciphers of its own, the server picks from the defaults for this
+  // CPU, in its order rather than the client's.
+  if (!self.ciphers) {
+    sharedCreds.context.setCiphers();
+    sharedCreds.context.setOptions(SSL_OP_CIPHER_SERVER_PREFERENCE);
+  }
+
+  // All connections share the SSL_CTX, and with it the session cache.
+  sharedCreds.context.setSessionIdContext(self.sessionIdContext);
+  if (typeof self.sessionCacheSize == 'number') {
+    sharedCreds.context.setSessionCacheSize(self.sessionCacheSize);
+  }
+  if (typeof self.sessionTimeout == 'number') {
+    sharedCreds.context.setSessionTimeout(self.sessionTimeout);
+  }
+  this._sharedCreds = sharedCreds;
 
   // constructor call
   net.Server.call(this, function(socket) {
+    if (self.directSocket) {
+      var ssl = new Connection(sharedCreds.context,
+                               true,
+                               self.requestCert,
+                               self.rejectUnauthorized);
+      if (NPN_ENABLED && self.NPNProtocols) {
+        ssl.setNPNProtocols(self.NPNProtocols);
+      }
+
+      // Nobody listens on the socket until 'secureConnection'.
+      function onerror(e) {
+        debug('error before handshake: ' + e.message);
+      }
+      socket.on('error', onerror);
+
+      secureSocket(socket, ssl).on('secure', function() {
+        socket.removeListener('error', onerror);
+
+        if (self.requestCert) {
+          var verifyError = ssl.verifyError();
+          if (verifyError) {
+            socket.authorizationError = verifyError;
+            if (self.rejectUnauthorized) {
+              socket.destroy();
+              return;
+            }
+          } else {
+            socket.authorized = true;
+          }
+        }
+
+        self.emit('secureConnection', socket);
+      });
+      return;
+    }
+
     var creds = crypto.createCredentials(null, sharedCreds.context);
 
     var pair = new SecurePair(creds,
@@ -829,6 +1150,11 @@ exports.createServer = function(options, listener) {
 };
 
 
+Server.prototype.getSessionStats = function() {
+  return this._sharedCreds.context.getSessionStats();
+};
+
+
 Server.prototype.setOptions = function(options) {
   if (typeof options.requestCert == 'boolean') {
     this.requestCert = options.requestCert;
@@ -851,6 +1177,20 @@ Server.prototype.setOptions = function(options) {
   if (options.secureProtocol) this.secureProtocol = options.secureProtocol;
   if (options.secureOptions) this.secureOptions = options.secureOptions;
   if (options.NPNProtocols) convertNPNProtocols(options.NPNProtocols, this);
+  if (typeof options.directSocket == 'boolean') {
+    this.directSocket = options.directSocket;
+  }
+  if (options.sessionCacheSize >= 0) {
+    this.sessionCacheSize = options.sessionCacheSize;
+  }
+  if (options.sessionTimeout > 0) this.sessionTimeout = options.sessionTimeout;
+  if (options.sessionIdContext) {
+    this.sessionIdContext = options.sessionIdContext;
+  } else if (!this.sessionIdContext) {
+    this.sessionIdContext = crypto.createHash('md5')
+                                  .update(process.argv.join(' '))
+                                  .digest('hex');
+  }
 };
 
 
@@ -867,6 +1207,13 @@ Server.prototype.setOptions = function(options) {
 //    s.end("hello world\n");
 //  });
 //
+// Options, besides those of crypto.createCredentials():
+// - session: Buffer, a session from cleartextStream.getSession() to resume.
+// - sessionCache: SessionCache to look the session up in and to store the
+//   new one in, or false. Defaults to tls.clientSessions unless a key or
+//   certificate is given.
+// - directSocket: boolean, return the net.Stream itself with the SSL
+//   connection bound to it, rather than the cleartext side of a SecurePair.
 //
 // TODO:  make port, host part of options!
 exports.connect = function(port /* host, options, cb */) {
@@ -890,21 +1237,53 @@ exports.connect = function(port /* host, options, cb */) {
 
   var socket = new net.Stream();
 
-  var sslcontext = crypto.createCredentials(options);
-  //sslcontext.context.setCiphers('RC4-SHA:AES128-SHA:AES256-SHA');
+  var sslcontext = crypto.sharedCredentials.get(options);
 
   convertNPNProtocols(options.NPNProtocols, this);
-  var pair = new SecurePair(sslcontext, false, true, false,
-                            this.NPNProtocols);
+  var pair, ssl;
+  if (options.directSocket) {
+    ssl = new Connection(sslcontext.context, false, true, false);
+    if (NPN_ENABLED && this.NPNProtocols) {
+      ssl.setNPNProtocols(this.NPNProtocols);
+    }
+  } else {
+    pair = new SecurePair(sslcontext, false, true, false, this.NPNProtocols);
+    ssl = pair.ssl;
+  }
 
-  var cleartext = pipe(pair, socket);
+  var cache = options.sessionCache;
+  if (cache === undefined && !options.key && !options.cert) {
+    cache = exports.clientSessions;
+  }
+  var key = sessionKey(host, port, options);
+  var session = options.session || (cache && cache.get(key));
+
+  // Before ssl.start(), which only comes on the next tick.
+  if (session) ssl.setSession(session);
+
+  var cleartext = pair ? pipe(pair, socket) : secureSocket(socket, ssl);
+  var secured = false;
 
   socket.connect(port, host);
 
-  pair.on('secure', function() {
-    var verifyError = pair.ssl.verifyError();
+  if (cache) {
+    cleartext.on('close', function() {
+      // Don't offer a session again if the handshake failed with it.
+      if (session && !secured) cache.remove(key);
+    });
+  }
+
+  (pair || socket).on('secure', function() {
+    var verifyError = ssl.verifyError();
+    secured = true;
+
+    if (cache) {
+      cache.stats.handshakes++;
+      if (ssl.isSessionReused()) cache.stats.resumed++;
+      cache.set(key, ssl.getSession());
+    }
 
-    cleartext.npnProtocol = pair.npnProtocol;
+    if (pair) cleartext.npnProtocol = pair.npnProtocol;
 
     if (verifyError) {
       cleartext.authorized = false;
@@ -0,0 +1,386 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var binding = process.binding('zlib');
+var util = require('util');
+var Stream = require('stream').Stream;
+var assert = require('assert').ok;
+
+// Compression and decompression streams. The zlib work happens on the
+// thread pool; the streams only move buffers around.
+
+exports.Z_NO_FLUSH = binding.Z_NO_FLUSH;
+exports.Z_SYNC_FLUSH = binding.Z_SYNC_FLUSH;
+exports.Z_FULL_FLUSH = binding.Z_FULL_FLUSH;
+exports.Z_FINISH = binding.Z_FINISH;
+exports.Z_NO_COMPRESSION = binding.Z_NO_COMPRESSION;
+exports.Z_BEST_SPEED = binding.Z_BEST_SPEED;
+exports.Z_BEST_COMPRESSION = binding.Z_BEST_COMPRESSION;
+exports.Z_DEFAULT_COMPRESSION = binding.Z_DEFAULT_COMPRESSION;
+exports.Z_FILTERED = binding.Z_FILTERED;
+exports.Z_HUFFMAN_ONLY = binding.Z_HUFFMAN_ONLY;
+exports.Z_RLE = binding.Z_RLE;
+exports.Z_FIXED = binding.Z_FIXED;
+exports.Z_DEFAULT_STRATEGY = binding.Z_DEFAULT_STRATEGY;
+
+exports.Z_MIN_WINDOWBITS = 8;
+exports.Z_MAX_WINDOWBITS = 15;
+exports.Z_DEFAULT_WINDOWBITS = 15;
+exports.Z_MIN_MEMLEVEL = 1;
+exports.Z_MAX_MEMLEVEL = 9;
+exports.Z_DEFAULT_MEMLEVEL = 8;
+exports.Z_MIN_CHUNK = 64;
+exports.Z_DEFAULT_CHUNK = 16 * 1024;
+
+
+function Deflate(opts) {
+  if (!(this instanceof Deflate)) return new Deflate(opts);
+  Zlib.call(this, opts, binding.DEFLATE);
+}
+util.inherits(Deflate, Zlib);
+
+function Inflate(opts) {
+  if (!(this instanceof Inflate)) return new Inflate(opts);
+  Zlib.call(this, opts, binding.INFLATE);
+}
+util.inherits(Inflate, Zlib);
+
+function Gzip(opts) {
+  if (!(this instanceof Gzip)) return new Gzip(opts);
+  Zlib.call(this, opts, binding.GZIP);
+}
+util.inherits(Gzip, Zlib);
+
+function Gunzip(opts) {
+  if (!(this instanceof Gunzip)) return new Gunzip(opts);
+  Zlib.call(this, opts, binding.GUNZIP);
+}
+util.inherits(Gunzip, Zlib);
+
+function DeflateRaw(opts) {
+  if (!(this instanceof DeflateRaw)) return new DeflateRaw(opts);
+  Zlib.call(this, opts, binding.DEFLATERAW);
+}
+util.inherits(DeflateRaw, Zlib);
+
+function InflateRaw(opts) {
+  if (!(this instanceof InflateRaw)) return new InflateRaw(opts);
+  Zlib.call(this, opts, binding.INFLATERAW);
+}
+util.inherits(InflateRaw, Zlib);
+
+// Inflates either a gzip or a zlib stream, whichever the header says.
+function Unzip(opts) {
+  if (!(this instanceof Unzip)) return new Unzip(opts);
+  Zlib.call(this, opts, binding.UNZIP);
+}
+util.inherits(Unzip, Zlib);
+
+exports.Deflate = Deflate;
+exports.Inflate = Inflate;
+exports.Gzip = Gzip;
+exports.Gunzip = Gunzip;
+exports.DeflateRaw = DeflateRaw;
+exports.InflateRaw = InflateRaw;
+exports.Unzip = Unzip;
+
+exports.createDeflate = function(o) { return new Deflate(o); };
+exports.createInflate = function(o) { return new Inflate(o); };
+exports.createGzip = function(o) { return new Gzip(o); };
+exports.createGunzip = function(o) { return new Gunzip(o); };
+exports.createDeflateRaw = function(o) { return new DeflateRaw(o); };
+exports.createInflateRaw = function(o) { return new InflateRaw(o); };
+exports.createUnzip = function(o) { return new Unzip(o); };
+
+
+// One-shot versions: zlib.gzip(buffer, function(err, result) { ... })
+exports.deflate = function(buffer, callback) {
+  zlibBuffer(new Deflate(), buffer, callback);
+};
+exports.inflate = function(buffer, callback) {
+  zlibBuffer(new Inflate(), buffer, callback);
+};
+exports.gzip = function(buffer, callback) {
+  zlibBuffer(new Gzip(), buffer, callback);
+};
+exports.gunzip = function(buffer, callback) {
+  zlibBuffer(new Gunzip(), buffer, callback);
+};
+exports.deflateRaw = function(buffer, callback) {
+  zlibBuffer(new DeflateRaw(), buffer, callback);
+};
+exports.inflateRaw = function(buffer, callback) {
+  zlibBuffer(new InflateRaw(), buffer, callback);
+};
+exports.unzip = function(buffer, callback) {
+  zlibBuffer(new Unzip(), buffer, callback);
+};
+
+
+function zlibBuffer(engine, buffer, callback) {
+  var buffers = [];
+  var nread = 0;
+
+  engine.on('error', function(err) {
+    engine.removeListener('end', onEnd);
+    callback(err);
+  });
+
+  engine.on('data', function(chunk) {
+    buffers.push(chunk);
+    nread += chunk.length;
+  });
+
+  engine.on('end', onEnd);
+
+  function onEnd() {
+    var result = new Buffer(nread);
+    var pos = 0;
+    for (var i = 0; i < buffers.length; i++) {
+      buffers[i].copy(result, pos);
+      pos += buffers[i].length;
+    }
+    callback(null, result);
+  }
+
+  engine.end(buffer);
+}
+
+
+function checkRange(opts, name, min, max) {
+  var v = opts[name];
+  if (v === undefined) return;
+  if (typeof v !== 'number' || v < min || v > max) {
+    throw new Error('Invalid ' + name + ': ' + v);
+  }
+}
+
+
+// The base class. Writes are queued and handed to the binding one at a
+// time. Output is written into a chunkSize buffer and emitted as slices of
+// it, so a 'data' event does not copy.
+function Zlib(opts, mode) {
+  Stream.call(this);
+
+  opts = opts || {};
+  checkRange(opts, 'chunkSize', exports.Z_MIN_CHUNK, Infinity);
+  checkRange(opts, 'windowBits', exports.Z_MIN_WINDOWBITS,
+             exports.Z_MAX_WINDOWBITS);
+  checkRange(opts, 'level', exports.Z_DEFAULT_COMPRESSION,
+             exports.Z_BEST_COMPRESSION);
+  checkRange(opts, 'memLevel', exports.Z_MIN_MEMLEVEL,
+             exports.Z_MAX_MEMLEVEL);
+  if (opts.strategy !== undefined &&
+      opts.strategy !== exports.Z_FILTERED &&
+      opts.strategy !== exports.Z_HUFFMAN_ONLY &&
+      opts.strategy !== exports.Z_RLE &&
+      opts.strategy !== exports.Z_FIXED &&
+      opts.strategy !== exports.Z_DEFAULT_STRATEGY) {
+    throw new Error('Invalid strategy: ' + opts.strategy);
+  }
+
+  this._binding = new binding.Zlib(mode);
+
+  var self = this;
+  this._binding.onerror = function(message, errno) {
+    self._binding = null;
+    self._hadError = true;
+    self._queue = [];
+    self._processing = false;
+    var error = new Error(message);
+    error.errno = errno;
+    self.emit('error', error);
+  };
+
+  this._binding.init(opts.windowBits || exports.Z_DEFAULT_WINDOWBITS,
+                     opts.level === undefined ? exports.Z_DEFAULT_COMPRESSION :
+                                                opts.level,
+                     opts.memLevel || exports.Z_DEFAULT_MEMLEVEL,
+                     opts.strategy || exports.Z_DEFAULT_STRATEGY);
+
+  this._chunkSize = opts.chunkSize || exports.Z_DEFAULT_CHUNK;
+  this._buffer = new Buffer(this._chunkSize);
+  this._offset = 0;
+  this._queue = [];
+  this._processing = false;
+  this._paused = false;
+  this._needDrain = false;
+  this._ending = false;
+  this._ended = false;
+  this._hadError = false;
+  this._destroyed = false;
+
+  this.readable = true;
+  this.writable = true;
+}
+util.inherits(Zlib, Stream);
+
+
+Zlib.prototype.write = function(chunk, callback) {
+  if (this._hadError) return true;
+  if (this._ended) {
+    this.emit('error', new Error('Cannot write after end'));
+    return false;
+  }
+
+  if (typeof chunk === 'function') {
+    callback = chunk;
+    chunk = null;
+  }
+
+  if (!chunk) {
+    chunk = null;
+  } else if (typeof chunk === 'string') {
+    chunk = new Buffer(chunk);
+  } else if (!Buffer.isBuffer(chunk)) {
+    throw new TypeError('Argument must be a string or a buffer');
+  }
+
+  var flush = this._ending ? binding.Z_FINISH : binding.Z_NO_FLUSH;
+  return this._push(chunk, flush, callback);
+};
+
+
+// Makes everything written so far available to the reader.
+Zlib.prototype.flush = function(callback) {
+  if (this._hadError || this._ended) return true;
+  return this._push(null, binding.Z_SYNC_FLUSH, callback);
+};
+
+
+Zlib.prototype.end = function(chunk, callback) {
+  if (this._hadError || this._ended) return true;
+
+  if (typeof chunk === 'function') {
+    callback = chunk;
+    chunk = null;
+  }
+
+  var self = this;
+  this._ending = true;
+  var r = this.write(chunk, function() {
+    self.readable = false;
+    self.emit('end');
+    if (self._binding) self._binding.close();
+    if (callback) callback();
+  });
+  this._ended = true;
+  this.writable = false;
+  return r;
+};
+
+
+Zlib.prototype.pause = function() {
+  this._paused = true;
+};
+
+
+Zlib.prototype.resume = function() {
+  this._paused = false;
+  this._process();
+};
+
+
+Zlib.prototype.destroy = function() {
+  this.readable = false;
+  this.writable = false;
+  this._ended = true;
+  this._destroyed = true;
+  this._queue = [];
+  if (this._binding && !this._processing) this._binding.close();
+  this.emit('close');
+};
+
+
+Zlib.prototype._push = function(chunk, flush, callback) {
+  var empty = this._queue.length === 0 && !this._processing;
+  this._queue.push([chunk, flush, callback]);
+  this._process();
+  if (!empty) this._needDrain = true;
+  return empty;
+};
+
+
+Zlib.prototype._process = function() {
+  if (this._hadError || this._processing || this._paused) return;
+
+  if (this._queue.length === 0) {
+    if (this._needDrain) {
+      this._needDrain = false;
+      this.emit('drain');
+    }
+    return;
+  }
+
+  var req = this._queue.shift();
+  var chunk = req[0];
+  var flush = req[1];
+  var cb = req[2];
+
+  var self = this;
+  var inOff = 0;
+  var availInBefore = chunk ? chunk.length : 0;
+  var availOutBefore = this._chunkSize - this._offset;
+
+  this._processing = true;
+  this._binding.callback = callback;
+  this._binding.write(flush, chunk, inOff, availInBefore,
+                      this._buffer, this._offset, availOutBefore);
+
+  function callback(availInAfter, availOutAfter) {
+    if (self._hadError) return;
+    if (self._destroyed) {
+      self._processing = false;
+      self._binding.close();
+      return;
+    }
+
+    var have = availOutBefore - availOutAfter;
+    assert(have >= 0, 'have should not go down');
+
+    if (have > 0) {
+      var out = self._buffer.slice(self._offset, self._offset + have);
+      self._offset += have;
+      self.emit('data', out);
+    }
+
+    // The slices handed out keep the old buffer alive; start a new one.
+    if (availOutAfter === 0 || self._offset >= self._chunkSize) {
+      self._buffer = new Buffer(self._chunkSize);
+      self._offset = 0;
+    }
+
+    if (availOutAfter === 0) {
+      // Out of room: zlib has more for us. Go again with the rest of the
+      // input.
+      inOff += availInBefore - availInAfter;
+      availInBefore = availInAfter;
+      availOutBefore = self._chunkSize;
+      self._binding.write(flush, chunk, inOff, availInBefore,
+                          self._buffer, self._offset, availOutBefore);
+      return;
+    }
+
+    self._processing = false;
+    if (cb) cb();
+    self._process();
+  }
+};
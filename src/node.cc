@@ -42,6 +42,9 @@
 #include <node_javascript.h>
 #include <node_string.h>
 #include <node_script.h>
+#ifdef HAVE_OPENSSL
+# include <node_crypto.h>
+#endif
 
 #ifdef ANDROID
 #include <sys/system_properties.h>
@@ -1582,6 +1585,10 @@ void NodeStatic::Initialize() {
   eio_set_max_poll_reqs(10);
   memset(&s_watchers_active, 0, sizeof(s_watchers_active));
 
+#ifdef HAVE_OPENSSL
+  crypto::PreloadCrypto();
+#endif
+
   // start the event loop
   RunEventLoop();
 }
@@ -72,7 +72,7 @@ static Persistent<String> write_sym;
 Persistent<FunctionTemplate> Buffer::constructor_template;
 
 
-static inline size_t base64_decoded_size(const char *src, size_t size) {
+size_t Base64DecodedSize(const char *src, size_t size) {
   const char *const end = src + size;
   const int remainder = size % 4;
 
@@ -104,7 +104,7 @@ static size_t ByteLength (Handle<String> string, enum encoding enc) {
     return string->Utf8Length();
   } else if (enc == BASE64) {
     String::Utf8Value v(string);
-    return base64_decoded_size(*v, v.length());
+    return Base64DecodedSize(*v, v.length());
   } else if (enc == UCS2) {
     return string->Length() * 2;
   } else if (enc == HEX) {
@@ -303,6 +303,25 @@ static const int unbase64_table[] =
   ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
   };
 #define unbase64(x) unbase64_table[(uint8_t)(x)]
+static const int unhex_table[] =
+  {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  , 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,-1,-1,-1,-1,-1,-1
+  ,-1,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  ,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+  };
+#define unhex(x) unhex_table[(uint8_t)(x)]
 
 
 Handle<Value> Buffer::Base64Slice(const Arguments &args) {
@@ -310,69 +329,76 @@ Handle<Value> Buffer::Base64Slice(const Arguments &args) {
   Buffer *parent = ObjectWrap::Unwrap<Buffer>(args.This());
   SLICE_ARGS(args[0], args[1])
 
-  int n = end - start;
-  int out_len = (n + 2 - ((n + 2) % 3)) / 3 * 4;
-  char *out = new char[out_len];
-
-  uint8_t bitbuf[3];
-  int i = start; // data() index
-  int j = 0; // out index
-  char c;
-  bool b1_oob, b2_oob;
-
-  while (i < end) {
-    bitbuf[0] = parent->data_[i++];
-
-    if (i < end) {
-      bitbuf[1] = parent->data_[i];
-      b1_oob = false;
-    }  else {
-      bitbuf[1] = 0;
-      b1_oob = true;
-    }
-    i++;
-
-    if (i < end) {
-      bitbuf[2] = parent->data_[i];
-      b2_oob = false;
-    }  else {
-      bitbuf[2] = 0;
-      b2_oob = true;
-    }
-    i++;
+  return scope.Close(EncodeText(parent->data_ + start, end - start, BASE64));
+}
 
 
-    c = bitbuf[0] >> 2;
-    assert(c < 64);
-    out[j++] = base64_table[(int)c];
-    assert(j < out_len);
+Handle<Value> Buffer::HexSlice(const Arguments &args) {
+  HandleScope scope;
+  Buffer *parent = ObjectWrap::Unwrap<Buffer>(args.This());
+  SLICE_ARGS(args[0], args[1])
 
-    c = ((bitbuf[0] & 0x03) << 4) | (bitbuf[1] >> 4);
-    assert(c < 64);
-    out[j++] = base64_table[(int)c];
-    assert(j < out_len);
+  return scope.Close(EncodeText(parent->data_ + start, end - start, HEX));
+}
+
+
+void HexEncode(const char* src, size_t len, char* dst) {
+  static const char hex_table[] = "0123456789abcdef";
+
+  for (size_t i = 0; i < len; i++) {
+    uint8_t c = src[i];
+    *dst++ = hex_table[c >> 4];
+    *dst++ = hex_table[c & 0x0F];
+  }
+}
 
-    if (b1_oob) {
-      out[j++] = '=';
-    } else {
-      c = ((bitbuf[1] & 0x0F) << 2) | (bitbuf[2] >> 6);
-      assert(c < 64);
-      out[j++] = base64_table[(int)c];
-    }
-    assert(j < out_len);
 
-    if (b2_oob) {
-      out[j++] = '=';
+void Base64Encode(const char* src, size_t len, char* dst) {
+  const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+  size_t i = 0;
+
+  for (; i + 2 < len; i += 3) {
+    *dst++ = base64_table[in[i] >> 2];
+    *dst++ = base64_table[((in[i] & 0x03) << 4) | (in[i + 1] >> 4)];
+    *dst++ = base64_table[((in[i + 1] & 0x0F) << 2) | (in[i + 2] >> 6)];
+    *dst++ = base64_table[in[i + 2] & 0x3F];
+  }
+
+  if (i < len) {
+    *dst++ = base64_table[in[i] >> 2];
+    if (i + 1 < len) {
+      *dst++ = base64_table[((in[i] & 0x03) << 4) | (in[i + 1] >> 4)];
+      *dst++ = base64_table[(in[i + 1] & 0x0F) << 2];
     } else {
-      c = bitbuf[2] & 0x3F;
-      assert(c < 64);
-      out[j++]  = base64_table[(int)c];
+      *dst++ = base64_table[(in[i] & 0x03) << 4];
+      *dst++ = '=';
     }
-    assert(j <= out_len);
+    *dst++ = '=';
   }
+}
+
+
+Local<String> EncodeText(const void* src, size_t len, enum encoding enc) {
+  HandleScope scope;
+
+  assert(enc == HEX || enc == BASE64);
+
+  size_t size = enc == HEX ? HexEncodedSize(len) : Base64EncodedSize(len);
+
+  // Digests and signatures are encoded on the stack, only long text needs
+  // the heap before it is copied into the string.
+  char stack_buf[1024];
+  char* dst = size <= sizeof(stack_buf) ? stack_buf : new char[size];
+
+  if (enc == HEX) {
+    HexEncode(static_cast<const char*>(src), len, dst);
+  } else {
+    Base64Encode(static_cast<const char*>(src), len, dst);
+  }
+
+  Local<String> string = String::New(dst, size);
+  if (dst != stack_buf) delete [] dst;
 
-  Local<String> string = String::New(out, out_len);
-  delete [] out;
   return scope.Close(string);
 }
 
@@ -605,30 +631,35 @@ Handle<Value> Buffer::Base64Write(const Arguments &args) {
             "Offset is out of bounds")));
   }
 
-  const size_t size = base64_decoded_size(*s, s.length());
+  const size_t size = Base64DecodedSize(*s, s.length());
   if (size > buffer->length_ - offset) {
     // throw exception, don't silently truncate
     return ThrowException(Exception::TypeError(String::New(
             "Buffer too small")));
   }
 
+  size_t written = Base64Decode(*s, s.length(), buffer->data_ + offset);
+
+  return scope.Close(Integer::New(written));
+}
+
+
+size_t Base64Decode(const char* src, size_t len, char* dst) {
   char a, b, c, d;
-  char* start = buffer->data_ + offset;
-  char* dst = start;
-  const char *src = *s;
-  const char *const srcEnd = src + s.length();
+  char* start = dst;
+  const char *const srcEnd = src + len;
 
   while (src < srcEnd) {
     int remaining = srcEnd - src;
 
-    while (unbase64(*src) < 0 && src < srcEnd) {
+    while (src < srcEnd && unbase64(*src) < 0) {
       src++;
       remaining--;
     }
     if (remaining == 0 || *src == '=') break;
     a = unbase64(*src++);
 
-    while (unbase64(*src) < 0 && src < srcEnd) {
+    while (src < srcEnd && unbase64(*src) < 0) {
       src++;
       remaining--;
     }
@@ -636,7 +667,7 @@ Handle<Value> Buffer::Base64Write(const Arguments &args) {
     b = unbase64(*src++);
     *dst++ = (a << 2) | ((b & 0x30) >> 4);
 
-    while (unbase64(*src) < 0 && src < srcEnd) {
+    while (src < srcEnd && unbase64(*src) < 0) {
       src++;
       remaining--;
     }
@@ -644,7 +675,7 @@ Handle<Value> Buffer::Base64Write(const Arguments &args) {
     c = unbase64(*src++);
     *dst++ = ((b & 0x0F) << 4) | ((c & 0x3C) >> 2);
 
-    while (unbase64(*src) < 0 && src < srcEnd) {
+    while (src < srcEnd && unbase64(*src) < 0) {
       src++;
       remaining--;
     }
@@ -653,7 +684,64 @@ Handle<Value> Buffer::Base64Write(const Arguments &args) {
     *dst++ = ((c & 0x03) << 6) | (d & 0x3F);
   }
 
-  return scope.Close(Integer::New(dst - start));
+  return dst - start;
+}
+
+
+// var bytesWritten = buffer.hexWrite(string, offset, [maxLength]);
+Handle<Value> Buffer::HexWrite(const Arguments &args) {
+  HandleScope scope;
+
+  Buffer *buffer = ObjectWrap::Unwrap<Buffer>(args.This());
+
+  if (!args[0]->IsString()) {
+    return ThrowException(Exception::TypeError(String::New(
+            "Argument must be a string")));
+  }
+
+  String::AsciiValue s(args[0]->ToString());
+  size_t offset = args[1]->Int32Value();
+
+  // must be an even number of digits
+  if (s.length() % 2) {
+    return ThrowException(Exception::Error(String::New(
+            "Invalid hex string")));
+  }
+
+  size_t size = s.length() / 2;
+  if (size == 0) {
+    return scope.Close(Integer::New(0));
+  }
+
+  if (offset >= buffer->length_) {
+    return ThrowException(Exception::TypeError(String::New(
+            "Offset is out of bounds")));
+  }
+
+  size_t max_length = args[2]->IsUndefined() ? buffer->length_ - offset
+                                             : args[2]->Uint32Value();
+  max_length = MIN(buffer->length_ - offset, max_length);
+  if (size > max_length) size = max_length;
+
+  size_t written = HexDecode(*s, size * 2, buffer->data_ + offset);
+  if (written != size) {
+    return ThrowException(Exception::Error(String::New(
+            "Invalid hex string")));
+  }
+
+  return scope.Close(Integer::New(written));
+}
+
+
+size_t HexDecode(const char* src, size_t len, char* dst) {
+  size_t i;
+  for (i = 0; i < len / 2; i++) {
+    int a = unhex(src[i * 2]);
+    int b = unhex(src[i * 2 + 1]);
+    if (a < 0 || b < 0) break;
+    dst[i] = (a << 4) | b;
+  }
+  return i;
 }
 
 
@@ -758,6 +846,7 @@ void Buffer::Initialize(Handle<Object> target) {
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "binarySlice", Buffer::BinarySlice);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "asciiSlice", Buffer::AsciiSlice);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "base64Slice", Buffer::Base64Slice);
+  NODE_SET_PROTOTYPE_METHOD(constructor_template, "hexSlice", Buffer::HexSlice);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "ucs2Slice", Buffer::Ucs2Slice);
   // TODO NODE_SET_PROTOTYPE_METHOD(t, "utf16Slice", Utf16Slice);
   // copy
@@ -767,6 +856,7 @@ void Buffer::Initialize(Handle<Object> target) {
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "asciiWrite", Buffer::AsciiWrite);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "binaryWrite", Buffer::BinaryWrite);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "base64Write", Buffer::Base64Write);
+  NODE_SET_PROTOTYPE_METHOD(constructor_template, "hexWrite", Buffer::HexWrite);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "ucs2Write", Buffer::Ucs2Write);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "fill", Buffer::Fill);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "copy", Buffer::Copy);
@@ -105,10 +105,12 @@ class Buffer : public ObjectWrap {
   static v8::Handle<v8::Value> BinarySlice(const v8::Arguments &args);
   static v8::Handle<v8::Value> AsciiSlice(const v8::Arguments &args);
   static v8::Handle<v8::Value> Base64Slice(const v8::Arguments &args);
+  static v8::Handle<v8::Value> HexSlice(const v8::Arguments &args);
   static v8::Handle<v8::Value> Utf8Slice(const v8::Arguments &args);
   static v8::Handle<v8::Value> Ucs2Slice(const v8::Arguments &args);
   static v8::Handle<v8::Value> BinaryWrite(const v8::Arguments &args);
   static v8::Handle<v8::Value> Base64Write(const v8::Arguments &args);
+  static v8::Handle<v8::Value> HexWrite(const v8::Arguments &args);
   static v8::Handle<v8::Value> AsciiWrite(const v8::Arguments &args);
   static v8::Handle<v8::Value> Utf8Write(const v8::Arguments &args);
   static v8::Handle<v8::Value> Ucs2Write(const v8::Arguments &args);
@@ -127,6 +129,25 @@ class Buffer : public ObjectWrap {
 };
 
 
+// Table-driven hex and base64, shared with node_crypto. The encoders write
+// HexEncodedSize() or Base64EncodedSize() bytes. The decoders return the
+// number of bytes they wrote, and can decode in place: hex stops at the
+// first pair that is not hex, base64 skips whitespace and stops at the
+// padding.
+inline size_t HexEncodedSize(size_t len) { return len * 2; }
+inline size_t Base64EncodedSize(size_t len) { return (len + 2) / 3 * 4; }
+size_t Base64DecodedSize(const char* src, size_t len);
+
+void HexEncode(const char* src, size_t len, char* dst);
+void Base64Encode(const char* src, size_t len, char* dst);
+size_t HexDecode(const char* src, size_t len, char* dst);
+size_t Base64Decode(const char* src, size_t len, char* dst);
+
+// The HEX or BASE64 text of len bytes, as a string.
+v8::Local<v8::String> EncodeText(const void* src, size_t len,
+                                 enum encoding enc);
+
+
 }  // namespace node buffer
 
 #endif  // NODE_BUFFER_H_
@@ -37,6 +37,9 @@
 
 #ifdef HAVE_OPENSSL
 # include <openssl/ssl.h>
+# ifndef OPENSSL_NO_ENGINE
+#  include <openssl/engine.h>
+# endif
 #endif
 
 namespace node {
@@ -915,6 +918,50 @@ void DefineConstants(Handle<Object> target) {
   NODE_DEFINE_CONSTANT(target, SSL_OP_CRYPTOPRO_TLSEXT_BUG);
 #endif
 
+#ifdef ENGINE_METHOD_RSA
+  NODE_DEFINE_CONSTANT(target, ENGINE_METHOD_RSA);
+#endif
+
+#ifdef ENGINE_METHOD_DSA
+  NODE_DEFINE_CONSTANT(target, ENGINE_METHOD_DSA);
+#endif
+
+#ifdef ENGINE_METHOD_DH
+  NODE_DEFINE_CONSTANT(target, ENGINE_METHOD_DH);
+#endif
+
+#ifdef ENGINE_METHOD_RAND
+  NODE_DEFINE_CONSTANT(target, ENGINE_METHOD_RAND);
+#endif
+
+#ifdef ENGINE_METHOD_ECDH
+  NODE_DEFINE_CONSTANT(target, ENGINE_METHOD_ECDH);
+#endif
+
+#ifdef ENGINE_METHOD_ECDSA
+  NODE_DEFINE_CONSTANT(target, ENGINE_METHOD_ECDSA);
+#endif
+
+#ifdef ENGINE_METHOD_CIPHERS
+  NODE_DEFINE_CONSTANT(target, ENGINE_METHOD_CIPHERS);
+#endif
+
+#ifdef ENGINE_METHOD_DIGESTS
+  NODE_DEFINE_CONSTANT(target, ENGINE_METHOD_DIGESTS);
+#endif
+
+#ifdef ENGINE_METHOD_STORE
+  NODE_DEFINE_CONSTANT(target, ENGINE_METHOD_STORE);
+#endif
+
+#ifdef ENGINE_METHOD_ALL
+  NODE_DEFINE_CONSTANT(target, ENGINE_METHOD_ALL);
+#endif
+
+#ifdef ENGINE_METHOD_NONE
+  NODE_DEFINE_CONSTANT(target, ENGINE_METHOD_NONE);
+#endif
+
 #ifdef OPENSSL_NPN_NEGOTIATED
 #define NPN_ENABLED 1
   NODE_DEFINE_CONSTANT(target, NPN_ENABLED);
@@ -28,9 +28,18 @@
 #include <node_root_certs.h>
 
 #include <string.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+# include <cpuid.h>
+#endif
 
 #if OPENSSL_VERSION_NUMBER >= 0x10000000L
 # define OPENSSL_CONST const
@@ -81,6 +90,14 @@ void SecureContext::Initialize(Handle<Object> target) {
   NODE_SET_PROTOTYPE_METHOD(t, "addRootCerts", SecureContext::AddRootCerts);
   NODE_SET_PROTOTYPE_METHOD(t, "setCiphers", SecureContext::SetCiphers);
   NODE_SET_PROTOTYPE_METHOD(t, "setOptions", SecureContext::SetOptions);
+  NODE_SET_PROTOTYPE_METHOD(t, "setSessionIdContext",
+                            SecureContext::SetSessionIdContext);
+  NODE_SET_PROTOTYPE_METHOD(t, "setSessionCacheSize",
+                            SecureContext::SetSessionCacheSize);
+  NODE_SET_PROTOTYPE_METHOD(t, "setSessionTimeout",
+                            SecureContext::SetSessionTimeout);
+  NODE_SET_PROTOTYPE_METHOD(t, "getSessionStats",
+                            SecureContext::GetSessionStats);
   NODE_SET_PROTOTYPE_METHOD(t, "close", SecureContext::Close);
 
   target->Set(String::NewSymbol("SecureContext"), t->GetFunction());
@@ -147,9 +164,12 @@ Handle<Value> SecureContext::Init(const Arguments& args) {
   }
 
   sc->ctx_ = SSL_CTX_new(method);
-  // Enable session caching?
+  // Servers keep their sessions in the internal cache of the SSL_CTX, which
+  // the server shares between all of its connections. Clients get a fresh
+  // context per connection, so their sessions are exported with
+  // getSession() and handed back with setSession() instead. Session tickets
+  // are left enabled, they travel inside the exported session.
   SSL_CTX_set_session_cache_mode(sc->ctx_, SSL_SESS_CACHE_SERVER);
-  // SSL_CTX_set_session_cache_mode(sc->ctx_,SSL_SESS_CACHE_OFF);
 
   sc->ca_store_ = NULL;
   return True();
@@ -393,38 +413,312 @@ Handle<Value> SecureContext::AddCRL(const Arguments& args) {
 
 
 
-Handle<Value> SecureContext::AddRootCerts(const Arguments& args) {
-  HandleScope scope;
+// OpenSSL is used from more than one thread: the thread pool runs the
+// asynchronous calls, and the root certificates are loaded on a thread of
+// their own. It needs locks for its shared state.
+static pthread_mutex_t* openssl_locks;
+static pthread_once_t openssl_once = PTHREAD_ONCE_INIT;
 
-  SecureContext *sc = ObjectWrap::Unwrap<SecureContext>(args.Holder());
 
-  assert(sc->ca_store_ == NULL);
+static void OpenSSLLock(int mode, int n, const char* file, int line) {
+  if (mode & CRYPTO_LOCK) {
+    pthread_mutex_lock(&openssl_locks[n]);
+  } else {
+    pthread_mutex_unlock(&openssl_locks[n]);
+  }
+}
 
-  if (!root_cert_store) {
-    root_cert_store = X509_STORE_new();
 
-    for (int i = 0; root_certs[i]; i++) {
-      BIO *bp = BIO_new(BIO_s_mem());
+#if OPENSSL_VERSION_NUMBER < 0x10000000L
+// Later versions tell the threads apart by the address of errno.
+static unsigned long OpenSSLThreadId() {
+  return (unsigned long) pthread_self();
+}
+#endif
 
-      if (!BIO_write(bp, root_certs[i], strlen(root_certs[i]))) {
-        BIO_free(bp);
-        return False();
-      }
 
-      X509 *x509 = PEM_read_bio_X509(bp, NULL, NULL, NULL);
+static void InitOpenSSLOnce() {
+  // The application that embeds us may have set up OpenSSL's threading
+  // already; its callbacks stay.
+  if (CRYPTO_get_locking_callback() == NULL) {
+    int n = CRYPTO_num_locks();
+    openssl_locks = new pthread_mutex_t[n];
+    for (int i = 0; i < n; i++) {
+      pthread_mutex_init(&openssl_locks[i], NULL);
+    }
+    CRYPTO_set_locking_callback(OpenSSLLock);
+  }
 
-      if (x509 == NULL) {
-        BIO_free(bp);
-        return False();
-      }
+#if OPENSSL_VERSION_NUMBER < 0x10000000L
+  if (CRYPTO_get_id_callback() == NULL) {
+    CRYPTO_set_id_callback(OpenSSLThreadId);
+  }
+#endif
+
+  SSL_library_init();
+  OpenSSL_add_all_algorithms();
+  OpenSSL_add_all_digests();
+  SSL_load_error_strings();
+  ERR_load_crypto_strings();
 
-      X509_STORE_add_cert(root_cert_store, x509);
+#ifndef OPENSSL_NO_ENGINE
+  // Makes the hardware engines OpenSSL was built with available to
+  // setEngine(). None of them is used until it is selected.
+  ENGINE_load_builtin_engines();
+#endif
 
-      BIO_free(bp);
-      X509_free(x509);
+  // Turn off compression. Saves memory - do it in userland.
+#ifdef SSL_COMP_get_compression_methods
+  // Before OpenSSL 0.9.8 this was not possible.
+  STACK_OF(SSL_COMP)* comp_methods = SSL_COMP_get_compression_methods();
+  sk_SSL_COMP_zero(comp_methods);
+  assert(sk_SSL_COMP_num(comp_methods) == 0);
+#endif
+}
+
+
+static void InitOpenSSL() {
+  pthread_once(&openssl_once, InitOpenSSLOnce);
+}
+
+
+// The root certificates are parsed once per process, into a store that all
+// the SecureContexts of all Node instances share. NodeStatic starts that
+// on a thread of its own at startup, so that the first TLS connection does
+// not have to wait for it.
+static X509_STORE* root_cert_store;
+static pthread_once_t root_cert_once = PTHREAD_ONCE_INIT;
+
+
+static void LoadRootCerts() {
+  X509_STORE* store = X509_STORE_new();
+
+  for (int i = 0; root_certs[i]; i++) {
+    BIO *bp = BIO_new_mem_buf(const_cast<char*>(root_certs[i]), -1);
+    X509 *x509 = PEM_read_bio_X509(bp, NULL, NULL, NULL);
+    BIO_free(bp);
+
+    if (x509 == NULL) {
+      X509_STORE_free(store);
+      return;
+    }
+
+    X509_STORE_add_cert(store, x509);
+    X509_free(x509);
+  }
+
+  root_cert_store = store;
+}
+
+
+// The crypto extensions of the CPU, detected once per process.
+enum {
+  CPU_AES    = 1 << 0,
+  CPU_CLMUL  = 1 << 1,  // Carry-less multiplication, which GCM is built on.
+  CPU_SHA1   = 1 << 2,
+  CPU_SHA256 = 1 << 3,
+  CPU_NEON   = 1 << 4
+};
+static int cpu_features;
+static pthread_once_t cpu_features_once = PTHREAD_ONCE_INIT;
+
+
+static void DetectCPUFeatures() {
+#if defined(__i386__) || defined(__x86_64__)
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    if (ecx & (1 << 25)) cpu_features |= CPU_AES;
+    if (ecx & (1 << 1)) cpu_features |= CPU_CLMUL;
+  }
+  if (__get_cpuid_max(0, NULL) >= 7) {
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (ebx & (1 << 29)) cpu_features |= CPU_SHA1 | CPU_SHA256;
+  }
+#elif defined(__linux__) && (defined(__arm__) || defined(__aarch64__))
+  // There is no unprivileged way to ask the CPU, but the kernel lists the
+  // extensions on the Features line.
+  FILE* fp = fopen("/proc/cpuinfo", "r");
+  if (fp == NULL) return;
+
+  char line[1024];
+  while (fgets(line, sizeof(line), fp)) {
+    char* p = strchr(line, ':');
+    if (strncmp(line, "Features", 8) != 0 || p == NULL) continue;
+
+    char* save;
+    for (char* f = strtok_r(p + 1, " \t\n", &save);
+         f != NULL;
+         f = strtok_r(NULL, " \t\n", &save)) {
+      if (!strcmp(f, "aes")) cpu_features |= CPU_AES;
+      else if (!strcmp(f, "pmull")) cpu_features |= CPU_CLMUL;
+      else if (!strcmp(f, "sha1")) cpu_features |= CPU_SHA1;
+      else if (!strcmp(f, "sha2")) cpu_features |= CPU_SHA256;
+      else if (!strcmp(f, "neon") || !strcmp(f, "asimd")) {
+        cpu_features |= CPU_NEON;
+      }
     }
+    break;
+  }
+
+  fclose(fp);
+#endif
+}
+
+
+static int CPUFeatures() {
+  pthread_once(&cpu_features_once, DetectCPUFeatures);
+  return cpu_features;
+}
+
+
+// The cipher suites SetCiphers() picks when it is not given any. With AES
+// instructions AES is at least as fast as RC4, and AES-GCM faster still;
+// without them RC4 stays in front.
+static const char* DefaultCiphers() {
+  if (CPUFeatures() & CPU_AES) {
+    return "AES128-GCM-SHA256:AES128-SHA:AES256-SHA:RC4-SHA";
   }
+  return "RC4-SHA:AES128-SHA:AES256-SHA";
+}
+
+
+// The throughput of a few ciphers and digests, in kilobytes per second. It
+// is measured once per process, on the preload thread, so the service node
+// and every page get the same numbers without paying for them.
+struct Throughput {
+  const char* name;
+  bool cipher;
+  double kbps;
+};
+
+static Throughput throughput[] = {
+  { "aes-128-cbc", true, 0 },
+  { "aes-256-cbc", true, 0 },
+  { "rc4", true, 0 },
+  { "sha1", false, 0 },
+  { "sha256", false, 0 },
+  { NULL, false, 0 }
+};
+static pthread_once_t throughput_once = PTHREAD_ONCE_INIT;
+
+#define THROUGHPUT_CHUNK 4096
+#define THROUGHPUT_BYTES (256 * 1024)
+
+
+static double KilobytesPerSecond(uint64_t bytes, uint64_t ns) {
+  if (ns == 0) ns = 1;
+  return (bytes / 1024.0) / (ns / 1e9);
+}
+
+
+static double MeasureCipher(const char* name, unsigned char* in,
+                            unsigned char* out) {
+  const EVP_CIPHER* cipher = EVP_get_cipherbyname(name);
+  if (cipher == NULL) return 0;
+
+  unsigned char key[EVP_MAX_KEY_LENGTH];
+  unsigned char iv[EVP_MAX_IV_LENGTH];
+  memset(key, 0x5a, sizeof(key));
+  memset(iv, 0, sizeof(iv));
+
+  EVP_CIPHER_CTX ctx;
+  EVP_CIPHER_CTX_init(&ctx);
+  if (!EVP_EncryptInit_ex(&ctx, cipher, NULL, key, iv)) {
+    EVP_CIPHER_CTX_cleanup(&ctx);
+    return 0;
+  }
+
+  int out_len;
+  uint64_t start = uv_hrtime();
+  for (int n = 0; n < THROUGHPUT_BYTES; n += THROUGHPUT_CHUNK) {
+    EVP_EncryptUpdate(&ctx, out, &out_len, in, THROUGHPUT_CHUNK);
+  }
+  uint64_t elapsed = uv_hrtime() - start;
+
+  EVP_CIPHER_CTX_cleanup(&ctx);
+  return KilobytesPerSecond(THROUGHPUT_BYTES, elapsed);
+}
+
+
+static double MeasureDigest(const char* name, unsigned char* in) {
+  const EVP_MD* md = EVP_get_digestbyname(name);
+  if (md == NULL) return 0;
+
+  unsigned char value[EVP_MAX_MD_SIZE];
+  unsigned int value_len;
+
+  EVP_MD_CTX ctx;
+  EVP_MD_CTX_init(&ctx);
+  EVP_DigestInit_ex(&ctx, md, NULL);
+
+  uint64_t start = uv_hrtime();
+  for (int n = 0; n < THROUGHPUT_BYTES; n += THROUGHPUT_CHUNK) {
+    EVP_DigestUpdate(&ctx, in, THROUGHPUT_CHUNK);
+  }
+  EVP_DigestFinal_ex(&ctx, value, &value_len);
+  uint64_t elapsed = uv_hrtime() - start;
+
+  EVP_MD_CTX_cleanup(&ctx);
+  return KilobytesPerSecond(THROUGHPUT_BYTES, elapsed);
+}
+
+
+static void MeasureThroughput() {
+  unsigned char* in = new unsigned char[THROUGHPUT_CHUNK];
+  unsigned char* out = new unsigned char[THROUGHPUT_CHUNK +
+                                         EVP_MAX_BLOCK_LENGTH];
+  memset(in, 0xa5, THROUGHPUT_CHUNK);
 
+  for (Throughput* t = throughput; t->name; t++) {
+    t->kbps = t->cipher ? MeasureCipher(t->name, in, out)
+                        : MeasureDigest(t->name, in);
+  }
+
+  delete [] in;
+  delete [] out;
+}
+
+
+static void* PreloadThread(void* arg) {
+  pthread_once(&root_cert_once, LoadRootCerts);
+  pthread_once(&cpu_features_once, DetectCPUFeatures);
+  pthread_once(&throughput_once, MeasureThroughput);
+  return NULL;
+}
+
+
+void PreloadCrypto() {
+  InitOpenSSL();
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&thread, &attr, PreloadThread, NULL) != 0) {
+    // AddRootCerts() and getThroughput() will do it.
+    NODE_LOGW("%s, could not start the crypto preload thread",
+              __FUNCTION__);
+  }
+  pthread_attr_destroy(&attr);
+}
+
+
+Handle<Value> SecureContext::AddRootCerts(const Arguments& args) {
+  HandleScope scope;
+
+  SecureContext *sc = ObjectWrap::Unwrap<SecureContext>(args.Holder());
+
+  assert(sc->ca_store_ == NULL);
+
+  // Waits for the background thread if it is still at it.
+  pthread_once(&root_cert_once, LoadRootCerts);
+
+  if (!root_cert_store) {
+    return False();
+  }
+
+  // Every SSL_CTX holds a reference to the one store.
+  CRYPTO_add(&root_cert_store->references, 1, CRYPTO_LOCK_X509_STORE);
   sc->ca_store_ = root_cert_store;
   SSL_CTX_set_cert_store(sc->ctx_, sc->ca_store_);
 
@@ -437,12 +731,22 @@ Handle<Value> SecureContext::SetCiphers(const Arguments& args) {
 
   SecureContext *sc = ObjectWrap::Unwrap<SecureContext>(args.Holder());
 
+  // Without a list, the defaults for this CPU.
+  if (args.Length() == 0 || args[0]->IsUndefined()) {
+    SSL_CTX_set_cipher_list(sc->ctx_, DefaultCiphers());
+    return True();
+  }
+
   if (args.Length() != 1 || !args[0]->IsString()) {
     return ThrowException(Exception::TypeError(String::New("Bad parameter")));
   }
 
   String::Utf8Value ciphers(args[0]->ToString());
-  SSL_CTX_set_cipher_list(sc->ctx_, *ciphers);
+  if (!SSL_CTX_set_cipher_list(sc->ctx_, *ciphers)) {
+    // None of them is known; the previous list stays.
+    ERR_clear_error();
+    return False();
+  }
 
   return True();
 }
@@ -463,6 +767,98 @@ Handle<Value> SecureContext::SetOptions(const Arguments& args) {
   return True();
 }
 
+Handle<Value> SecureContext::SetSessionIdContext(const Arguments& args) {
+  HandleScope scope;
+
+  SecureContext *sc = ObjectWrap::Unwrap<SecureContext>(args.Holder());
+
+  if (args.Length() != 1 || !args[0]->IsString()) {
+    return ThrowException(Exception::TypeError(String::New("Bad parameter")));
+  }
+
+  String::Utf8Value sid_ctx(args[0]->ToString());
+  const unsigned char* sid_ctx_p =
+      reinterpret_cast<const unsigned char*>(*sid_ctx);
+  unsigned int sid_ctx_len = sid_ctx.length();
+
+  // The context is at most SSL_MAX_SID_CTX_LENGTH bytes, callers usually
+  // pass a digest.
+  if (sid_ctx_len > SSL_MAX_SID_CTX_LENGTH) sid_ctx_len = SSL_MAX_SID_CTX_LENGTH;
+
+  if (SSL_CTX_set_session_id_context(sc->ctx_, sid_ctx_p, sid_ctx_len) != 1) {
+    return ThrowException(Exception::Error(
+          String::New("SSL_CTX_set_session_id_context error")));
+  }
+
+  return True();
+}
+
+Handle<Value> SecureContext::SetSessionCacheSize(const Arguments& args) {
+  HandleScope scope;
+
+  SecureContext *sc = ObjectWrap::Unwrap<SecureContext>(args.Holder());
+
+  if (args.Length() != 1 || !args[0]->IsUint32()) {
+    return ThrowException(Exception::TypeError(String::New("Bad parameter")));
+  }
+
+  // 0 means unlimited, use setSessionTimeout() to bound it.
+  SSL_CTX_sess_set_cache_size(sc->ctx_, args[0]->Uint32Value());
+
+  return True();
+}
+
+Handle<Value> SecureContext::SetSessionTimeout(const Arguments& args) {
+  HandleScope scope;
+
+  SecureContext *sc = ObjectWrap::Unwrap<SecureContext>(args.Holder());
+
+  if (args.Length() != 1 || !args[0]->IsUint32()) {
+    return ThrowException(Exception::TypeError(String::New("Bad parameter")));
+  }
+
+  // In seconds.
+  SSL_CTX_set_timeout(sc->ctx_, args[0]->Uint32Value());
+
+  return True();
+}
+
+Handle<Value> SecureContext::GetSessionStats(const Arguments& args) {
+  HandleScope scope;
+
+  SecureContext *sc = ObjectWrap::Unwrap<SecureContext>(args.Holder());
+
+  if (sc->ctx_ == NULL) return Undefined();
+
+  SSL_CTX *ctx = sc->ctx_;
+  Local<Object> info = Object::New();
+  info->Set(String::NewSymbol("size"),
+            Integer::New(SSL_CTX_sess_number(ctx)));
+  info->Set(String::NewSymbol("maxSize"),
+            Integer::New(SSL_CTX_sess_get_cache_size(ctx)));
+  info->Set(String::NewSymbol("timeout"),
+            Integer::New(SSL_CTX_get_timeout(ctx)));
+  // Handshakes started and completed, as a server and as a client.
+  info->Set(String::NewSymbol("accept"),
+            Integer::New(SSL_CTX_sess_accept(ctx)));
+  info->Set(String::NewSymbol("acceptGood"),
+            Integer::New(SSL_CTX_sess_accept_good(ctx)));
+  info->Set(String::NewSymbol("connect"),
+            Integer::New(SSL_CTX_sess_connect(ctx)));
+  info->Set(String::NewSymbol("connectGood"),
+            Integer::New(SSL_CTX_sess_connect_good(ctx)));
+  // Resumed sessions, and what the server cache could not provide.
+  info->Set(String::NewSymbol("hits"),
+            Integer::New(SSL_CTX_sess_hits(ctx)));
+  info->Set(String::NewSymbol("misses"),
+            Integer::New(SSL_CTX_sess_misses(ctx)));
+  info->Set(String::NewSymbol("timeouts"),
+            Integer::New(SSL_CTX_sess_timeouts(ctx)));
+  info->Set(String::NewSymbol("cacheFull"),
+            Integer::New(SSL_CTX_sess_cache_full(ctx)));
+  return scope.Close(info);
+}
+
 Handle<Value> SecureContext::Close(const Arguments& args) {
   HandleScope scope;
   SecureContext *sc = ObjectWrap::Unwrap<SecureContext>(args.Holder());
@@ -580,6 +976,11 @@ void Connection::Initialize(Handle<Object> target) {
   NODE_SET_PROTOTYPE_METHOD(t, "isInitFinished", Connection::IsInitFinished);
   NODE_SET_PROTOTYPE_METHOD(t, "verifyError", Connection::VerifyError);
   NODE_SET_PROTOTYPE_METHOD(t, "getCurrentCipher", Connection::GetCurrentCipher);
+  NODE_SET_PROTOTYPE_METHOD(t, "getSession", Connection::GetSession);
+  NODE_SET_PROTOTYPE_METHOD(t, "setSession", Connection::SetSession);
+  NODE_SET_PROTOTYPE_METHOD(t, "isSessionReused", Connection::IsSessionReused);
+  NODE_SET_PROTOTYPE_METHOD(t, "setFD", Connection::SetFD);
+  NODE_SET_PROTOTYPE_METHOD(t, "wantWrite", Connection::WantWrite);
   NODE_SET_PROTOTYPE_METHOD(t, "start", Connection::Start);
   NODE_SET_PROTOTYPE_METHOD(t, "shutdown", Connection::Shutdown);
   NODE_SET_PROTOTYPE_METHOD(t, "receivedShutdown", Connection::ReceivedShutdown);
@@ -788,6 +1189,11 @@ Handle<Value> Connection::EncIn(const Arguments& args) {
 
   Connection *ss = Connection::Unwrap(args);
 
+  if (ss->is_socket_) {
+    return ThrowException(Exception::Error(
+          String::New("Connection is bound to a socket")));
+  }
+
   if (args.Length() < 3) {
     return ThrowException(Exception::TypeError(
           String::New("Takes 3 parameters")));
@@ -880,6 +1286,9 @@ Handle<Value> Connection::ClearPending(const Arguments& args) {
 
   Connection *ss = Connection::Unwrap(args);
 
+  // On a socket, what is left of the record SSL_read() is working on.
+  if (ss->is_socket_) return scope.Close(Integer::New(SSL_pending(ss->ssl_)));
+
   int bytes_pending = BIO_pending(ss->bio_read_);
   return scope.Close(Integer::New(bytes_pending));
 }
@@ -890,6 +1299,8 @@ Handle<Value> Connection::EncPending(const Arguments& args) {
 
   Connection *ss = Connection::Unwrap(args);
 
+  if (ss->is_socket_) return scope.Close(Integer::New(0));
+
   int bytes_pending = BIO_pending(ss->bio_write_);
   return scope.Close(Integer::New(bytes_pending));
 }
@@ -900,6 +1311,11 @@ Handle<Value> Connection::EncOut(const Arguments& args) {
 
   Connection *ss = Connection::Unwrap(args);
 
+  if (ss->is_socket_) {
+    return ThrowException(Exception::Error(
+          String::New("Connection is bound to a socket")));
+  }
+
   if (args.Length() < 3) {
     return ThrowException(Exception::TypeError(
           String::New("Takes 3 parameters")));
@@ -1284,6 +1700,116 @@ Handle<Value> Connection::GetCurrentCipher(const Arguments& args) {
   return scope.Close(info);
 }
 
+Handle<Value> Connection::GetSession(const Arguments& args) {
+  HandleScope scope;
+
+  Connection *ss = Connection::Unwrap(args);
+
+  if (ss->ssl_ == NULL) return Undefined();
+
+  SSL_SESSION* sess = SSL_get_session(ss->ssl_);
+  if (sess == NULL) return Undefined();
+
+  int slen = i2d_SSL_SESSION(sess, NULL);
+  if (slen <= 0) return Undefined();
+
+  Buffer *b = Buffer::New(slen);
+  unsigned char* p = reinterpret_cast<unsigned char*>(Buffer::Data(b));
+  i2d_SSL_SESSION(sess, &p);
+
+  return scope.Close(b->handle_);
+}
+
+Handle<Value> Connection::SetSession(const Arguments& args) {
+  HandleScope scope;
+
+  Connection *ss = Connection::Unwrap(args);
+
+  if (args.Length() < 1 || !Buffer::HasInstance(args[0])) {
+    return ThrowException(Exception::TypeError(
+          String::New("Argument must be a buffer")));
+  }
+
+  if (ss->ssl_ == NULL) return False();
+
+  Local<Object> buffer_obj = args[0]->ToObject();
+  const unsigned char* p =
+      reinterpret_cast<const unsigned char*>(Buffer::Data(buffer_obj));
+  long slen = Buffer::Length(buffer_obj);
+
+  SSL_SESSION* sess = d2i_SSL_SESSION(NULL, &p, slen);
+  if (sess == NULL) {
+    ERR_clear_error();
+    return ThrowException(Exception::Error(String::New("Bad session")));
+  }
+
+  // SSL_set_session() takes its own reference.
+  int r = SSL_set_session(ss->ssl_, sess);
+  SSL_SESSION_free(sess);
+
+  if (r != 1) {
+    ERR_clear_error();
+    return ThrowException(Exception::Error(
+          String::New("SSL_set_session error")));
+  }
+
+  return True();
+}
+
+Handle<Value> Connection::IsSessionReused(const Arguments& args) {
+  HandleScope scope;
+
+  Connection *ss = Connection::Unwrap(args);
+
+  if (ss->ssl_ == NULL) return False();
+  return SSL_session_reused(ss->ssl_) ? True() : False();
+}
+
+// Binds the connection to a non-blocking socket. SSL_read() and SSL_write()
+// then receive and send the records themselves, encIn() and encOut() are
+// no longer used and only the cleartext crosses into javascript.
+Handle<Value> Connection::SetFD(const Arguments& args) {
+  HandleScope scope;
+
+  Connection *ss = Connection::Unwrap(args);
+
+  if (args.Length() < 1 || !args[0]->IsInt32()) {
+    return ThrowException(Exception::TypeError(
+          String::New("Bad file descriptor argument")));
+  }
+
+  if (ss->ssl_ == NULL) return False();
+
+  BIO *bio = BIO_new_socket(args[0]->Int32Value(), BIO_NOCLOSE);
+  if (bio == NULL) {
+    return ThrowException(Exception::Error(String::New("BIO_new_socket error")));
+  }
+
+  // Frees the memory BIOs.
+  SSL_set_bio(ss->ssl_, bio, bio);
+  ss->bio_read_ = ss->bio_write_ = bio;
+  ss->is_socket_ = true;
+
+  // A write the socket could only take part of is retried with what the
+  // caller has left, from wherever it keeps it.
+  long mode = SSL_get_mode(ss->ssl_);
+  SSL_set_mode(ss->ssl_, mode | SSL_MODE_ENABLE_PARTIAL_WRITE
+                              | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+  return True();
+}
+
+// Whether the last call that did not complete waits for the socket to
+// become writable, rather than readable.
+Handle<Value> Connection::WantWrite(const Arguments& args) {
+  HandleScope scope;
+
+  Connection *ss = Connection::Unwrap(args);
+
+  if (ss->ssl_ == NULL) return False();
+  return SSL_want_write(ss->ssl_) ? True() : False();
+}
+
 Handle<Value> Connection::Close(const Arguments& args) {
   HandleScope scope;
 
@@ -1339,74 +1865,6 @@ Handle<Value> Connection::SetNPNProtocols(const Arguments& args) {
 #endif
 
 
-static void HexEncode(unsigned char *md_value,
-                      int md_len,
-                      char** md_hexdigest,
-                      int* md_hex_len) {
-  *md_hex_len = (2*(md_len));
-  *md_hexdigest = new char[*md_hex_len + 1];
-  for (int i = 0; i < md_len; i++) {
-    snprintf((char *)(*md_hexdigest + (i*2)), 3, "%02x",  md_value[i]);
-  }
-}
-
-#define hex2i(c) ((c) <= '9' ? ((c) - '0') : (c) <= 'Z' ? ((c) - 'A' + 10) \
-                 : ((c) - 'a' + 10))
-
-static void HexDecode(unsigned char *input,
-                      int length,
-                      char** buf64,
-                      int* buf64_len) {
-  *buf64_len = (length/2);
-  *buf64 = new char[length/2 + 1];
-  char *b = *buf64;
-  for(int i = 0; i < length-1; i+=2) {
-    b[i/2]  = (hex2i(input[i])<<4) | (hex2i(input[i+1]));
-  }
-}
-
-
-void base64(unsigned char *input, int length, char** buf64, int* buf64_len) {
-  BIO *b64 = BIO_new(BIO_f_base64());
-  BIO *bmem = BIO_new(BIO_s_mem());
-  b64 = BIO_push(b64, bmem);
-  BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-  int len = BIO_write(b64, input, length);
-  assert(len == length);
-  int r = BIO_flush(b64);
-  assert(r == 1);
-
-  BUF_MEM *bptr;
-  BIO_get_mem_ptr(b64, &bptr);
-
-  *buf64_len = bptr->length;
-  *buf64 = new char[*buf64_len+1];
-  memcpy(*buf64, bptr->data, *buf64_len);
-  char* b = *buf64;
-  b[*buf64_len] = 0;
-
-  BIO_free_all(b64);
-}
-
-
-void unbase64(unsigned char *input,
-               int length,
-               char** buffer,
-               int* buffer_len) {
-  BIO *b64, *bmem;
-  *buffer = new char[length];
-  memset(*buffer, 0, length);
-
-  b64 = BIO_new(BIO_f_base64());
-  BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-  bmem = BIO_new_mem_buf(input, length);
-  bmem = BIO_push(b64, bmem);
-
-  *buffer_len = BIO_read(bmem, *buffer, length);
-  BIO_free_all(bmem);
-}
-
-
 // LengthWithoutIncompleteUtf8 from V8 d8-posix.cc
 // see http://v8.googlecode.com/svn/trunk/src/d8-posix.cc
 static int LengthWithoutIncompleteUtf8(char* buffer, int len) {
@@ -1520,7 +1978,491 @@ int local_EVP_DecryptFinal_ex(EVP_CIPHER_CTX *ctx,
 }
 
 
-class Cipher : public ObjectWrap {
+// Work for the eio thread pool. Process() runs in the pool and must not
+// touch V8; After() runs on the loop thread, inside the context of the
+// callback, and the work is deleted when it returns.
+class AsyncWork {
+ public:
+  AsyncWork(Handle<Value> callback) {
+    callback_ = Persistent<Function>::New(Handle<Function>::Cast(callback));
+  }
+
+  virtual ~AsyncWork() {
+    callback_.Dispose();
+  }
+
+  void Queue() {
+    eio_custom(EIO_Process, EIO_PRI_DEFAULT, EIO_After, this);
+    // Nothing is on the event loop while the pool works.
+    uv_ref();
+  }
+
+ protected:
+  virtual void Process() = 0;
+  virtual void After() = 0;
+
+  void MakeCallback(int argc, Handle<Value> argv[]) {
+    TryCatch try_catch;
+    callback_->Call(callback_->CreationContext()->Global(), argc, argv);
+    if (try_catch.HasCaught()) {
+      Node::FatalException(try_catch);
+    }
+  }
+
+  Persistent<Function> callback_;
+
+ private:
+  static int EIO_Process(eio_req *req) {
+    static_cast<AsyncWork*>(req->data)->Process();
+    return 0;
+  }
+
+  static int EIO_After(eio_req *req) {
+    AsyncWork *work = static_cast<AsyncWork*>(req->data);
+    uv_unref();
+    HandleScope scope;
+    Context::Scope cscope(work->callback_->CreationContext());
+    work->After();
+    delete work;
+    return 0;
+  }
+};
+
+
+static inline bool HasCallback(const Arguments& args) {
+  return args.Length() > 0 && args[args.Length() - 1]->IsFunction();
+}
+
+
+static Local<Value> EncodeDigest(unsigned char* md_value,
+                                 unsigned int md_len,
+                                 Handle<Value> encoding_v) {
+  HandleScope scope;
+
+  if (md_len == 0) {
+    return scope.Close(String::New(""));
+  }
+
+  if (encoding_v.IsEmpty() || !encoding_v->IsString()) {
+    return scope.Close(Node::Encode(md_value, md_len, BINARY));
+  }
+
+  Local<Value> outString;
+  String::Utf8Value encoding(encoding_v->ToString());
+  if (strcasecmp(*encoding, "hex") == 0) {
+    outString = EncodeText(md_value, md_len, HEX);
+  } else if (strcasecmp(*encoding, "base64") == 0) {
+    outString = EncodeText(md_value, md_len, BASE64);
+  } else if (strcasecmp(*encoding, "binary") == 0) {
+    outString = Node::Encode(md_value, md_len, BINARY);
+  } else {
+    fprintf(stderr, "node-crypto : digest encoding "
+                    "can be binary, hex or base64\n");
+    outString = Node::Encode(md_value, md_len, BINARY);
+  }
+
+  return scope.Close(outString);
+}
+
+
+// Asynchronous calls check their output encoding before they are queued;
+// by the time the callback runs there is nobody left to throw at.
+static bool IsDigestEncoding(Handle<Value> encoding_v) {
+  if (encoding_v.IsEmpty() || !encoding_v->IsString()) return true;
+
+  String::Utf8Value encoding(encoding_v->ToString());
+  return strcasecmp(*encoding, "hex") == 0 ||
+         strcasecmp(*encoding, "base64") == 0 ||
+         strcasecmp(*encoding, "binary") == 0;
+}
+
+
+static Handle<Value> ThrowBadEncoding() {
+  return ThrowException(Exception::TypeError(String::New(
+      "Encoding can be binary, hex or base64")));
+}
+
+
+// An ObjectWrap whose asynchronous calls are queued and run one at a time,
+// in order. Synchronous calls are refused until the queue has drained.
+class SerialWrap : public ObjectWrap {
+ public:
+  SerialWrap() : ObjectWrap(), head_(NULL), tail_(NULL) {
+  }
+
+  virtual ~SerialWrap() {
+    assert(head_ == NULL);
+  }
+
+  bool Busy() const {
+    return head_ != NULL;
+  }
+
+ protected:
+  class Op : public AsyncWork {
+   public:
+    Op(SerialWrap* owner, Handle<Value> callback)
+        : AsyncWork(callback), owner_(owner), next_(NULL) {
+    }
+
+   protected:
+    // Run on the loop thread: Start() when the call gets to the head of the
+    // queue, just before it goes to the pool, and Finish() as soon as the
+    // pool is done with it, before the next call starts.
+    virtual void Start() {}
+    virtual void Finish() {}
+
+    // Runs on the loop thread once the next call has been started.
+    virtual void Done() = 0;
+
+    SerialWrap* owner_;
+
+   private:
+    void After() {
+      SerialWrap* owner = owner_;
+
+      Finish();
+
+      // Start the next one before calling back, the pool can work on it
+      // in the meantime.
+      assert(owner->head_ == this);
+      owner->head_ = next_;
+      if (next_) {
+        next_->Start();
+        next_->Queue();
+      } else {
+        owner->tail_ = NULL;
+      }
+
+      Done();
+      owner->Unref();
+    }
+
+    Op* next_;
+
+    friend class SerialWrap;
+  };
+
+  void Enqueue(Op* op) {
+    Ref();
+    if (tail_) {
+      tail_->next_ = op;
+      tail_ = op;
+    } else {
+      head_ = tail_ = op;
+      op->Start();
+      op->Queue();
+    }
+  }
+
+  static Handle<Value> ThrowBusy() {
+    return ThrowException(Exception::Error(String::New(
+        "An asynchronous call is in progress")));
+  }
+
+ private:
+  Op* head_;
+  Op* tail_;
+
+  friend class Op;
+};
+
+
+// The common part of Hash and Hmac: update() and digest() take an optional
+// callback, in which case the work is done on the thread pool.
+class Digest : public SerialWrap {
+ public:
+  // Run on the thread pool for asynchronous calls.
+  virtual int DigestUpdate(char* data, int len) = 0;
+  virtual int DigestFinal(unsigned char* md_value, unsigned int* md_len) = 0;
+
+ protected:
+  class DigestOp : public Op {
+   public:
+    DigestOp(Digest* digest, Handle<Value> callback)
+        : Op(digest, callback), data_(NULL), copy_(NULL), len_(0),
+          final_(false), md_len_(0), r_(0) {
+    }
+
+    ~DigestOp() {
+      delete [] copy_;
+      buffer_.Dispose();
+      encoding_.Dispose();
+    }
+
+    void Process() {
+      Digest* digest = static_cast<Digest*>(owner_);
+      if (final_) {
+        r_ = digest->DigestFinal(md_value_, &md_len_);
+      } else {
+        r_ = digest->DigestUpdate(data_, len_);
+      }
+    }
+
+    void Done() {
+      if (!r_) {
+        Local<Value> argv[1] = {
+          Exception::Error(String::New(final_ ? "Not initialized" :
+                                                "Update fail"))
+        };
+        MakeCallback(1, argv);
+      } else if (final_) {
+        Local<Value> argv[2] = {
+          Local<Value>::New(Null()),
+          EncodeDigest(md_value_, md_len_, encoding_)
+        };
+        MakeCallback(2, argv);
+      } else {
+        Local<Value> argv[1] = { Local<Value>::New(Null()) };
+        MakeCallback(1, argv);
+      }
+    }
+
+    // update()
+    Persistent<Object> buffer_;
+    char* data_;
+    char* copy_;
+    int len_;
+
+    // digest()
+    bool final_;
+    Persistent<Value> encoding_;
+    unsigned char md_value_[EVP_MAX_MD_SIZE];
+    unsigned int md_len_;
+
+    int r_;
+  };
+
+  // update(data, [encoding], callback)
+  static Handle<Value> UpdateAsync(Digest* digest, const Arguments& args) {
+    HandleScope scope;
+
+    NODE_ASSERT_IS_STRING_OR_BUFFER(args[0]);
+
+    DigestOp* op = new DigestOp(digest, args[args.Length() - 1]);
+
+    if (Buffer::HasInstance(args[0])) {
+      // The pool reads straight from the buffer; keep it alive until then.
+      Local<Object> buffer_obj = args[0]->ToObject();
+      op->buffer_ = Persistent<Object>::New(buffer_obj);
+      op->data_ = Buffer::Data(buffer_obj);
+      op->len_ = Buffer::Length(buffer_obj);
+    } else {
+      enum encoding enc = args.Length() > 2 ?
+          Node::ParseEncoding(args[1]) : BINARY;
+      ssize_t len = Node::DecodeBytes(args[0], enc);
+      if (len < 0) {
+        delete op;
+        Local<Value> exception = Exception::TypeError(String::New("Bad argument"));
+        return ThrowException(exception);
+      }
+      op->copy_ = new char[len];
+      ssize_t written = Node::DecodeWrite(op->copy_, len, args[0], enc);
+      assert(written == len);
+      op->data_ = op->copy_;
+      op->len_ = len;
+    }
+
+    digest->Enqueue(op);
+    return args.This();
+  }
+
+  // digest([encoding], callback)
+  static Handle<Value> DigestAsync(Digest* digest, const Arguments& args) {
+    HandleScope scope;
+
+    if (args.Length() > 1 && !IsDigestEncoding(args[0])) {
+      return ThrowBadEncoding();
+    }
+
+    DigestOp* op = new DigestOp(digest, args[args.Length() - 1]);
+    op->final_ = true;
+    if (args.Length() > 1) {
+      op->encoding_ = Persistent<Value>::New(args[0]);
+    }
+
+    digest->Enqueue(op);
+    return Undefined();
+  }
+};
+
+
+// Output space for asynchronous cipher calls. Small outputs are carved out
+// of a shared slab, like the read buffers of tcp_wrap; big ones get a
+// buffer of their own. Like tcp_wrap, the callback gets the slab, an offset
+// and a length, and lib/crypto.js makes the Buffer.
+#define CIPHER_SLAB_SIZE (256 * 1024)
+#define CIPHER_SLAB_MAX (16 * 1024)
+
+static Persistent<Object> cipher_slab;
+static Persistent<Context> cipher_slab_context;
+static size_t cipher_slab_used;
+
+static Local<Object> AllocCipherOutput(size_t size, size_t* offset) {
+  HandleScope scope;
+
+  if (size > CIPHER_SLAB_MAX) {
+    *offset = 0;
+    return scope.Close(Local<Object>::New(Buffer::New(size)->handle_));
+  }
+
+  // proteus: a slab belongs to the context of the page that made it.
+  Local<Context> context = Context::GetCurrent();
+  if (cipher_slab.IsEmpty() ||
+      cipher_slab_context != context ||
+      CIPHER_SLAB_SIZE - cipher_slab_used < size) {
+    cipher_slab.Dispose();
+    cipher_slab_context.Dispose();
+    cipher_slab = Persistent<Object>::New(
+        Buffer::New(CIPHER_SLAB_SIZE)->handle_);
+    cipher_slab_context = Persistent<Context>::New(context);
+    cipher_slab_used = 0;
+  }
+
+  *offset = cipher_slab_used;
+  cipher_slab_used += size;
+  return scope.Close(Local<Object>::New(cipher_slab));
+}
+
+// Gives back the part of the last reservation that was not used.
+static void ShrinkCipherOutput(Handle<Object> buffer,
+                               size_t offset,
+                               size_t reserved,
+                               size_t used) {
+  if (!cipher_slab.IsEmpty() &&
+      buffer == cipher_slab &&
+      offset + reserved == cipher_slab_used) {
+    cipher_slab_used = offset + used;
+  }
+}
+
+// The common part of Cipher and Decipher: update(buffer, callback) and
+// final(callback) run on the thread pool and pass the output to the
+// callback as a Buffer. No string encodings are involved.
+class CipherBase : public SerialWrap {
+ public:
+  // Run on the thread pool for asynchronous calls. out has room for the
+  // input plus EVP_MAX_BLOCK_LENGTH.
+  virtual int CipherBaseUpdate(unsigned char* data, int len,
+                               unsigned char* out, int* out_len) = 0;
+  virtual int CipherBaseFinal(unsigned char* out, int* out_len) = 0;
+
+ protected:
+  class CipherOp : public Op {
+   public:
+    CipherOp(CipherBase* cipher, Handle<Value> callback)
+        : Op(cipher, callback), data_(NULL), len_(0), out_data_(NULL),
+          out_offset_(0), out_reserved_(0), out_len_(0), final_(false),
+          r_(0) {
+    }
+
+    ~CipherOp() {
+      buffer_.Dispose();
+      out_.Dispose();
+    }
+
+    void Process() {
+      CipherBase* cipher = static_cast<CipherBase*>(owner_);
+      if (final_) {
+        r_ = cipher->CipherBaseFinal(out_data_, &out_len_);
+      } else {
+        r_ = cipher->CipherBaseUpdate(data_, len_, out_data_, &out_len_);
+      }
+      if (!r_) ERR_clear_error();
+    }
+
+    // The output space is only taken when the call is about to run, so
+    // queued calls don't hold on to any.
+    void Start() {
+      HandleScope scope;
+      Local<Object> out = AllocCipherOutput(out_reserved_, &out_offset_);
+      out_ = Persistent<Object>::New(out);
+      out_data_ =
+          reinterpret_cast<unsigned char*>(Buffer::Data(out)) + out_offset_;
+    }
+
+    void Finish() {
+      ShrinkCipherOutput(out_, out_offset_, out_reserved_, r_ ? out_len_ : 0);
+    }
+
+    void Done() {
+      HandleScope scope;
+
+      if (!r_) {
+        Local<Value> argv[1] = {
+          Exception::Error(String::New(final_ ? "Cipher final failed" :
+                                                "Cipher update failed"))
+        };
+        MakeCallback(1, argv);
+      } else {
+        Local<Value> argv[4] = {
+          Local<Value>::New(Null()),
+          Local<Value>::New(out_),
+          Integer::NewFromUnsigned(out_offset_),
+          Integer::New(out_len_)
+        };
+        MakeCallback(4, argv);
+      }
+    }
+
+    Persistent<Object> buffer_;
+    unsigned char* data_;
+    int len_;
+
+    Persistent<Object> out_;
+    unsigned char* out_data_;
+    size_t out_offset_;
+    size_t out_reserved_;
+    int out_len_;
+
+    bool final_;
+    int r_;
+  };
+
+  void EnqueueWithOutput(CipherOp* op, size_t size) {
+    op->out_reserved_ = size;
+    Enqueue(op);
+  }
+
+  // update(buffer, callback)
+  static Handle<Value> UpdateAsync(CipherBase* cipher, const Arguments& args) {
+    HandleScope scope;
+
+    if (!Buffer::HasInstance(args[0])) {
+      return ThrowException(Exception::TypeError(String::New(
+          "Asynchronous update needs a buffer")));
+    }
+
+    Local<Object> buffer_obj = args[0]->ToObject();
+    size_t len = Buffer::Length(buffer_obj);
+    if (len > INT_MAX - EVP_MAX_BLOCK_LENGTH) {
+      return ThrowException(Exception::RangeError(String::New(
+          "Buffer too big")));
+    }
+
+    CipherOp* op = new CipherOp(cipher, args[args.Length() - 1]);
+    op->buffer_ = Persistent<Object>::New(buffer_obj);
+    op->data_ = reinterpret_cast<unsigned char*>(Buffer::Data(buffer_obj));
+    op->len_ = len;
+
+    cipher->EnqueueWithOutput(op, len + EVP_MAX_BLOCK_LENGTH);
+    return args.This();
+  }
+
+  // final(callback)
+  static Handle<Value> FinalAsync(CipherBase* cipher, const Arguments& args) {
+    HandleScope scope;
+
+    CipherOp* op = new CipherOp(cipher, args[args.Length() - 1]);
+    op->final_ = true;
+
+    cipher->EnqueueWithOutput(op, EVP_MAX_BLOCK_LENGTH);
+    return Undefined();
+  }
+};
+
+
+class Cipher : public CipherBase {
  public:
   static void Initialize (v8::Handle<v8::Object> target) {
     HandleScope scope;
@@ -1604,6 +2546,20 @@ class Cipher : public ObjectWrap {
     return 1;
   }
 
+  int CipherBaseUpdate(unsigned char* data, int len,
+                       unsigned char* out, int* out_len) {
+    if (!initialised_) return 0;
+    return EVP_CipherUpdate(&ctx, out, out_len, data, len);
+  }
+
+  int CipherBaseFinal(unsigned char* out, int* out_len) {
+    if (!initialised_) return 0;
+    int r = EVP_CipherFinal(&ctx, out, out_len);
+    EVP_CIPHER_CTX_cleanup(&ctx);
+    initialised_ = false;
+    return r;
+  }
+
 
  protected:
 
@@ -1620,6 +2576,8 @@ class Cipher : public ObjectWrap {
 
     Cipher *cipher = ObjectWrap::Unwrap<Cipher>(args.This());
 
+    if (cipher->Busy()) return ThrowBusy();
+
     cipher->incomplete_base64=NULL;
 
     if (args.Length() <= 1 || !args[0]->IsString() || !args[1]->IsString()) {
@@ -1658,6 +2616,8 @@ class Cipher : public ObjectWrap {
 
     HandleScope scope;
 
+    if (cipher->Busy()) return ThrowBusy();
+
     cipher->incomplete_base64=NULL;
 
     if (args.Length() <= 2 || !args[0]->IsString() || !args[1]->IsString() || !args[2]->IsString()) {
@@ -1708,6 +2668,9 @@ class Cipher : public ObjectWrap {
 
     HandleScope scope;
 
+    if (HasCallback(args)) return UpdateAsync(cipher, args);
+    if (cipher->Busy()) return ThrowBusy();
+
     NODE_ASSERT_IS_STRING_OR_BUFFER(args[0]);
 
     enum encoding enc = Node::ParseEncoding(args[1]);
@@ -1748,14 +2711,9 @@ class Cipher : public ObjectWrap {
         // Binary
         outString = Node::Encode(out, out_len, BINARY);
       } else {
-        char* out_hexdigest;
-        int out_hex_len;
         String::Utf8Value encoding(args[2]->ToString());
         if (strcasecmp(*encoding, "hex") == 0) {
-          // Hex encoding
-          HexEncode(out, out_len, &out_hexdigest, &out_hex_len);
-          outString = Node::Encode(out_hexdigest, out_hex_len, BINARY);
-          delete [] out_hexdigest;
+          outString = EncodeText(out, out_len, HEX);
         } else if (strcasecmp(*encoding, "base64") == 0) {
           // Base64 encoding
           // Check to see if we need to add in previous base64 overhang
@@ -1783,9 +2741,7 @@ class Cipher : public ObjectWrap {
             out[out_len]=0;
           }
 
-          base64(out, out_len, &out_hexdigest, &out_hex_len);
-          outString = Node::Encode(out_hexdigest, out_hex_len, BINARY);
-          delete [] out_hexdigest;
+          outString = EncodeText(out, out_len, BASE64);
         } else if (strcasecmp(*encoding, "binary") == 0) {
           outString = Node::Encode(out, out_len, BINARY);
         } else {
@@ -1805,11 +2761,12 @@ class Cipher : public ObjectWrap {
 
     HandleScope scope;
 
+    if (HasCallback(args)) return FinalAsync(cipher, args);
+    if (cipher->Busy()) return ThrowBusy();
+
     // proteus: fix g++ warning, initialize out_value, out_hexdigest
     unsigned char* out_value = 0;
     int out_len;
-    char* out_hexdigest = 0;
-    int out_hex_len;
     Local<Value> outString ;
 
     int r = cipher->CipherFinal(&out_value, &out_len);
@@ -1824,14 +2781,9 @@ class Cipher : public ObjectWrap {
     } else {
       String::Utf8Value encoding(args[0]->ToString());
       if (strcasecmp(*encoding, "hex") == 0) {
-        // Hex encoding
-        HexEncode(out_value, out_len, &out_hexdigest, &out_hex_len);
-        outString = Node::Encode(out_hexdigest, out_hex_len, BINARY);
-        delete [] out_hexdigest;
+        outString = EncodeText(out_value, out_len, HEX);
       } else if (strcasecmp(*encoding, "base64") == 0) {
-        base64(out_value, out_len, &out_hexdigest, &out_hex_len);
-        outString = Node::Encode(out_hexdigest, out_hex_len, BINARY);
-        delete [] out_hexdigest;
+        outString = EncodeText(out_value, out_len, BASE64);
       } else if (strcasecmp(*encoding, "binary") == 0) {
         outString = Node::Encode(out_value, out_len, BINARY);
       } else {
@@ -1843,7 +2795,7 @@ class Cipher : public ObjectWrap {
     return scope.Close(outString);
   }
 
-  Cipher () : ObjectWrap ()
+  Cipher () : CipherBase ()
   {
     initialised_ = false;
   }
@@ -1866,7 +2818,7 @@ class Cipher : public ObjectWrap {
 
 
 
-class Decipher : public ObjectWrap {
+class Decipher : public CipherBase {
  public:
   static void
   Initialize (v8::Handle<v8::Object> target)
@@ -1972,6 +2924,20 @@ class Decipher : public ObjectWrap {
     return 1;
   }
 
+  int CipherBaseUpdate(unsigned char* data, int len,
+                       unsigned char* out, int* out_len) {
+    if (!initialised_) return 0;
+    return EVP_CipherUpdate(&ctx, out, out_len, data, len);
+  }
+
+  int CipherBaseFinal(unsigned char* out, int* out_len) {
+    if (!initialised_) return 0;
+    int r = EVP_CipherFinal(&ctx, out, out_len);
+    EVP_CIPHER_CTX_cleanup(&ctx);
+    initialised_ = false;
+    return r;
+  }
+
 
  protected:
 
@@ -1988,6 +2954,8 @@ class Decipher : public ObjectWrap {
 
     HandleScope scope;
 
+    if (cipher->Busy()) return ThrowBusy();
+
     cipher->incomplete_utf8=NULL;
     cipher->incomplete_hex_flag=false;
 
@@ -2026,6 +2994,8 @@ class Decipher : public ObjectWrap {
 
     HandleScope scope;
 
+    if (cipher->Busy()) return ThrowBusy();
+
     cipher->incomplete_utf8=NULL;
     cipher->incomplete_hex_flag=false;
 
@@ -2077,6 +3047,9 @@ class Decipher : public ObjectWrap {
 
     Decipher *cipher = ObjectWrap::Unwrap<Decipher>(args.This());
 
+    if (HasCallback(args)) return UpdateAsync(cipher, args);
+    if (cipher->Busy()) return ThrowBusy();
+
     NODE_ASSERT_IS_STRING_OR_BUFFER(args[0]);
 
     ssize_t len = Node::DecodeBytes(args[0], BINARY);
@@ -2102,9 +3075,6 @@ class Decipher : public ObjectWrap {
       assert(written == len);
     }
 
-    char* ciphertext;
-    int ciphertext_len;
-
     if (args.Length() <= 1 || !args[1]->IsString()) {
       // Binary - do nothing
     } else {
@@ -2113,40 +3083,38 @@ class Decipher : public ObjectWrap {
         // Hex encoding
         // Do we have a previous hex carry over?
         if (cipher->incomplete_hex_flag) {
-          char* complete_hex = new char[len+2];
+          char* complete_hex = new char[len+1];
           memcpy(complete_hex, &cipher->incomplete_hex, 1);
           memcpy(complete_hex+1, buf, len);
           if (alloc_buf) {
             delete [] buf;
-            alloc_buf = false;
           }
           buf = complete_hex;
+          alloc_buf = true;
           len += 1;
+          cipher->incomplete_hex_flag=false;
         }
         // Do we have an incomplete hex stream?
         if ((len>0) && (len % 2 !=0)) {
           len--;
           cipher->incomplete_hex=buf[len];
           cipher->incomplete_hex_flag=true;
-          buf[len]=0;
         }
-        HexDecode((unsigned char*)buf, len, (char **)&ciphertext, &ciphertext_len);
-
-        if (alloc_buf) {
-          delete [] buf;
+        // A copy of our own is decoded in place, a Buffer into a new one.
+        char* text = buf;
+        if (!alloc_buf) {
+          buf = new char[len / 2 + 1];
+          alloc_buf = true;
         }
-        buf = ciphertext;
-        len = ciphertext_len;
-        alloc_buf = true;
+        len = HexDecode(text, len, buf);
 
       } else if (strcasecmp(*encoding, "base64") == 0) {
-        unbase64((unsigned char*)buf, len, (char **)&ciphertext, &ciphertext_len);
-        if (alloc_buf) {
-          delete [] buf;
+        char* text = buf;
+        if (!alloc_buf) {
+          buf = new char[len + 1];
+          alloc_buf = true;
         }
-        buf = ciphertext;
-        len = ciphertext_len;
-        alloc_buf = true;
+        len = Base64Decode(text, len, buf);
 
       } else if (strcasecmp(*encoding, "binary") == 0) {
         // Binary - do nothing
@@ -2213,6 +3181,9 @@ class Decipher : public ObjectWrap {
 
     Decipher *cipher = ObjectWrap::Unwrap<Decipher>(args.This());
 
+    if (HasCallback(args)) return FinalAsync(cipher, args);
+    if (cipher->Busy()) return ThrowBusy();
+
     unsigned char* out_value;
     int out_len;
     Local<Value> outString;
@@ -2256,6 +3227,8 @@ class Decipher : public ObjectWrap {
 
     HandleScope scope;
 
+    if (cipher->Busy()) return ThrowBusy();
+
     unsigned char* out_value;
     int out_len;
     Local<Value> outString ;
@@ -2295,7 +3268,7 @@ class Decipher : public ObjectWrap {
     return scope.Close(outString);
   }
 
-  Decipher () : ObjectWrap () {
+  Decipher () : CipherBase () {
     initialised_ = false;
   }
 
@@ -2319,7 +3292,7 @@ class Decipher : public ObjectWrap {
 
 
 
-class Hmac : public ObjectWrap {
+class Hmac : public Digest {
  public:
   static void Initialize (v8::Handle<v8::Object> target) {
     HandleScope scope;
@@ -2363,6 +3336,18 @@ class Hmac : public ObjectWrap {
     return 1;
   }
 
+  int DigestUpdate(char* data, int len) {
+    return HmacUpdate(data, len);
+  }
+
+  int DigestFinal(unsigned char* md_value, unsigned int* md_len) {
+    if (!initialised_) return 0;
+    HMAC_Final(&ctx, md_value, md_len);
+    HMAC_CTX_cleanup(&ctx);
+    initialised_ = false;
+    return 1;
+  }
+
 
  protected:
 
@@ -2414,6 +3399,9 @@ class Hmac : public ObjectWrap {
 
     HandleScope scope;
 
+    if (HasCallback(args)) return UpdateAsync(hmac, args);
+    if (hmac->Busy()) return ThrowBusy();
+
     NODE_ASSERT_IS_STRING_OR_BUFFER(args[0]);
     enum encoding enc = Node::ParseEncoding(args[1]);
     ssize_t len = Node::DecodeBytes(args[0], enc);
@@ -2452,11 +3440,12 @@ class Hmac : public ObjectWrap {
 
     HandleScope scope;
 
+    if (HasCallback(args)) return DigestAsync(hmac, args);
+    if (hmac->Busy()) return ThrowBusy();
+
     // proteus: initialize md_value
     unsigned char* md_value = 0;
     unsigned int md_len;
-    char* md_hexdigest = 0;
-    int md_hex_len;
     Local<Value> outString ;
 
     int r = hmac->HmacDigest(&md_value, &md_len);
@@ -2471,14 +3460,9 @@ class Hmac : public ObjectWrap {
     } else {
       String::Utf8Value encoding(args[0]->ToString());
       if (strcasecmp(*encoding, "hex") == 0) {
-        // Hex encoding
-        HexEncode(md_value, md_len, &md_hexdigest, &md_hex_len);
-        outString = Node::Encode(md_hexdigest, md_hex_len, BINARY);
-        delete [] md_hexdigest;
+        outString = EncodeText(md_value, md_len, HEX);
       } else if (strcasecmp(*encoding, "base64") == 0) {
-        base64(md_value, md_len, &md_hexdigest, &md_hex_len);
-        outString = Node::Encode(md_hexdigest, md_hex_len, BINARY);
-        delete [] md_hexdigest;
+        outString = EncodeText(md_value, md_len, BASE64);
       } else if (strcasecmp(*encoding, "binary") == 0) {
         outString = Node::Encode(md_value, md_len, BINARY);
       } else {
@@ -2490,7 +3474,7 @@ class Hmac : public ObjectWrap {
     return scope.Close(outString);
   }
 
-  Hmac () : ObjectWrap () {
+  Hmac () : Digest () {
     initialised_ = false;
   }
 
@@ -2508,7 +3492,7 @@ class Hmac : public ObjectWrap {
 };
 
 
-class Hash : public ObjectWrap {
+class Hash : public Digest {
  public:
   static void Initialize (v8::Handle<v8::Object> target) {
     HandleScope scope;
@@ -2541,6 +3525,18 @@ class Hash : public ObjectWrap {
     return 1;
   }
 
+  int DigestUpdate(char* data, int len) {
+    return HashUpdate(data, len);
+  }
+
+  int DigestFinal(unsigned char* md_value, unsigned int* md_len) {
+    if (!initialised_) return 0;
+    EVP_DigestFinal_ex(&mdctx, md_value, md_len);
+    EVP_MD_CTX_cleanup(&mdctx);
+    initialised_ = false;
+    return 1;
+  }
+
 
  protected:
 
@@ -2567,6 +3563,9 @@ class Hash : public ObjectWrap {
 
     Hash *hash = ObjectWrap::Unwrap<Hash>(args.This());
 
+    if (HasCallback(args)) return UpdateAsync(hash, args);
+    if (hash->Busy()) return ThrowBusy();
+
     NODE_ASSERT_IS_STRING_OR_BUFFER(args[0]);
     enum encoding enc = Node::ParseEncoding(args[1]);
     ssize_t len = Node::DecodeBytes(args[0], enc);
@@ -2604,6 +3603,9 @@ class Hash : public ObjectWrap {
 
     Hash *hash = ObjectWrap::Unwrap<Hash>(args.This());
 
+    if (HasCallback(args)) return DigestAsync(hash, args);
+    if (hash->Busy()) return ThrowBusy();
+
     if (!hash->initialised_) {
       return ThrowException(Exception::Error(String::New("Not initialized")));
     }
@@ -2627,18 +3629,9 @@ class Hash : public ObjectWrap {
     } else {
       String::Utf8Value encoding(args[0]->ToString());
       if (strcasecmp(*encoding, "hex") == 0) {
-        // Hex encoding
-        char* md_hexdigest;
-        int md_hex_len;
-        HexEncode(md_value, md_len, &md_hexdigest, &md_hex_len);
-        outString = Node::Encode(md_hexdigest, md_hex_len, BINARY);
-        delete [] md_hexdigest;
+        outString = EncodeText(md_value, md_len, HEX);
       } else if (strcasecmp(*encoding, "base64") == 0) {
-        char* md_hexdigest;
-        int md_hex_len;
-        base64(md_value, md_len, &md_hexdigest, &md_hex_len);
-        outString = Node::Encode(md_hexdigest, md_hex_len, BINARY);
-        delete [] md_hexdigest;
+        outString = EncodeText(md_value, md_len, BASE64);
       } else if (strcasecmp(*encoding, "binary") == 0) {
         outString = Node::Encode(md_value, md_len, BINARY);
       } else {
@@ -2650,7 +3643,7 @@ class Hash : public ObjectWrap {
     return scope.Close(outString);
   }
 
-  Hash () : ObjectWrap () {
+  Hash () : Digest () {
     initialised_ = false;
   }
 
@@ -2667,25 +3660,513 @@ class Hash : public ObjectWrap {
   bool initialised_;
 };
 
-class Sign : public ObjectWrap {
+// crypto.hashFile(path, algorithm, [encoding], callback): reads and hashes
+// the file on the thread pool, without coming back to JavaScript for each
+// chunk.
+class HashFileWork : public AsyncWork {
  public:
-  static void
-  Initialize (v8::Handle<v8::Object> target) {
-    HandleScope scope;
+  HashFileWork(Handle<Value> callback, const char* path, const EVP_MD* md)
+      : AsyncWork(callback), md_(md), md_len_(0), errno_(0), syscall_(NULL) {
+    path_ = strdup(path);
+  }
 
-    Local<FunctionTemplate> t = FunctionTemplate::New(New);
+  ~HashFileWork() {
+    free(path_);
+    encoding_.Dispose();
+  }
 
-    t->InstanceTemplate()->SetInternalFieldCount(1);
+  void Process() {
+    // Note: this function is executed in the thread pool! CAREFUL
+    int fd = open(path_, O_RDONLY);
+    if (fd < 0) {
+      errno_ = errno;
+      syscall_ = "open";
+      return;
+    }
 
-    NODE_SET_PROTOTYPE_METHOD(t, "init", SignInit);
-    NODE_SET_PROTOTYPE_METHOD(t, "update", SignUpdate);
-    NODE_SET_PROTOTYPE_METHOD(t, "sign", SignFinal);
+    EVP_MD_CTX mdctx;
+    EVP_MD_CTX_init(&mdctx);
+    EVP_DigestInit_ex(&mdctx, md_, NULL);
+
+    // The pool threads have small stacks.
+    char* buf = new char[kChunkSize];
+    ssize_t n;
+    for (;;) {
+      n = read(fd, buf, kChunkSize);
+      if (n > 0) {
+        EVP_DigestUpdate(&mdctx, buf, n);
+      } else if (n == 0 || errno != EINTR) {
+        break;
+      }
+    }
+    if (n < 0) {
+      errno_ = errno;
+      syscall_ = "read";
+    }
 
-    target->Set(String::NewSymbol("Sign"), t->GetFunction());
+    EVP_DigestFinal_ex(&mdctx, md_value_, &md_len_);
+    EVP_MD_CTX_cleanup(&mdctx);
+    delete [] buf;
+    close(fd);
   }
 
-  bool SignInit (const char* signType) {
-    md = EVP_get_digestbyname(signType);
+  void After() {
+    if (errno_) {
+      Local<Value> argv[1] = {
+        ErrnoException(errno_, syscall_, "", path_)
+      };
+      MakeCallback(1, argv);
+    } else {
+      Local<Value> argv[2] = {
+        Local<Value>::New(Null()),
+        EncodeDigest(md_value_, md_len_, encoding_)
+      };
+      MakeCallback(2, argv);
+    }
+  }
+
+  Persistent<Value> encoding_;
+
+ private:
+  static const size_t kChunkSize = 64 * 1024;
+
+  char* path_;
+  const EVP_MD* md_;
+  unsigned char md_value_[EVP_MAX_MD_SIZE];
+  unsigned int md_len_;
+  int errno_;
+  const char* syscall_;
+};
+
+
+static Handle<Value> HashFile(const Arguments& args) {
+  HandleScope scope;
+
+  if (!args[0]->IsString() || !args[1]->IsString()) {
+    return ThrowException(Exception::TypeError(String::New(
+        "Must give path and hashtype strings as arguments")));
+  }
+
+  if (!HasCallback(args) || args.Length() < 3) {
+    return ThrowException(Exception::TypeError(String::New(
+        "Last argument must be a callback")));
+  }
+
+  String::Utf8Value path(args[0]->ToString());
+  String::Utf8Value hashType(args[1]->ToString());
+
+  const EVP_MD* md = EVP_get_digestbyname(*hashType);
+  if (!md) {
+    return ThrowException(Exception::Error(String::New(
+        "Unknown message digest")));
+  }
+
+  if (args.Length() > 3 && !IsDigestEncoding(args[2])) {
+    return ThrowBadEncoding();
+  }
+
+  HashFileWork* work = new HashFileWork(args[args.Length() - 1], *path, md);
+  if (args.Length() > 3) {
+    work->encoding_ = Persistent<Value>::New(args[2]);
+  }
+  work->Queue();
+
+  return Undefined();
+}
+
+
+// Random bytes get a SlowBuffer of their own. They are often keys, which
+// must not share a parent with other output, nor keep a slab alive.
+#define RANDOM_BYTES_MAX 0x3fffffff
+
+class RandomBytesWork : public AsyncWork {
+ public:
+  RandomBytesWork(Handle<Value> callback, size_t size)
+      : AsyncWork(callback), size_(size), r_(0) {
+    HandleScope scope;
+    buffer_ = Persistent<Object>::New(Buffer::New(size)->handle_);
+    data_ = reinterpret_cast<unsigned char*>(Buffer::Data(buffer_));
+  }
+
+  ~RandomBytesWork() {
+    buffer_.Dispose();
+  }
+
+  void Process() {
+    r_ = RAND_bytes(data_, size_);
+  }
+
+  void After() {
+    if (r_ != 1) {
+      Local<Value> argv[1] = {
+        Exception::Error(String::New("PRNG not seeded"))
+      };
+      MakeCallback(1, argv);
+    } else {
+      Local<Value> argv[2] = {
+        Local<Value>::New(Null()),
+        Local<Value>::New(buffer_)
+      };
+      MakeCallback(2, argv);
+    }
+  }
+
+ private:
+  Persistent<Object> buffer_;
+  unsigned char* data_;
+  size_t size_;
+  int r_;
+};
+
+
+// randomBytes(size, [callback])
+static Handle<Value> RandomBytes(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() < 1 || !args[0]->IsUint32() ||
+      args[0]->Uint32Value() > RANDOM_BYTES_MAX) {
+    return ThrowException(Exception::TypeError(String::New(
+        "Argument #1 must be a number between 0 and 0x3fffffff")));
+  }
+
+  size_t size = args[0]->Uint32Value();
+
+  if (HasCallback(args)) {
+    RandomBytesWork* work = new RandomBytesWork(args[args.Length() - 1], size);
+    work->Queue();
+    return Undefined();
+  }
+
+  Buffer* buffer = Buffer::New(size);
+  unsigned char* data =
+      reinterpret_cast<unsigned char*>(Buffer::Data(buffer));
+
+  if (RAND_bytes(data, size) != 1) {
+    return ThrowException(Exception::Error(String::New("PRNG not seeded")));
+  }
+
+  return scope.Close(buffer->handle_);
+}
+
+
+class PBKDF2Work : public AsyncWork {
+ public:
+  PBKDF2Work(Handle<Value> callback,
+             char* pass, int pass_len,
+             char* salt, int salt_len,
+             int iter, int key_len)
+      : AsyncWork(callback),
+        pass_(pass), pass_len_(pass_len),
+        salt_(salt), salt_len_(salt_len),
+        iter_(iter), key_len_(key_len), r_(0) {
+    key_ = new char[key_len];
+  }
+
+  ~PBKDF2Work() {
+    // The password should not linger on the heap.
+    memset(pass_, 0, pass_len_);
+    delete [] pass_;
+    delete [] salt_;
+    memset(key_, 0, key_len_);
+    delete [] key_;
+  }
+
+  void Process() {
+    r_ = PKCS5_PBKDF2_HMAC_SHA1(pass_, pass_len_,
+                                reinterpret_cast<unsigned char*>(salt_),
+                                salt_len_,
+                                iter_,
+                                key_len_,
+                                reinterpret_cast<unsigned char*>(key_));
+  }
+
+  void After() {
+    if (r_ != 1) {
+      Local<Value> argv[1] = {
+        Exception::Error(String::New("PBKDF2 error"))
+      };
+      MakeCallback(1, argv);
+    } else {
+      Local<Value> argv[2] = {
+        Local<Value>::New(Null()),
+        Node::Encode(key_, key_len_, BINARY)
+      };
+      MakeCallback(2, argv);
+    }
+  }
+
+ private:
+  char* pass_;
+  int pass_len_;
+  char* salt_;
+  int salt_len_;
+  int iter_;
+  char* key_;
+  int key_len_;
+  int r_;
+};
+
+
+// Copies a string (binary) or a Buffer to the heap, for the thread pool.
+static ssize_t DecodeToHeap(Handle<Value> value, char** data) {
+  ssize_t len = Node::DecodeBytes(value, BINARY);
+  if (len < 0) return len;
+  *data = new char[len > 0 ? len : 1];
+  ssize_t written = Node::DecodeWrite(*data, len, value, BINARY);
+  assert(written == len);
+  return len;
+}
+
+
+// pbkdf2(password, salt, iterations, keylen, callback)
+static Handle<Value> PBKDF2(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() != 5) {
+    return ThrowException(Exception::TypeError(String::New(
+        "Bad parameter")));
+  }
+
+  NODE_ASSERT_IS_STRING_OR_BUFFER(args[0]);
+  NODE_ASSERT_IS_STRING_OR_BUFFER(args[1]);
+
+  if (!args[2]->IsInt32() || args[2]->Int32Value() <= 0) {
+    return ThrowException(Exception::TypeError(String::New(
+        "Iterations must be a positive number")));
+  }
+
+  if (!args[3]->IsInt32() || args[3]->Int32Value() <= 0) {
+    return ThrowException(Exception::TypeError(String::New(
+        "Key length must be a positive number")));
+  }
+
+  if (!args[4]->IsFunction()) {
+    return ThrowException(Exception::TypeError(String::New(
+        "Callback must be a function")));
+  }
+
+  char* pass;
+  ssize_t pass_len = DecodeToHeap(args[0], &pass);
+  if (pass_len < 0) {
+    return ThrowException(Exception::TypeError(String::New("Bad password")));
+  }
+
+  char* salt;
+  ssize_t salt_len = DecodeToHeap(args[1], &salt);
+  if (salt_len < 0) {
+    delete [] pass;
+    return ThrowException(Exception::TypeError(String::New("Bad salt")));
+  }
+
+  PBKDF2Work* work = new PBKDF2Work(args[4],
+                                    pass, pass_len,
+                                    salt, salt_len,
+                                    args[2]->Int32Value(),
+                                    args[3]->Int32Value());
+  work->Queue();
+
+  return Undefined();
+}
+
+
+#ifndef OPENSSL_NO_ENGINE
+// getEngines() returns [{ id, name }] for the engines OpenSSL knows of.
+static Handle<Value> GetEngines(const Arguments& args) {
+  HandleScope scope;
+
+  Local<Array> engines = Array::New();
+  int i = 0;
+
+  for (ENGINE* e = ENGINE_get_first(); e != NULL; e = ENGINE_get_next(e)) {
+    Local<Object> info = Object::New();
+    info->Set(String::NewSymbol("id"), String::New(ENGINE_get_id(e)));
+    info->Set(name_symbol, String::New(ENGINE_get_name(e)));
+    engines->Set(i++, info);
+  }
+
+  return scope.Close(engines);
+}
+
+
+// setEngine(id, [flags]) makes an engine the default for the methods in
+// flags, all of them if there are none. The id is either one of the
+// engines from getEngines() or the path of an engine library.
+static Handle<Value> SetEngine(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() < 1 || !args[0]->IsString()) {
+    return ThrowException(Exception::TypeError(String::New(
+        "Engine id must be a string")));
+  }
+
+  unsigned int flags = ENGINE_METHOD_ALL;
+  if (args.Length() > 1 && !args[1]->IsUndefined()) {
+    if (!args[1]->IsUint32()) {
+      return ThrowException(Exception::TypeError(String::New(
+          "Flags must be a number")));
+    }
+    flags = args[1]->Uint32Value();
+  }
+
+  String::Utf8Value id(args[0]->ToString());
+
+  ENGINE* e = ENGINE_by_id(*id);
+  if (e == NULL) {
+    // Not one of the built-in ones, try it as a shared library.
+    e = ENGINE_by_id("dynamic");
+    if (e != NULL &&
+        (!ENGINE_ctrl_cmd_string(e, "SO_PATH", *id, 0) ||
+         !ENGINE_ctrl_cmd_string(e, "LOAD", NULL, 0))) {
+      ENGINE_free(e);
+      e = NULL;
+    }
+  }
+  ERR_clear_error();
+
+  if (e == NULL) {
+    return ThrowException(Exception::Error(String::New(
+        "Engine not found")));
+  }
+
+  int r = ENGINE_set_default(e, flags);
+  ENGINE_free(e);
+
+  if (!r) {
+    char string[120];
+    ERR_error_string_n(ERR_get_error(), string, sizeof(string));
+    ERR_clear_error();
+    return ThrowException(Exception::Error(String::New(string)));
+  }
+
+  return True();
+}
+#endif  // !OPENSSL_NO_ENGINE
+
+
+struct NameList {
+  Local<Array> array;
+  int length;
+};
+
+
+static void AddName(const OBJ_NAME* name, void* arg) {
+  NameList* list = static_cast<NameList*>(arg);
+  list->array->Set(list->length++, String::New(name->name));
+}
+
+
+// getCiphers() and getHashes() return the names of the ciphers and the
+// digests, aliases included.
+static Handle<Value> GetCiphers(const Arguments& args) {
+  HandleScope scope;
+  NameList list = { Array::New(), 0 };
+  OBJ_NAME_do_all_sorted(OBJ_NAME_TYPE_CIPHER_METH, AddName, &list);
+  return scope.Close(list.array);
+}
+
+
+static Handle<Value> GetHashes(const Arguments& args) {
+  HandleScope scope;
+  NameList list = { Array::New(), 0 };
+  OBJ_NAME_do_all_sorted(OBJ_NAME_TYPE_MD_METH, AddName, &list);
+  return scope.Close(list.array);
+}
+
+
+// getSSLCiphers([list]) returns the cipher suites a list of them resolves
+// to, in order of preference. Without a list, those of setCiphers().
+static Handle<Value> GetSSLCiphers(const Arguments& args) {
+  HandleScope scope;
+
+  SSL_CTX* ctx = SSL_CTX_new(SSLv23_method());
+  if (ctx == NULL) {
+    return ThrowException(Exception::Error(String::New(
+        "SSL_CTX_new() failed.")));
+  }
+
+  int r;
+  if (args.Length() > 0 && args[0]->IsString()) {
+    String::Utf8Value ciphers(args[0]->ToString());
+    r = SSL_CTX_set_cipher_list(ctx, *ciphers);
+  } else {
+    r = SSL_CTX_set_cipher_list(ctx, DefaultCiphers());
+  }
+  ERR_clear_error();
+
+  Local<Array> suites = Array::New();
+
+  SSL* ssl = r ? SSL_new(ctx) : NULL;
+  if (ssl != NULL) {
+    STACK_OF(SSL_CIPHER)* ciphers = SSL_get_ciphers(ssl);
+    for (int i = 0; i < sk_SSL_CIPHER_num(ciphers); i++) {
+      const SSL_CIPHER* c = sk_SSL_CIPHER_value(ciphers, i);
+      suites->Set(i, String::New(SSL_CIPHER_get_name(c)));
+    }
+    SSL_free(ssl);
+  }
+
+  SSL_CTX_free(ctx);
+
+  return scope.Close(suites);
+}
+
+
+// getCPUFeatures() returns the crypto extensions of the CPU.
+static Handle<Value> GetCPUFeatures(const Arguments& args) {
+  HandleScope scope;
+
+  int features = CPUFeatures();
+
+  Local<Object> info = Object::New();
+  info->Set(String::NewSymbol("aes"), Boolean::New(features & CPU_AES));
+  info->Set(String::NewSymbol("clmul"), Boolean::New(features & CPU_CLMUL));
+  info->Set(String::NewSymbol("sha1"), Boolean::New(features & CPU_SHA1));
+  info->Set(String::NewSymbol("sha256"),
+            Boolean::New(features & CPU_SHA256));
+  info->Set(String::NewSymbol("neon"), Boolean::New(features & CPU_NEON));
+
+  return scope.Close(info);
+}
+
+
+// getThroughput() returns what the preload thread measured, in kilobytes
+// per second, waiting for it if it is not done yet. An algorithm that is
+// not available is left out.
+static Handle<Value> GetThroughput(const Arguments& args) {
+  HandleScope scope;
+
+  pthread_once(&throughput_once, MeasureThroughput);
+
+  Local<Object> info = Object::New();
+  for (Throughput* t = throughput; t->name; t++) {
+    if (t->kbps > 0) {
+      info->Set(String::New(t->name), Number::New(t->kbps));
+    }
+  }
+
+  return scope.Close(info);
+}
+
+
+class Sign : public SerialWrap {
+ public:
+  static void
+  Initialize (v8::Handle<v8::Object> target) {
+    HandleScope scope;
+
+    Local<FunctionTemplate> t = FunctionTemplate::New(New);
+
+    t->InstanceTemplate()->SetInternalFieldCount(1);
+
+    NODE_SET_PROTOTYPE_METHOD(t, "init", SignInit);
+    NODE_SET_PROTOTYPE_METHOD(t, "update", SignUpdate);
+    NODE_SET_PROTOTYPE_METHOD(t, "sign", SignFinal);
+
+    target->Set(String::NewSymbol("Sign"), t->GetFunction());
+  }
+
+  bool SignInit (const char* signType) {
+    md = EVP_get_digestbyname(signType);
     if(!md) {
       printf("Unknown message digest %s\n", signType);
       return false;
@@ -2728,6 +4209,75 @@ class Sign : public ObjectWrap {
 
  protected:
 
+  // sign(key, [encoding], callback): the key is parsed and used on the
+  // thread pool.
+  class SignOp : public Op {
+   public:
+    SignOp(Sign* sign, Handle<Value> callback)
+        : Op(sign, callback), key_(NULL), key_len_(0), md_len_(0), r_(0) {
+    }
+
+    ~SignOp() {
+      delete [] key_;
+      encoding_.Dispose();
+    }
+
+    void Process() {
+      unsigned char* md_value = md_value_;
+      md_len_ = sizeof(md_value_);
+      r_ = static_cast<Sign*>(owner_)->SignFinal(&md_value, &md_len_,
+                                                 key_, key_len_);
+    }
+
+    void Done() {
+      if (!r_ || md_len_ == 0) {
+        Local<Value> argv[1] = {
+          Exception::Error(String::New("SignFinal error"))
+        };
+        MakeCallback(1, argv);
+      } else {
+        Local<Value> argv[2] = {
+          Local<Value>::New(Null()),
+          EncodeDigest(md_value_, md_len_, encoding_)
+        };
+        MakeCallback(2, argv);
+      }
+    }
+
+    char* key_;
+    int key_len_;
+    Persistent<Value> encoding_;
+    unsigned char md_value_[8192]; // Maximum key size is 8192 bits
+    unsigned int md_len_;
+    int r_;
+  };
+
+  static Handle<Value> SignAsync(Sign* sign, const Arguments& args) {
+    HandleScope scope;
+
+    NODE_ASSERT_IS_STRING_OR_BUFFER(args[0]);
+    ssize_t len = Node::DecodeBytes(args[0], BINARY);
+
+    if (len < 0) {
+      Local<Value> exception = Exception::TypeError(String::New("Bad argument"));
+      return ThrowException(exception);
+    }
+
+    if (args.Length() > 2 && !IsDigestEncoding(args[1])) {
+      return ThrowBadEncoding();
+    }
+
+    SignOp* op = new SignOp(sign, args[args.Length() - 1]);
+    op->key_ = new char[len];
+    op->key_len_ = Node::DecodeWrite(op->key_, len, args[0], BINARY);
+    if (args.Length() > 2) {
+      op->encoding_ = Persistent<Value>::New(args[1]);
+    }
+
+    sign->Enqueue(op);
+    return Undefined();
+  }
+
   static Handle<Value> New (const Arguments& args) {
     HandleScope scope;
 
@@ -2742,6 +4292,8 @@ class Sign : public ObjectWrap {
 
     Sign *sign = ObjectWrap::Unwrap<Sign>(args.This());
 
+    if (sign->Busy()) return ThrowBusy();
+
     if (args.Length() == 0 || !args[0]->IsString()) {
       return ThrowException(Exception::Error(String::New(
         "Must give signtype string as argument")));
@@ -2763,6 +4315,8 @@ class Sign : public ObjectWrap {
 
     HandleScope scope;
 
+    if (sign->Busy()) return ThrowBusy();
+
     NODE_ASSERT_IS_STRING_OR_BUFFER(args[0]);
     enum encoding enc = Node::ParseEncoding(args[1]);
     ssize_t len = Node::DecodeBytes(args[0], enc);
@@ -2801,10 +4355,11 @@ class Sign : public ObjectWrap {
 
     HandleScope scope;
 
+    if (HasCallback(args)) return SignAsync(sign, args);
+    if (sign->Busy()) return ThrowBusy();
+
     unsigned char* md_value;
     unsigned int md_len;
-    char* md_hexdigest;
-    int md_hex_len;
     Local<Value> outString;
 
     md_len = 8192; // Maximum key size is 8192 bits
@@ -2838,14 +4393,9 @@ class Sign : public ObjectWrap {
     } else {
       String::Utf8Value encoding(args[1]->ToString());
       if (strcasecmp(*encoding, "hex") == 0) {
-        // Hex encoding
-        HexEncode(md_value, md_len, &md_hexdigest, &md_hex_len);
-        outString = Node::Encode(md_hexdigest, md_hex_len, BINARY);
-        delete [] md_hexdigest;
+        outString = EncodeText(md_value, md_len, HEX);
       } else if (strcasecmp(*encoding, "base64") == 0) {
-        base64(md_value, md_len, &md_hexdigest, &md_hex_len);
-        outString = Node::Encode(md_hexdigest, md_hex_len, BINARY);
-        delete [] md_hexdigest;
+        outString = EncodeText(md_value, md_len, BASE64);
       } else if (strcasecmp(*encoding, "binary") == 0) {
         outString = Node::Encode(md_value, md_len, BINARY);
       } else {
@@ -2859,7 +4409,7 @@ class Sign : public ObjectWrap {
     return scope.Close(outString);
   }
 
-  Sign () : ObjectWrap () {
+  Sign () : SerialWrap () {
     initialised_ = false;
   }
 
@@ -2876,7 +4426,7 @@ class Sign : public ObjectWrap {
   bool initialised_;
 };
 
-class Verify : public ObjectWrap {
+class Verify : public SerialWrap {
  public:
   static void Initialize (v8::Handle<v8::Object> target) {
     HandleScope scope;
@@ -2982,6 +4532,93 @@ class Verify : public ObjectWrap {
 
  protected:
 
+  // verify(key, signature, [encoding], callback): calls back with true or
+  // false, the key is parsed and used on the thread pool.
+  class VerifyOp : public Op {
+   public:
+    VerifyOp(Verify* verify, Handle<Value> callback)
+        : Op(verify, callback), key_(NULL), key_len_(0), sig_(NULL),
+          sig_len_(0), r_(0) {
+    }
+
+    ~VerifyOp() {
+      delete [] key_;
+      delete [] sig_;
+    }
+
+    void Process() {
+      r_ = static_cast<Verify*>(owner_)->VerifyFinal(key_, key_len_,
+                                                     sig_, sig_len_);
+    }
+
+    void Done() {
+      if (r_ < 0) {
+        Local<Value> argv[1] = {
+          Exception::Error(String::New("VerifyFinal error"))
+        };
+        MakeCallback(1, argv);
+      } else {
+        Local<Value> argv[2] = {
+          Local<Value>::New(Null()),
+          Local<Value>::New(r_ == 1 ? True() : False())
+        };
+        MakeCallback(2, argv);
+      }
+    }
+
+    char* key_;
+    int key_len_;
+    unsigned char* sig_;
+    int sig_len_;
+    int r_;
+  };
+
+  static Handle<Value> VerifyAsync(Verify* verify, const Arguments& args) {
+    HandleScope scope;
+
+    NODE_ASSERT_IS_STRING_OR_BUFFER(args[0]);
+    NODE_ASSERT_IS_STRING_OR_BUFFER(args[1]);
+    ssize_t klen = Node::DecodeBytes(args[0], BINARY);
+    ssize_t hlen = Node::DecodeBytes(args[1], BINARY);
+
+    if (klen < 0 || hlen < 0) {
+      Local<Value> exception = Exception::TypeError(String::New("Bad argument"));
+      return ThrowException(exception);
+    }
+
+    enum { SIG_BINARY, SIG_HEX, SIG_BASE64 } sig_encoding = SIG_BINARY;
+    if (args.Length() > 3 && args[2]->IsString()) {
+      String::Utf8Value encoding(args[2]->ToString());
+      if (strcasecmp(*encoding, "hex") == 0) {
+        sig_encoding = SIG_HEX;
+      } else if (strcasecmp(*encoding, "base64") == 0) {
+        sig_encoding = SIG_BASE64;
+      } else if (strcasecmp(*encoding, "binary") != 0) {
+        return ThrowException(Exception::TypeError(String::New(
+          "Verify .verify encoding can be binary, hex or base64")));
+      }
+    }
+
+    VerifyOp* op = new VerifyOp(verify, args[args.Length() - 1]);
+
+    op->key_ = new char[klen];
+    op->key_len_ = Node::DecodeWrite(op->key_, klen, args[0], BINARY);
+
+    unsigned char* hbuf = new unsigned char[hlen];
+    Node::DecodeWrite(reinterpret_cast<char*>(hbuf), hlen, args[1], BINARY);
+    char* sig = reinterpret_cast<char*>(hbuf);
+    if (sig_encoding == SIG_HEX) {
+      hlen = HexDecode(sig, hlen, sig);
+    } else if (sig_encoding == SIG_BASE64) {
+      hlen = Base64Decode(sig, hlen, sig);
+    }
+    op->sig_ = hbuf;
+    op->sig_len_ = hlen;
+
+    verify->Enqueue(op);
+    return Undefined();
+  }
+
   static Handle<Value> New (const Arguments& args) {
     HandleScope scope;
 
@@ -2997,6 +4634,8 @@ class Verify : public ObjectWrap {
 
     HandleScope scope;
 
+    if (verify->Busy()) return ThrowBusy();
+
     if (args.Length() == 0 || !args[0]->IsString()) {
       return ThrowException(Exception::Error(String::New(
         "Must give verifytype string as argument")));
@@ -3019,6 +4658,8 @@ class Verify : public ObjectWrap {
 
     Verify *verify = ObjectWrap::Unwrap<Verify>(args.This());
 
+    if (verify->Busy()) return ThrowBusy();
+
     NODE_ASSERT_IS_STRING_OR_BUFFER(args[0]);
     enum encoding enc = Node::ParseEncoding(args[1]);
     ssize_t len = Node::DecodeBytes(args[0], enc);
@@ -3058,6 +4699,9 @@ class Verify : public ObjectWrap {
 
     Verify *verify = ObjectWrap::Unwrap<Verify>(args.This());
 
+    if (HasCallback(args)) return VerifyAsync(verify, args);
+    if (verify->Busy()) return ThrowBusy();
+
     NODE_ASSERT_IS_STRING_OR_BUFFER(args[0]);
     ssize_t klen = Node::DecodeBytes(args[0], BINARY);
 
@@ -3082,8 +4726,6 @@ class Verify : public ObjectWrap {
     unsigned char* hbuf = new unsigned char[hlen];
     ssize_t hwritten = Node::DecodeWrite((char *)hbuf, hlen, args[1], BINARY);
     assert(hwritten == hlen);
-    unsigned char* dbuf;
-    int dlen;
 
     int r=-1;
 
@@ -3092,16 +4734,13 @@ class Verify : public ObjectWrap {
       r = verify->VerifyFinal(kbuf, klen, hbuf, hlen);
     } else {
       String::Utf8Value encoding(args[2]->ToString());
+      // The signature is decoded in place.
       if (strcasecmp(*encoding, "hex") == 0) {
-        // Hex encoding
-        HexDecode(hbuf, hlen, (char **)&dbuf, &dlen);
-        r = verify->VerifyFinal(kbuf, klen, dbuf, dlen);
-        delete [] dbuf;
+        hlen = HexDecode((char *)hbuf, hlen, (char *)hbuf);
+        r = verify->VerifyFinal(kbuf, klen, hbuf, hlen);
       } else if (strcasecmp(*encoding, "base64") == 0) {
-        // Base64 encoding
-        unbase64(hbuf, hlen, (char **)&dbuf, &dlen);
-        r = verify->VerifyFinal(kbuf, klen, dbuf, dlen);
-        delete [] dbuf;
+        hlen = Base64Decode((char *)hbuf, hlen, (char *)hbuf);
+        r = verify->VerifyFinal(kbuf, klen, hbuf, hlen);
       } else if (strcasecmp(*encoding, "binary") == 0) {
         r = verify->VerifyFinal(kbuf, klen, hbuf, hlen);
       } else {
@@ -3116,7 +4755,7 @@ class Verify : public ObjectWrap {
     return scope.Close(Integer::New(r));
   }
 
-  Verify () : ObjectWrap () {
+  Verify () : SerialWrap () {
     initialised_ = false;
   }
 
@@ -3134,7 +4773,74 @@ class Verify : public ObjectWrap {
 
 };
 
-class DiffieHellman : public ObjectWrap {
+// Generated Diffie-Hellman parameters by prime length. Generating a safe
+// prime takes seconds, and nothing is lost by sharing the parameters, each
+// DiffieHellman object still generates its own keys. Shared by the thread
+// pool and the loop thread.
+#define DH_PARAMS_CACHE_SIZE 8
+
+static struct {
+  int bits;
+  DH* params;
+} dh_params_cache[DH_PARAMS_CACHE_SIZE];
+static int dh_params_cache_len;
+static pthread_mutex_t dh_params_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static bool CheckDHParams(DH* dh) {
+  int codes;
+  if (!DH_check(dh, &codes)) return false;
+  if (codes & DH_CHECK_P_NOT_SAFE_PRIME) return false;
+  if (codes & DH_CHECK_P_NOT_PRIME) return false;
+  if (codes & DH_UNABLE_TO_CHECK_GENERATOR) return false;
+  if (codes & DH_NOT_SUITABLE_GENERATOR) return false;
+  return true;
+}
+
+// Returns parameters with a prime of the given length, from the cache or
+// newly generated, or NULL. The caller owns them.
+static DH* GetDHParams(int bits) {
+  DH* dh = NULL;
+
+  pthread_mutex_lock(&dh_params_mutex);
+  for (int i = 0; i < dh_params_cache_len; i++) {
+    if (dh_params_cache[i].bits == bits) {
+      dh = DHparams_dup(dh_params_cache[i].params);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&dh_params_mutex);
+
+  if (dh != NULL) return dh;
+
+  // Not under the lock, other lengths shouldn't wait for this one.
+  dh = DH_new();
+  if (dh == NULL) return NULL;
+  if (!DH_generate_parameters_ex(dh, bits, DH_GENERATOR_2, 0) ||
+      !CheckDHParams(dh)) {
+    DH_free(dh);
+    return NULL;
+  }
+
+  pthread_mutex_lock(&dh_params_mutex);
+  bool cached = false;
+  for (int i = 0; i < dh_params_cache_len; i++) {
+    if (dh_params_cache[i].bits == bits) cached = true;
+  }
+  if (!cached && dh_params_cache_len < DH_PARAMS_CACHE_SIZE) {
+    DH* params = DHparams_dup(dh);
+    if (params != NULL) {
+      dh_params_cache[dh_params_cache_len].bits = bits;
+      dh_params_cache[dh_params_cache_len].params = params;
+      dh_params_cache_len++;
+    }
+  }
+  pthread_mutex_unlock(&dh_params_mutex);
+
+  return dh;
+}
+
+
+class DiffieHellman : public SerialWrap {
  public:
   static void Initialize(v8::Handle<v8::Object> target) {
     HandleScope scope;
@@ -3155,11 +4861,10 @@ class DiffieHellman : public ObjectWrap {
     target->Set(String::NewSymbol("DiffieHellman"), t->GetFunction());
   }
 
+  // Run on the thread pool for new DiffieHellman(primeLength, callback).
   bool Init(int primeLength) {
-    dh = DH_new();
-    DH_generate_parameters_ex(dh, primeLength, DH_GENERATOR_2, 0);
-    bool result = VerifyContext();
-    if (!result) return false;
+    dh = GetDHParams(primeLength);
+    if (dh == NULL) return false;
     initialised_ = true;
     return true;
   }
@@ -3176,12 +4881,104 @@ class DiffieHellman : public ObjectWrap {
   }
 
  protected:
+  class InitOp : public Op {
+   public:
+    InitOp(DiffieHellman* diffieHellman, Handle<Value> callback, int bits)
+        : Op(diffieHellman, callback), bits_(bits), r_(false) {
+    }
+
+    void Process() {
+      r_ = static_cast<DiffieHellman*>(owner_)->Init(bits_);
+    }
+
+    void Done() {
+      if (!r_) {
+        Local<Value> argv[1] = {
+          Exception::Error(String::New("Initialization failed"))
+        };
+        MakeCallback(1, argv);
+      } else {
+        Local<Value> argv[2] = {
+          Local<Value>::New(Null()),
+          Local<Value>::New(owner_->handle_)
+        };
+        MakeCallback(2, argv);
+      }
+    }
+
+    int bits_;
+    bool r_;
+  };
+
+  // generateKeys([encoding], callback)
+  class GenerateKeysOp : public Op {
+   public:
+    GenerateKeysOp(DiffieHellman* diffieHellman, Handle<Value> callback)
+        : Op(diffieHellman, callback), r_(0) {
+    }
+
+    ~GenerateKeysOp() {
+      encoding_.Dispose();
+    }
+
+    void Process() {
+      r_ = DH_generate_key(static_cast<DiffieHellman*>(owner_)->dh);
+    }
+
+    void Done() {
+      if (!r_) {
+        Local<Value> argv[1] = {
+          Exception::Error(String::New("Key generation failed"))
+        };
+        MakeCallback(1, argv);
+      } else {
+        Local<Value> argv[2] = {
+          Local<Value>::New(Null()),
+          static_cast<DiffieHellman*>(owner_)->PublicKey(encoding_)
+        };
+        MakeCallback(2, argv);
+      }
+    }
+
+    Persistent<Value> encoding_;
+    int r_;
+  };
+
+  Local<Value> PublicKey(Handle<Value> encoding) {
+    HandleScope scope;
+
+    Local<Value> outString;
+
+    int dataSize = BN_num_bytes(dh->pub_key);
+    char* data = new char[dataSize];
+    BN_bn2bin(dh->pub_key, reinterpret_cast<unsigned char*>(data));
+
+    if (!encoding.IsEmpty() && encoding->IsString()) {
+      outString = EncodeWithEncoding(encoding, data, dataSize);
+    } else {
+      outString = Node::Encode(data, dataSize, BINARY);
+    }
+    delete[] data;
+
+    return scope.Close(outString);
+  }
+
   static Handle<Value> New(const Arguments& args) {
     HandleScope scope;
 
     DiffieHellman* diffieHellman = new DiffieHellman();
     bool initialized = false;
 
+    // new DiffieHellman(primeLength, callback) generates the prime on the
+    // thread pool and calls back with the object.
+    if (args.Length() > 1 && args[0]->IsInt32() && HasCallback(args)) {
+      diffieHellman->Wrap(args.This());
+      diffieHellman->Enqueue(new InitOp(diffieHellman,
+                                        args[args.Length() - 1],
+                                        args[0]->Int32Value()));
+      return args.This();
+    }
+
     if (args.Length() > 0) {
       if (args[0]->IsInt32()) {
         diffieHellman->Init(args[0]->Int32Value());
@@ -3231,31 +5028,35 @@ class DiffieHellman : public ObjectWrap {
 
     HandleScope scope;
 
+    if (diffieHellman->Busy()) return ThrowBusy();
+
     if (!diffieHellman->initialised_) {
       return ThrowException(Exception::Error(
             String::New("Not initialized")));
     }
 
+    if (HasCallback(args)) {
+      if (args.Length() > 1 && !IsDigestEncoding(args[0])) {
+        return ThrowBadEncoding();
+      }
+
+      GenerateKeysOp* op =
+          new GenerateKeysOp(diffieHellman, args[args.Length() - 1]);
+      if (args.Length() > 1) {
+        op->encoding_ = Persistent<Value>::New(args[0]);
+      }
+      diffieHellman->Enqueue(op);
+      return Undefined();
+    }
+
     if (!DH_generate_key(diffieHellman->dh)) {
       return ThrowException(Exception::Error(
             String::New("Key generation failed")));
     }
 
-    Local<Value> outString;
-
-    int dataSize = BN_num_bytes(diffieHellman->dh->pub_key);
-    char* data = new char[dataSize];
-    BN_bn2bin(diffieHellman->dh->pub_key,
-        reinterpret_cast<unsigned char*>(data));
-
-    if (args.Length() > 0 && args[0]->IsString()) {
-      outString = EncodeWithEncoding(args[0], data, dataSize);
-    } else {
-      outString = Node::Encode(data, dataSize, BINARY);
-    }
-    delete[] data;
-
-    return scope.Close(outString);
+    Local<Value> encoding;
+    if (args.Length() > 0) encoding = args[0];
+    return scope.Close(diffieHellman->PublicKey(encoding));
   }
 
   static Handle<Value> GetPrime(const Arguments& args) {
@@ -3264,6 +5065,8 @@ class DiffieHellman : public ObjectWrap {
 
     HandleScope scope;
 
+    if (diffieHellman->Busy()) return ThrowBusy();
+
     if (!diffieHellman->initialised_) {
       return ThrowException(Exception::Error(String::New("Not initialized")));
     }
@@ -3291,6 +5094,8 @@ class DiffieHellman : public ObjectWrap {
 
     HandleScope scope;
 
+    if (diffieHellman->Busy()) return ThrowBusy();
+
     if (!diffieHellman->initialised_) {
       return ThrowException(Exception::Error(String::New("Not initialized")));
     }
@@ -3318,6 +5123,8 @@ class DiffieHellman : public ObjectWrap {
 
     HandleScope scope;
 
+    if (diffieHellman->Busy()) return ThrowBusy();
+
     if (!diffieHellman->initialised_) {
       return ThrowException(Exception::Error(String::New("Not initialized")));
     }
@@ -3351,6 +5158,8 @@ class DiffieHellman : public ObjectWrap {
 
     HandleScope scope;
 
+    if (diffieHellman->Busy()) return ThrowBusy();
+
     if (!diffieHellman->initialised_) {
       return ThrowException(Exception::Error(String::New("Not initialized")));
     }
@@ -3384,6 +5193,8 @@ class DiffieHellman : public ObjectWrap {
     DiffieHellman* diffieHellman =
       ObjectWrap::Unwrap<DiffieHellman>(args.This());
 
+    if (diffieHellman->Busy()) return ThrowBusy();
+
     if (!diffieHellman->initialised_) {
       return ThrowException(Exception::Error(String::New("Not initialized")));
     }
@@ -3466,6 +5277,8 @@ class DiffieHellman : public ObjectWrap {
     DiffieHellman* diffieHellman =
       ObjectWrap::Unwrap<DiffieHellman>(args.This());
 
+    if (diffieHellman->Busy()) return ThrowBusy();
+
     if (!diffieHellman->initialised_) {
       return ThrowException(Exception::Error(String::New("Not initialized")));
     }
@@ -3511,6 +5324,8 @@ class DiffieHellman : public ObjectWrap {
     DiffieHellman* diffieHellman =
       ObjectWrap::Unwrap<DiffieHellman>(args.This());
 
+    if (diffieHellman->Busy()) return ThrowBusy();
+
     if (!diffieHellman->initialised_) {
       return ThrowException(Exception::Error(
             String::New("Not initialized")));
@@ -3551,7 +5366,7 @@ class DiffieHellman : public ObjectWrap {
     return args.This();
   }
 
-  DiffieHellman() : ObjectWrap() {
+  DiffieHellman() : SerialWrap() {
     initialised_ = false;
     dh = NULL;
   }
@@ -3564,13 +5379,7 @@ class DiffieHellman : public ObjectWrap {
 
  private:
   bool VerifyContext() {
-    int codes;
-    if (!DH_check(dh, &codes)) return false;
-    if (codes & DH_CHECK_P_NOT_SAFE_PRIME) return false;
-    if (codes & DH_CHECK_P_NOT_PRIME) return false;
-    if (codes & DH_UNABLE_TO_CHECK_GENERATOR) return false;
-    if (codes & DH_NOT_SUITABLE_GENERATOR) return false;
-    return true;
+    return CheckDHParams(dh);
   }
 
   static int DecodeBinary(Handle<Value> str, char** buf) {
@@ -3590,14 +5399,13 @@ class DiffieHellman : public ObjectWrap {
       return len;
     }
     String::Utf8Value encoding(enc->ToString());
-    char* retbuf = 0;
-    int retlen;
 
+    // The text is decoded in place.
     if (strcasecmp(*encoding, "hex") == 0) {
-      HexDecode((unsigned char*)*buf, len, &retbuf, &retlen);
+      len = HexDecode(*buf, len, *buf);
 
     } else if (strcasecmp(*encoding, "base64") == 0) {
-      unbase64((unsigned char*)*buf, len, &retbuf, &retlen);
+      len = Base64Decode(*buf, len, *buf);
 
     } else if (strcasecmp(*encoding, "binary") == 0) {
       // Binary - do nothing
@@ -3606,12 +5414,6 @@ class DiffieHellman : public ObjectWrap {
                       "can be binary, hex or base64\n");
     }
 
-    if (retbuf != 0) {
-      delete [] *buf;
-      *buf = retbuf;
-      len = retlen;
-    }
-
     return len;
   }
 
@@ -3621,22 +5423,16 @@ class DiffieHellman : public ObjectWrap {
 
     Local<Value> outString;
     String::Utf8Value encoding(enc->ToString());
-    char* retbuf;
-    int retlen;
     if (strcasecmp(*encoding, "hex") == 0) {
-      // Hex encoding
-      HexEncode(reinterpret_cast<unsigned char*>(buf), len, &retbuf, &retlen);
-      outString = Node::Encode(retbuf, retlen, BINARY);
-      delete [] retbuf;
+      outString = EncodeText(buf, len, HEX);
     } else if (strcasecmp(*encoding, "base64") == 0) {
-      base64(reinterpret_cast<unsigned char*>(buf), len, &retbuf, &retlen);
-      outString = Node::Encode(retbuf, retlen, BINARY);
-      delete [] retbuf;
+      outString = EncodeText(buf, len, BASE64);
     } else if (strcasecmp(*encoding, "binary") == 0) {
       outString = Node::Encode(buf, len, BINARY);
     } else {
       fprintf(stderr, "node-crypto : Diffie-Hellman parameter encoding "
                       "can be binary, hex or base64\n");
+      outString = Node::Encode(buf, len, BINARY);
     }
 
     return scope.Close(outString);
@@ -3650,19 +5446,7 @@ class DiffieHellman : public ObjectWrap {
 void InitCrypto(Handle<Object> target) {
   HandleScope scope;
 
-  SSL_library_init();
-  OpenSSL_add_all_algorithms();
-  OpenSSL_add_all_digests();
-  SSL_load_error_strings();
-  ERR_load_crypto_strings();
-
-  // Turn off compression. Saves memory - do it in userland.
-#ifdef SSL_COMP_get_compression_methods
-  // Before OpenSSL 0.9.8 this was not possible.
-  STACK_OF(SSL_COMP)* comp_methods = SSL_COMP_get_compression_methods();
-  sk_SSL_COMP_zero(comp_methods);
-  assert(sk_SSL_COMP_num(comp_methods) == 0);
-#endif
+  InitOpenSSL();
 
   SecureContext::Initialize(target);
   Connection::Initialize(target);
@@ -3674,6 +5458,21 @@ void InitCrypto(Handle<Object> target) {
   Sign::Initialize(target);
   Verify::Initialize(target);
 
+  NODE_SET_METHOD(target, "hashFile", HashFile);
+  NODE_SET_METHOD(target, "randomBytes", RandomBytes);
+  NODE_SET_METHOD(target, "pbkdf2", PBKDF2);
+#ifndef OPENSSL_NO_ENGINE
+  NODE_SET_METHOD(target, "getEngines", GetEngines);
+  NODE_SET_METHOD(target, "setEngine", SetEngine);
+#endif
+  NODE_SET_METHOD(target, "getCiphers", GetCiphers);
+  NODE_SET_METHOD(target, "getHashes", GetHashes);
+  NODE_SET_METHOD(target, "getSSLCiphers", GetSSLCiphers);
+  NODE_SET_METHOD(target, "getCPUFeatures", GetCPUFeatures);
+  NODE_SET_METHOD(target, "getThroughput", GetThroughput);
+  target->Set(String::NewSymbol("DEFAULT_CIPHERS"),
+              String::New(DefaultCiphers()));
+
   subject_symbol    = NODE_PSYMBOL("subject");
   issuer_symbol     = NODE_PSYMBOL("issuer");
   valid_from_symbol = NODE_PSYMBOL("valid_from");
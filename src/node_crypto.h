@@ -33,6 +33,10 @@
 #include <openssl/pem.h>
 #include <openssl/x509.h>
 #include <openssl/hmac.h>
+#include <openssl/rand.h>
+#ifndef OPENSSL_NO_ENGINE
+#include <openssl/engine.h>
+#endif
 
 #ifdef OPENSSL_NPN_NEGOTIATED
 #include <node_buffer.h>
@@ -44,7 +48,9 @@
 namespace node {
 namespace crypto {
 
-static X509_STORE* root_cert_store;
+// Starts parsing the built-in root certificates and measuring the crypto
+// throughput on a background thread.
+void PreloadCrypto();
 
 class SecureContext : ObjectWrap {
  public:
@@ -64,6 +70,10 @@ class SecureContext : ObjectWrap {
   static v8::Handle<v8::Value> AddRootCerts(const v8::Arguments& args);
   static v8::Handle<v8::Value> SetCiphers(const v8::Arguments& args);
   static v8::Handle<v8::Value> SetOptions(const v8::Arguments& args);
+  static v8::Handle<v8::Value> SetSessionIdContext(const v8::Arguments& args);
+  static v8::Handle<v8::Value> SetSessionCacheSize(const v8::Arguments& args);
+  static v8::Handle<v8::Value> SetSessionTimeout(const v8::Arguments& args);
+  static v8::Handle<v8::Value> GetSessionStats(const v8::Arguments& args);
   static v8::Handle<v8::Value> Close(const v8::Arguments& args);
 
   SecureContext() : ObjectWrap() {
@@ -73,13 +83,8 @@ class SecureContext : ObjectWrap {
 
   void FreeCTXMem() {
     if (ctx_) {
-      if (ctx_->cert_store == root_cert_store) {
-        // SSL_CTX_free() will attempt to free the cert_store as well.
-        // Since we want our root_cert_store to stay around forever
-        // we just clear the field. Hopefully OpenSSL will not modify this
-        // struct in future versions.
-        ctx_->cert_store = NULL;
-      }
+      // The shared root store is reference counted, SSL_CTX_free() only
+      // drops our reference.
       SSL_CTX_free(ctx_);
       ctx_ = NULL;
       ca_store_ = NULL;
@@ -116,6 +121,11 @@ class Connection : ObjectWrap {
   static v8::Handle<v8::Value> IsInitFinished(const v8::Arguments& args);
   static v8::Handle<v8::Value> VerifyError(const v8::Arguments& args);
   static v8::Handle<v8::Value> GetCurrentCipher(const v8::Arguments& args);
+  static v8::Handle<v8::Value> GetSession(const v8::Arguments& args);
+  static v8::Handle<v8::Value> SetSession(const v8::Arguments& args);
+  static v8::Handle<v8::Value> IsSessionReused(const v8::Arguments& args);
+  static v8::Handle<v8::Value> SetFD(const v8::Arguments& args);
+  static v8::Handle<v8::Value> WantWrite(const v8::Arguments& args);
   static v8::Handle<v8::Value> Shutdown(const v8::Arguments& args);
   static v8::Handle<v8::Value> ReceivedShutdown(const v8::Arguments& args);
   static v8::Handle<v8::Value> Start(const v8::Arguments& args);
@@ -150,6 +160,7 @@ class Connection : ObjectWrap {
   Connection() : ObjectWrap() {
     bio_read_ = bio_write_ = NULL;
     ssl_ = NULL;
+    is_socket_ = false;
   }
 
   ~Connection() {
@@ -165,6 +176,9 @@ class Connection : ObjectWrap {
   SSL *ssl_;
   
   bool is_server_; /* coverity[member_decl] */
+  // After setFD() the records go straight to the socket, bio_read_ and
+  // bio_write_ are the same socket BIO.
+  bool is_socket_;
 };
 
 void InitCrypto(v8::Handle<v8::Object> target);
@@ -35,11 +35,13 @@ NODE_EXT_LIST_ITEM(node_fs)
 NODE_EXT_LIST_ITEM(node_net)
 #endif
 NODE_EXT_LIST_ITEM(node_http_parser)
+NODE_EXT_LIST_ITEM(node_object_pool)
 #ifdef __POSIX__
 NODE_EXT_LIST_ITEM(node_signal_watcher)
 #endif
 NODE_EXT_LIST_ITEM(node_stdio)
 NODE_EXT_LIST_ITEM(node_os)
+NODE_EXT_LIST_ITEM(node_zlib)
 
 // libuv rewrite
 NODE_EXT_LIST_ITEM(node_timer_wrap)
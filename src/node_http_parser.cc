@@ -30,6 +30,13 @@
 #include <strings.h>  /* strcasecmp() */
 #include <string.h>  /* strdup() */
 #include <stdlib.h>  /* free() */
+#include <stdio.h>  /* snprintf() */
+#include <time.h>
+#ifdef __POSIX__
+# include <sys/time.h>  /* gettimeofday() */
+#endif
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(*(a)))
 
 // This is a binding to http_parser (http://github.com/ry/http-parser)
 // The goal is to decouple sockets from parsing for more javascript-level
@@ -41,6 +48,20 @@
 //     ...
 // No copying is performed when slicing the buffer, only small reference
 // allocations.
+//
+// Header fields and values are not passed up one fragment at a time.
+// They are collected here and handed to parser.onHeadersComplete as one
+// flat [field, value, field, value, ...] array, together with the URL.
+// Field names are lowercase.
+// Messages with a lot of headers, and trailers, are delivered in chunks
+// through parser.onHeaders(headers, url).
+//
+// Request parsers with an onHeadersBatch callback batch up message heads
+// instead: all the heads one execute() call finds are passed to
+// parser.onHeadersBatch([info, ...]) together, and onMessageBegin is not
+// called. info.complete is set if the message ended without a body. The
+// batch is handed over before any other callback runs, so the order of
+// events is kept.
 
 
 namespace node {
@@ -52,11 +73,11 @@ static Persistent<String> on_path_sym;
 static Persistent<String> on_query_string_sym;
 static Persistent<String> on_url_sym;
 static Persistent<String> on_fragment_sym;
-static Persistent<String> on_header_field_sym;
-static Persistent<String> on_header_value_sym;
+static Persistent<String> on_headers_sym;
 static Persistent<String> on_headers_complete_sym;
 static Persistent<String> on_body_sym;
 static Persistent<String> on_message_complete_sym;
+static Persistent<String> on_headers_batch_sym;
 
 static Persistent<String> delete_sym;
 static Persistent<String> get_sym;
@@ -90,8 +111,119 @@ static Persistent<String> version_major_sym;
 static Persistent<String> version_minor_sym;
 static Persistent<String> should_keep_alive_sym;
 static Persistent<String> upgrade_sym;
+static Persistent<String> headers_sym;
+static Persistent<String> url_sym;
+static Persistent<String> complete_sym;
+
+
+// The JavaScript callbacks. They are kept in internal fields of the
+// parser object, set through accessors, instead of being looked up by
+// name on every event; a bit in Parser::callback_mask_ tells whether one
+// is set at all.
+enum {
+  kOnMessageBegin = 0,
+  kOnPath,
+  kOnQueryString,
+  kOnURL,
+  kOnFragment,
+  kOnHeaders,
+  kOnHeadersComplete,
+  kOnBody,
+  kOnMessageComplete,
+  kOnHeadersBatch,
+  kNumCallbacks
+};
+
+static Persistent<String>* callback_syms[kNumCallbacks] = {
+  &on_message_begin_sym,
+  &on_path_sym,
+  &on_query_string_sym,
+  &on_url_sym,
+  &on_fragment_sym,
+  &on_headers_sym,
+  &on_headers_complete_sym,
+  &on_body_sym,
+  &on_message_complete_sym,
+  &on_headers_batch_sym
+};
+
+// Internal field 0 belongs to ObjectWrap.
+#define CALLBACK_FIELD(index) ((index) + 1)
+
+
+// Header names that show up in most messages. They are matched case
+// insensitively and passed to JavaScript as lowercase symbols, so the
+// common case allocates no header name strings at all.
+static struct {
+  const char* name;
+  size_t length;
+  Persistent<String> sym;
+} header_names[] = {
+#define HEADER_NAME(s) { s, sizeof(s) - 1, Persistent<String>() }
+  HEADER_NAME("host"),
+  HEADER_NAME("connection"),
+  HEADER_NAME("content-length"),
+  HEADER_NAME("content-type"),
+  HEADER_NAME("content-encoding"),
+  HEADER_NAME("transfer-encoding"),
+  HEADER_NAME("accept"),
+  HEADER_NAME("accept-charset"),
+  HEADER_NAME("accept-encoding"),
+  HEADER_NAME("accept-language"),
+  HEADER_NAME("accept-ranges"),
+  HEADER_NAME("age"),
+  HEADER_NAME("authorization"),
+  HEADER_NAME("cache-control"),
+  HEADER_NAME("cookie"),
+  HEADER_NAME("date"),
+  HEADER_NAME("etag"),
+  HEADER_NAME("expect"),
+  HEADER_NAME("expires"),
+  HEADER_NAME("if-modified-since"),
+  HEADER_NAME("if-none-match"),
+  HEADER_NAME("keep-alive"),
+  HEADER_NAME("last-modified"),
+  HEADER_NAME("location"),
+  HEADER_NAME("origin"),
+  HEADER_NAME("pragma"),
+  HEADER_NAME("proxy-authorization"),
+  HEADER_NAME("range"),
+  HEADER_NAME("referer"),
+  HEADER_NAME("server"),
+  HEADER_NAME("set-cookie"),
+  HEADER_NAME("upgrade"),
+  HEADER_NAME("user-agent"),
+  HEADER_NAME("vary"),
+  HEADER_NAME("via"),
+  HEADER_NAME("www-authenticate"),
+  HEADER_NAME("x-forwarded-for"),
+  HEADER_NAME("x-requested-with"),
+#undef HEADER_NAME
+};
+
+
+// Returns the lowercase header name, interned if it is a well known one.
+static inline Handle<String>
+header_name_to_str(const char* name, size_t length) {
+  for (size_t i = 0; i < ARRAY_SIZE(header_names); i++) {
+    if (header_names[i].length == length &&
+        0 == strncasecmp(header_names[i].name, name, length)) {
+      return header_names[i].sym;
+    }
+  }
+
+  char stack_buf[256];
+  char* lower = length <= sizeof(stack_buf) ? stack_buf : new char[length];
+
+  for (size_t i = 0; i < length; i++) {
+    char c = name[i];
+    lower[i] = (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+  }
 
-static struct http_parser_settings settings;
+  Local<String> r = String::New(lower, length);
+  if (lower != stack_buf) delete[] lower;
+  return r;
+}
 
 
 // This is a hack to get the current_buffer to the callbacks with the least
@@ -103,12 +235,12 @@ static size_t current_buffer_len;
 
 
 // Callback prototype for http_cb
-#define DEFINE_HTTP_CB(name)                                             \
+#define DEFINE_HTTP_CB(name, index)                                      \
   static int name(http_parser *p) {                                      \
     Parser *parser = static_cast<Parser*>(p->data);                      \
-    Local<Value> cb_value = parser->handle_->Get(name##_sym);            \
-    if (!cb_value->IsFunction()) return 0;                               \
-    Local<Function> cb = Local<Function>::Cast(cb_value);                \
+    if (!parser->HasCallback(index)) return 0;                           \
+    if (parser->FlushBatch()) return -1;                                 \
+    Local<Function> cb = parser->GetCallback(index);                     \
     Local<Value> ret = cb->Call(parser->handle_, 0, NULL);               \
     if (ret.IsEmpty()) {                                                 \
       parser->got_exception_ = true;                                     \
@@ -119,13 +251,13 @@ static size_t current_buffer_len;
   }
 
 // Callback prototype for http_data_cb
-#define DEFINE_HTTP_DATA_CB(name)                                        \
+#define DEFINE_HTTP_DATA_CB(name, index)                                 \
   static int name(http_parser *p, const char *at, size_t length) {       \
     Parser *parser = static_cast<Parser*>(p->data);                      \
     assert(current_buffer);                                              \
-    Local<Value> cb_value = parser->handle_->Get(name##_sym);            \
-    if (!cb_value->IsFunction()) return 0;                               \
-    Local<Function> cb = Local<Function>::Cast(cb_value);                \
+    if (!parser->HasCallback(index)) return 0;                           \
+    if (parser->FlushBatch()) return -1;                                 \
+    Local<Function> cb = parser->GetCallback(index);                     \
     Local<Value> argv[3] = { *current_buffer                             \
                            , Integer::New(at - current_buffer_data)      \
                            , Integer::New(length)                        \
@@ -141,6 +273,74 @@ static size_t current_buffer_len;
   }
 
 
+// Points at a header field, value or the URL. As long as its fragments
+// are consecutive in the buffer being parsed this is just a pointer into
+// it; otherwise, or when execute() returns before the string is complete,
+// the bytes are copied to the heap.
+struct StringPtr {
+  StringPtr() {
+    on_heap_ = false;
+    Reset();
+  }
+
+  ~StringPtr() {
+    Reset();
+  }
+
+  // The buffer is about to go away, copy what we point at.
+  void Save() {
+    if (!on_heap_ && size_ > 0) {
+      char* s = new char[size_];
+      memcpy(s, str_, size_);
+      str_ = s;
+      on_heap_ = true;
+    }
+  }
+
+  void Reset() {
+    if (on_heap_) {
+      delete[] str_;
+      on_heap_ = false;
+    }
+
+    str_ = NULL;
+    size_ = 0;
+  }
+
+  void Update(const char* str, size_t size) {
+    if (str_ == NULL) {
+      str_ = str;
+    } else if (on_heap_ || str_ + size_ != str) {
+      // Non-consecutive input, make a copy on the heap.
+      char* s = new char[size_ + size];
+      memcpy(s, str_, size_);
+      memcpy(s + size_, str, size);
+
+      if (on_heap_) {
+        delete[] str_;
+      } else {
+        on_heap_ = true;
+      }
+
+      str_ = s;
+    }
+    size_ += size;
+  }
+
+  Local<String> ToString() const {
+    return String::New(str_ ? str_ : "", size_);
+  }
+
+  const char* str_;
+  bool on_heap_;
+  size_t size_;
+};
+
+
+// Headers are passed up to JavaScript this many at a time.
+#define MAX_HEADER_PAIRS 32
+
+
 static inline Persistent<String>
 method_to_str(unsigned short m) {
   switch (m) {
@@ -175,33 +375,147 @@ method_to_str(unsigned short m) {
 class Parser : public ObjectWrap {
  public:
   Parser(enum http_parser_type type) : ObjectWrap() {
+    callback_mask_ = 0;
+    UpdateSettings();
     Init(type);
   }
 
   ~Parser() {
   }
 
-  DEFINE_HTTP_CB(on_message_begin)
-  DEFINE_HTTP_CB(on_message_complete)
+  DEFINE_HTTP_CB(on_message_begin_cb, kOnMessageBegin)
+  DEFINE_HTTP_CB(on_message_complete_cb, kOnMessageComplete)
 
-  DEFINE_HTTP_DATA_CB(on_path)
-  DEFINE_HTTP_DATA_CB(on_url)
-  DEFINE_HTTP_DATA_CB(on_fragment)
-  DEFINE_HTTP_DATA_CB(on_query_string)
-  DEFINE_HTTP_DATA_CB(on_header_field)
-  DEFINE_HTTP_DATA_CB(on_header_value)
-  DEFINE_HTTP_DATA_CB(on_body)
+  DEFINE_HTTP_DATA_CB(on_path, kOnPath)
+  DEFINE_HTTP_DATA_CB(on_url_cb, kOnURL)
+  DEFINE_HTTP_DATA_CB(on_fragment, kOnFragment)
+  DEFINE_HTTP_DATA_CB(on_query_string, kOnQueryString)
+  DEFINE_HTTP_DATA_CB(on_body, kOnBody)
+
+  inline bool HasCallback(int index) const {
+    return callback_mask_ & (1 << index);
+  }
+
+  inline Local<Function> GetCallback(int index) {
+    return Local<Function>::Cast(
+        handle_->GetInternalField(CALLBACK_FIELD(index)));
+  }
+
+  // parser.onBody = function(b, start, len) { ... }
+  static void CallbackSetter(Local<String> property,
+                             Local<Value> value,
+                             const AccessorInfo& info) {
+    Parser *parser = ObjectWrap::Unwrap<Parser>(info.Holder());
+    int index = info.Data()->Int32Value();
+
+    info.Holder()->SetInternalField(CALLBACK_FIELD(index), value);
+
+    if (value->IsFunction()) {
+      parser->callback_mask_ |= 1 << index;
+    } else {
+      parser->callback_mask_ &= ~(1 << index);
+    }
+
+    parser->UpdateSettings();
+  }
+
+  static Handle<Value> CallbackGetter(Local<String> property,
+                                      const AccessorInfo& info) {
+    int index = info.Data()->Int32Value();
+    return info.Holder()->GetInternalField(CALLBACK_FIELD(index));
+  }
+
+  static int on_message_begin(http_parser *p) {
+    Parser *parser = static_cast<Parser*>(p->data);
+    parser->num_fields_ = parser->num_values_ = 0;
+    parser->url_.Reset();
+    parser->have_flushed_ = false;
+    if (parser->BatchEnabled()) return 0;
+    return on_message_begin_cb(p);
+  }
+
+  static int on_url(http_parser *p, const char *at, size_t length) {
+    Parser *parser = static_cast<Parser*>(p->data);
+    parser->url_.Update(at, length);
+    return on_url_cb(p, at, length);
+  }
+
+  static int on_header_field(http_parser *p, const char *at, size_t length) {
+    Parser *parser = static_cast<Parser*>(p->data);
+
+    if (parser->num_fields_ == parser->num_values_) {
+      // start of new field name
+      if (parser->num_fields_ == MAX_HEADER_PAIRS) {
+        // ran out of space - flush to javascript land
+        if (parser->Flush()) return -1;
+      }
+      parser->fields_[parser->num_fields_++].Reset();
+    }
+
+    assert(parser->num_fields_ == parser->num_values_ + 1);
+    parser->fields_[parser->num_fields_ - 1].Update(at, length);
+
+    return 0;
+  }
+
+  static int on_header_value(http_parser *p, const char *at, size_t length) {
+    Parser *parser = static_cast<Parser*>(p->data);
+
+    if (parser->num_values_ != parser->num_fields_) {
+      // start of new header value
+      parser->values_[parser->num_values_++].Reset();
+    }
+
+    assert(parser->num_values_ == parser->num_fields_);
+    parser->values_[parser->num_values_ - 1].Update(at, length);
+
+    return 0;
+  }
+
+  static int on_message_complete(http_parser *p) {
+    Parser *parser = static_cast<Parser*>(p->data);
+
+    // Flush trailing HTTP headers.
+    if (parser->num_fields_ > 0 && parser->Flush()) return -1;
+
+    if (parser->batched_message_) {
+      // The head is still in the batch, no need for another call.
+      parser->batch_->Get(parser->batch_length_ - 1)->ToObject()->Set(
+          complete_sym, True());
+      parser->batched_message_ = false;
+      return 0;
+    }
+
+    return on_message_complete_cb(p);
+  }
 
   static int on_headers_complete(http_parser *p) {
     Parser *parser = static_cast<Parser*>(p->data);
 
-    Local<Value> cb_value = parser->handle_->Get(on_headers_complete_sym);
-    if (!cb_value->IsFunction()) return 0;
-    Local<Function> cb = Local<Function>::Cast(cb_value);
+    bool batch = parser->BatchEnabled();
+
+    if (!batch && !parser->HasCallback(kOnHeadersComplete)) {
+      parser->num_fields_ = parser->num_values_ = 0;
+      parser->url_.Reset();
+      return 0;
+    }
 
 
     Local<Object> message_info = Object::New();
 
+    if (parser->have_flushed_) {
+      // Slow case, flush remaining headers.
+      if (parser->Flush()) return -1;
+    } else {
+      // Fast case, pass headers and URL to JS land.
+      message_info->Set(headers_sym, parser->CreateHeaders());
+      if (p->type == HTTP_REQUEST) {
+        message_info->Set(url_sym, parser->url_.ToString());
+      }
+    }
+    parser->num_fields_ = parser->num_values_ = 0;
+    parser->url_.Reset();
+
     // METHOD
     if (p->type == HTTP_REQUEST) {
       message_info->Set(method_sym, method_to_str(p->method));
@@ -221,6 +535,14 @@ class Parser : public ObjectWrap {
 
     message_info->Set(upgrade_sym, p->upgrade ? True() : False());
 
+    if (batch) {
+      if (parser->batch_length_ == 0) parser->batch_ = Array::New();
+      parser->batch_->Set(parser->batch_length_++, message_info);
+      parser->batched_message_ = true;
+      return 0;
+    }
+
+    Local<Function> cb = parser->GetCallback(kOnHeadersComplete);
     Local<Value> argv[1] = { message_info };
 
     Local<Value> head_response = cb->Call(parser->handle_, 1, argv);
@@ -298,13 +620,21 @@ class Parser : public ObjectWrap {
     parser->got_exception_ = false;
 
     size_t nparsed =
-      http_parser_execute(&parser->parser_, &settings, buffer_data + off, len);
+      http_parser_execute(&parser->parser_, &parser->settings_,
+                          buffer_data + off, len);
+
+    // The buffer may be reused once we return, copy any header or URL
+    // that is still being collected.
+    parser->Save();
 
     // Unassign the 'buffer_' variable
     assert(current_buffer);
     current_buffer = NULL;
     current_buffer_data = NULL;
 
+    // Hand over the heads that are left, also those before a parse error.
+    if (!parser->got_exception_) parser->FlushBatch();
+
     // If there was an exception in one of the callbacks
     if (parser->got_exception_) return Local<Value>();
 
@@ -329,7 +659,8 @@ class Parser : public ObjectWrap {
     assert(!current_buffer);
     parser->got_exception_ = false;
 
-    int rv = http_parser_execute(&(parser->parser_), &settings, NULL, 0);
+    int rv = http_parser_execute(&(parser->parser_), &parser->settings_,
+                                 NULL, 0);
 
     if (parser->got_exception_) return Local<Value>();
 
@@ -363,39 +694,478 @@ class Parser : public ObjectWrap {
 
  private:
 
+  Local<Array> CreateHeaders() {
+    // Like before, a field that never got a value is not reported.
+    Local<Array> headers = Array::New(2 * num_values_);
+
+    for (int i = 0; i < num_values_; ++i) {
+      headers->Set(2 * i, header_name_to_str(fields_[i].str_,
+                                             fields_[i].size_));
+      headers->Set(2 * i + 1, values_[i].ToString());
+    }
+
+    return headers;
+  }
+
+
+  // Hands the headers collected so far to parser.onHeaders(headers, url).
+  // Returns non-zero if the callback threw.
+  int Flush() {
+    HandleScope scope;
+
+    if (FlushBatch()) return -1;
+
+    if (HasCallback(kOnHeaders)) {
+      Local<Value> argv[2] = {
+        CreateHeaders(),
+        url_.ToString()
+      };
+
+      Local<Value> r = GetCallback(kOnHeaders)->Call(handle_, 2, argv);
+
+      if (r.IsEmpty()) {
+        got_exception_ = true;
+        return -1;
+      }
+    }
+
+    url_.Reset();
+    num_fields_ = num_values_ = 0;
+    have_flushed_ = true;
+
+    return 0;
+  }
+
+
+  // Heads are only batched while execute() runs, on the server side.
+  bool BatchEnabled() const {
+    return parser_.type == HTTP_REQUEST &&
+           HasCallback(kOnHeadersBatch) &&
+           current_buffer != NULL;
+  }
+
+
+  // Hands the batched heads to parser.onHeadersBatch(). Returns true if
+  // the callback threw.
+  bool FlushBatch() {
+    if (batch_length_ == 0) return false;
+
+    // JavaScript only runs from callbacks, and each one flushes the batch
+    // first, so onHeadersBatch cannot have been unset in the meantime.
+    assert(HasCallback(kOnHeadersBatch));
+
+    Local<Value> argv[1] = { batch_ };
+    batch_ = Local<Array>();
+    batch_length_ = 0;
+    batched_message_ = false;
+
+    Local<Value> r = GetCallback(kOnHeadersBatch)->Call(handle_, 1, argv);
+
+    if (r.IsEmpty()) {
+      got_exception_ = true;
+      return true;
+    }
+
+    return false;
+  }
+
+
+  void Save() {
+    url_.Save();
+
+    for (int i = 0; i < num_fields_; i++) {
+      fields_[i].Save();
+    }
+
+    for (int i = 0; i < num_values_; i++) {
+      values_[i].Save();
+    }
+  }
+
+
+  // Events without a JavaScript callback are not even reported by
+  // http_parser. The ones the binding needs for itself always are.
+  void UpdateSettings() {
+    settings_.on_message_begin    = on_message_begin;
+    settings_.on_url              = on_url;
+    settings_.on_header_field     = on_header_field;
+    settings_.on_header_value     = on_header_value;
+    settings_.on_headers_complete = on_headers_complete;
+    settings_.on_message_complete = on_message_complete;
+
+    settings_.on_path =
+        HasCallback(kOnPath) ? on_path : NULL;
+    settings_.on_query_string =
+        HasCallback(kOnQueryString) ? on_query_string : NULL;
+    settings_.on_fragment =
+        HasCallback(kOnFragment) ? on_fragment : NULL;
+    settings_.on_body =
+        HasCallback(kOnBody) ? on_body : NULL;
+  }
+
+
   void Init (enum http_parser_type type) {
     http_parser_init(&parser_, type);
     parser_.data = this;
+    url_.Reset();
+    num_fields_ = num_values_ = 0;
+    have_flushed_ = false;
+    batch_length_ = 0;
+    batched_message_ = false;
   }
 
   bool got_exception_;
   http_parser parser_;
+  http_parser_settings settings_;
+  unsigned int callback_mask_;
+  StringPtr fields_[MAX_HEADER_PAIRS];  // header fields
+  StringPtr values_[MAX_HEADER_PAIRS];  // header values
+  StringPtr url_;
+  int num_fields_;
+  int num_values_;
+  bool have_flushed_;
+  Local<Array> batch_;  // only valid while execute() runs
+  uint32_t batch_length_;
+  bool batched_message_;  // the current message's head is in batch_
+};
+
+
+// Outgoing headers. serializeHeader() writes the first line and the header
+// block of an OutgoingMessage into a Buffer in one go, instead of lib/http.js
+// building it up with string concatenation and regexps, and reports back
+// what it found out about the connection and the message framing.
+
+// Flags passed in by OutgoingMessage.
+enum {
+  HEADER_SHOULD_KEEP_ALIVE  = 0x1,
+  HEADER_CHUNKED_BY_DEFAULT = 0x2,
+  HEADER_HAS_BODY           = 0x4,
+  HEADER_SEND_DATE          = 0x8
+};
+
+// Flags passed back, in the low bits of the return value.
+enum {
+  HEADER_LAST               = 0x1,
+  HEADER_KEEP_ALIVE         = 0x2,
+  HEADER_CHUNKED            = 0x4,
+  HEADER_EXPECT             = 0x8
+};
+
+#define HEADER_FLAG_BITS 4
+
+
+// The Date header for server responses. It only changes once a second, so
+// it is formatted by a timer that fires at the start of every second
+// rather than for every response. The timer is started the first time a
+// response asks for a date and does not keep the event loop alive.
+static char date_header[48];  // "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+static size_t date_header_len;
+static uv_timer_t date_timer;
+static bool date_timer_started;
+
+static const char* const day_names[] = {
+  "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+};
+
+static const char* const month_names[] = {
+  "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+
+// Formats the current time, returns the milliseconds until the next second.
+static int64_t UpdateDateHeader() {
+  time_t now;
+  int64_t ms_left;
+  struct tm tm;
+
+#ifdef __POSIX__
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  now = tv.tv_sec;
+  ms_left = 1000 - tv.tv_usec / 1000;
+  gmtime_r(&now, &tm);
+#else
+  now = time(NULL);
+  ms_left = 1000;
+  tm = *gmtime(&now);
+#endif
+
+  // Not strftime(), the names must not depend on the locale.
+  date_header_len = snprintf(date_header,
+                             sizeof(date_header),
+                             "Date: %s, %02d %s %04d %02d:%02d:%02d GMT\r\n",
+                             day_names[tm.tm_wday],
+                             tm.tm_mday,
+                             month_names[tm.tm_mon],
+                             tm.tm_year + 1900,
+                             tm.tm_hour,
+                             tm.tm_min,
+                             tm.tm_sec);
+
+  return ms_left;
+}
+
+
+static void DateTimerCallback(uv_timer_t* handle, int status) {
+  assert(handle == &date_timer);
+  UpdateDateHeader();
+}
+
+
+static void StartDateTimer() {
+  uv_timer_init(&date_timer);
+  uv_timer_start(&date_timer, DateTimerCallback, UpdateDateHeader(), 1000);
+  uv_unref();
+  date_timer_started = true;
+}
+
+
+static bool contains_nocase(const char* s, size_t n, const char* word) {
+  size_t len = strlen(word);
+  for (size_t i = 0; i + len <= n; i++) {
+    if (0 == strncasecmp(s + i, word, len)) return true;
+  }
+  return false;
+}
+
+
+// Writes into a fixed chunk of memory and remembers if it ran out of room.
+class HeaderWriter {
+ public:
+  HeaderWriter(char* data, size_t length)
+    : data_(data), length_(length), pos_(0), overflow_(false) {
+  }
+
+  void Write(const char* s, size_t n) {
+    if (overflow_ || n > length_ - pos_) {
+      overflow_ = true;
+      return;
+    }
+    memcpy(data_ + pos_, s, n);
+    pos_ += n;
+  }
+
+  // Writes s as UTF-8. Returns false if it contains CR, LF or NUL, which
+  // would let it end the header early.
+  bool Write(Handle<String> s) {
+    if (overflow_) return true;
+
+    char* p = data_ + pos_;
+    int chars;
+    int n = s->WriteUtf8(p, length_ - pos_, &chars,
+                         String::HINT_MANY_WRITES_EXPECTED);
+
+    if (chars < s->Length()) {
+      overflow_ = true;
+      return true;
+    }
+
+    if (n > 0 && p[n - 1] == '\0') n--;  // terminator, if there was room
+    pos_ += n;
+
+    return memchr(p, '\r', n) == NULL &&
+           memchr(p, '\n', n) == NULL &&
+           memchr(p, '\0', n) == NULL;
+  }
+
+  const char* At(size_t pos) const { return data_ + pos; }
+  size_t Pos() const { return pos_; }
+  bool Overflow() const { return overflow_; }
+
+ private:
+  char* data_;
+  size_t length_;
+  size_t pos_;
+  bool overflow_;
+};
+
+
+struct HeaderState {
+  bool sent_connection;
+  bool sent_content_length;
+  bool sent_transfer_encoding;
+  bool sent_date;
+  int flags;
 };
 
 
+#define NAME_IS(s) \
+  (field_len == sizeof(s) - 1 && 0 == strncasecmp(field, s, field_len))
+
+static bool StoreHeader(HeaderWriter& w,
+                        HeaderState& state,
+                        Handle<Value> name,
+                        Handle<Value> val) {
+  size_t field_start = w.Pos();
+  if (!w.Write(name->ToString())) return false;
+  size_t field_len = w.Pos() - field_start;
+
+  w.Write(": ", 2);
+
+  size_t value_start = w.Pos();
+  if (!w.Write(val->ToString())) return false;
+  size_t value_len = w.Pos() - value_start;
+
+  w.Write("\r\n", 2);
+
+  if (w.Overflow()) return true;
+
+  const char* field = w.At(field_start);
+  const char* value = w.At(value_start);
+
+  if (NAME_IS("connection")) {
+    state.sent_connection = true;
+    if (contains_nocase(value, value_len, "close")) {
+      state.flags |= HEADER_LAST;
+    } else {
+      state.flags |= HEADER_KEEP_ALIVE;
+    }
+  } else if (NAME_IS("transfer-encoding")) {
+    state.sent_transfer_encoding = true;
+    if (contains_nocase(value, value_len, "chunk")) {
+      state.flags |= HEADER_CHUNKED;
+    }
+  } else if (NAME_IS("content-length")) {
+    state.sent_content_length = true;
+  } else if (NAME_IS("expect")) {
+    state.flags |= HEADER_EXPECT;
+  } else if (NAME_IS("date")) {
+    state.sent_date = true;
+  }
+
+  return true;
+}
+
+#undef NAME_IS
+
+
+static bool StoreHeaders(HeaderWriter& w,
+                         HeaderState& state,
+                         Handle<Value> name,
+                         Handle<Value> val) {
+  if (val->IsArray()) {
+    Local<Array> values = Local<Array>::Cast(val->ToObject());
+    for (uint32_t i = 0; i < values->Length(); i++) {
+      if (!StoreHeader(w, state, name, values->Get(i))) return false;
+    }
+    return true;
+  }
+  return StoreHeader(w, state, name, val);
+}
+
+
+// serializeHeader(buffer, offset, firstLine, headers, flags)
+//
+// headers is either an object of field: value, or an array of
+// [field, value] pairs; a value can be an array of values. Returns
+// (bytes written << HEADER_FLAG_BITS | HEADER_* flags), or -1 if the header
+// does not fit in the buffer.
+static Handle<Value> SerializeHeader(const Arguments& args) {
+  HandleScope scope;
+
+  if (!Buffer::HasInstance(args[0])) {
+    return ThrowException(Exception::TypeError(
+          String::New("First argument must be a Buffer")));
+  }
+
+  Local<Object> buffer = args[0]->ToObject();
+  size_t offset = args[1]->Uint32Value();
+  size_t buffer_len = Buffer::Length(buffer);
+
+  if (offset > buffer_len) {
+    return ThrowException(Exception::Error(
+          String::New("Offset is out of bounds")));
+  }
+
+  HeaderWriter w(Buffer::Data(buffer) + offset, buffer_len - offset);
+  HeaderState state = { false, false, false, false, 0 };
+  int in = args[4]->Int32Value();
+
+  if (!w.Write(args[2]->ToString())) {
+    return ThrowException(Exception::TypeError(
+          String::New("Invalid character in first line")));
+  }
+
+  bool ok = true;
+
+  if (args[3]->IsArray()) {
+    Local<Array> pairs = Local<Array>::Cast(args[3]);
+    for (uint32_t i = 0; ok && i < pairs->Length(); i++) {
+      Local<Object> pair = pairs->Get(i)->ToObject();
+      ok = StoreHeaders(w, state, pair->Get(0), pair->Get(1));
+    }
+  } else if (args[3]->IsObject()) {
+    Local<Object> headers = args[3]->ToObject();
+    Local<Array> names = headers->GetOwnPropertyNames();
+    for (uint32_t i = 0; ok && i < names->Length(); i++) {
+      Local<Value> name = names->Get(i);
+      ok = StoreHeaders(w, state, name, headers->Get(name));
+    }
+  }
+
+  if (!ok) {
+    return ThrowException(Exception::TypeError(
+          String::New("Invalid character in header")));
+  }
+
+  if ((in & HEADER_SEND_DATE) && !state.sent_date) {
+    if (!date_timer_started) StartDateTimer();
+    w.Write(date_header, date_header_len);
+  }
+
+  // keep-alive logic
+  if (!state.sent_connection) {
+    if ((in & HEADER_SHOULD_KEEP_ALIVE) &&
+        (state.sent_content_length || (in & HEADER_CHUNKED_BY_DEFAULT))) {
+      w.Write("Connection: keep-alive\r\n", 24);
+    } else {
+      state.flags |= HEADER_LAST;
+      w.Write("Connection: close\r\n", 19);
+    }
+  }
+
+  if (!state.sent_content_length && !state.sent_transfer_encoding) {
+    if (in & HEADER_HAS_BODY) {
+      if (in & HEADER_CHUNKED_BY_DEFAULT) {
+        w.Write("Transfer-Encoding: chunked\r\n", 28);
+        state.flags |= HEADER_CHUNKED;
+      } else {
+        state.flags |= HEADER_LAST;
+      }
+    }
+  }
+
+  w.Write("\r\n", 2);
+
+  if (w.Overflow()) return scope.Close(Integer::New(-1));
+
+  return scope.Close(Integer::New(
+        (w.Pos() << HEADER_FLAG_BITS) | state.flags));
+}
+
+
 void InitHttpParser(Handle<Object> target) {
   HandleScope scope;
 
   Local<FunctionTemplate> t = FunctionTemplate::New(Parser::New);
-  t->InstanceTemplate()->SetInternalFieldCount(1);
+  t->InstanceTemplate()->SetInternalFieldCount(CALLBACK_FIELD(kNumCallbacks));
   t->SetClassName(String::NewSymbol("HTTPParser"));
 
   NODE_SET_PROTOTYPE_METHOD(t, "execute", Parser::Execute);
   NODE_SET_PROTOTYPE_METHOD(t, "finish", Parser::Finish);
   NODE_SET_PROTOTYPE_METHOD(t, "reinitialize", Parser::Reinitialize);
 
-  target->Set(String::NewSymbol("HTTPParser"), t->GetFunction());
-
   on_message_begin_sym    = NODE_PSYMBOL("onMessageBegin");
   on_path_sym             = NODE_PSYMBOL("onPath");
   on_query_string_sym     = NODE_PSYMBOL("onQueryString");
   on_url_sym              = NODE_PSYMBOL("onURL");
   on_fragment_sym         = NODE_PSYMBOL("onFragment");
-  on_header_field_sym     = NODE_PSYMBOL("onHeaderField");
-  on_header_value_sym     = NODE_PSYMBOL("onHeaderValue");
+  on_headers_sym          = NODE_PSYMBOL("onHeaders");
   on_headers_complete_sym = NODE_PSYMBOL("onHeadersComplete");
   on_body_sym             = NODE_PSYMBOL("onBody");
   on_message_complete_sym = NODE_PSYMBOL("onMessageComplete");
+  on_headers_batch_sym    = NODE_PSYMBOL("onHeadersBatch");
 
   delete_sym = NODE_PSYMBOL("DELETE");
   get_sym = NODE_PSYMBOL("GET");
@@ -429,17 +1199,34 @@ void InitHttpParser(Handle<Object> target) {
   version_minor_sym = NODE_PSYMBOL("versionMinor");
   should_keep_alive_sym = NODE_PSYMBOL("shouldKeepAlive");
   upgrade_sym = NODE_PSYMBOL("upgrade");
+  headers_sym = NODE_PSYMBOL("headers");
+  url_sym = NODE_PSYMBOL("url");
+  complete_sym = NODE_PSYMBOL("complete");
+
+  for (size_t i = 0; i < ARRAY_SIZE(header_names); i++) {
+    header_names[i].sym = NODE_PSYMBOL(header_names[i].name);
+  }
+
+  for (int i = 0; i < kNumCallbacks; i++) {
+    t->InstanceTemplate()->SetAccessor(*callback_syms[i],
+                                       Parser::CallbackGetter,
+                                       Parser::CallbackSetter,
+                                       Integer::New(i));
+  }
+
+  target->Set(String::NewSymbol("HTTPParser"), t->GetFunction());
 
-  settings.on_message_begin    = Parser::on_message_begin;
-  settings.on_path             = Parser::on_path;
-  settings.on_query_string     = Parser::on_query_string;
-  settings.on_url              = Parser::on_url;
-  settings.on_fragment         = Parser::on_fragment;
-  settings.on_header_field     = Parser::on_header_field;
-  settings.on_header_value     = Parser::on_header_value;
-  settings.on_headers_complete = Parser::on_headers_complete;
-  settings.on_body             = Parser::on_body;
-  settings.on_message_complete = Parser::on_message_complete;
+  NODE_SET_METHOD(target, "serializeHeader", SerializeHeader);
+
+  NODE_DEFINE_CONSTANT(target, HEADER_SHOULD_KEEP_ALIVE);
+  NODE_DEFINE_CONSTANT(target, HEADER_CHUNKED_BY_DEFAULT);
+  NODE_DEFINE_CONSTANT(target, HEADER_HAS_BODY);
+  NODE_DEFINE_CONSTANT(target, HEADER_SEND_DATE);
+  NODE_DEFINE_CONSTANT(target, HEADER_LAST);
+  NODE_DEFINE_CONSTANT(target, HEADER_KEEP_ALIVE);
+  NODE_DEFINE_CONSTANT(target, HEADER_CHUNKED);
+  NODE_DEFINE_CONSTANT(target, HEADER_EXPECT);
+  NODE_DEFINE_CONSTANT(target, HEADER_FLAG_BITS);
 }
 
 }  // namespace node
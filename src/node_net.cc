@@ -51,6 +51,7 @@
 
 #ifdef __linux__
 # include <linux/sockios.h> /* For the SIOCINQ / FIONREAD ioctl */
+# include <sys/syscall.h> /* __NR_recvmmsg, __NR_sendmmsg */
 #endif
 
 /* Non-linux platforms like OS X define this ioctl elsewhere */
@@ -86,6 +87,12 @@
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(*(a)))
 
+// Older kernel headers (e.g. bionic) don't know about TCP Fast Open yet.
+// setsockopt() fails with ENOPROTOOPT on kernels that don't support it.
+#if defined(__linux__) && !defined(TCP_FASTOPEN)
+# define TCP_FASTOPEN 23
+#endif
+
 
 namespace node {
 
@@ -98,6 +105,9 @@ static Persistent<String> fd_symbol;
 static Persistent<String> size_symbol;
 static Persistent<String> address_symbol;
 static Persistent<String> port_symbol;
+static Persistent<String> offset_symbol;
+static Persistent<String> length_symbol;
+static Persistent<String> buffer_symbol;
 static Persistent<String> type_symbol;
 static Persistent<String> tcp_symbol;
 static Persistent<String> unix_symbol;
@@ -279,33 +289,37 @@ static Handle<Value> Socket(const Arguments& args) {
 }
 
 
-// NOT AT ALL THREAD SAFE - but that's okay for node.js
-// (yes this is all to avoid one small heap alloc)
-static struct sockaddr *addr;
-static socklen_t addrlen;
-static inline Handle<Value> ParseAddressArgs(Handle<Value> first,
-                                             Handle<Value> second,
-                                             bool is_bind) {
-  static struct sockaddr_in in;
-  static struct sockaddr_in6 in6;
+// A socket address as passed to bind(), connect() and sendto().
+struct address_t {
+  struct sockaddr_storage storage;
+  socklen_t len;
+};
+
+#define ADDR(a) ((struct sockaddr*) &(a).storage)
 
-#ifdef __POSIX__ // No unix sockets on windows
-  static struct sockaddr_un un;
 
+// Parses a port and ip, or a unix socket path, into address. Writes only
+// to the storage it is handed so that it can be used off the main thread.
+static Handle<Value> ParseAddress(Handle<Value> first,
+                                  Handle<Value> second,
+                                  bool is_bind,
+                                  address_t* address) {
+  memset(address, 0, sizeof *address);
+
+#ifdef __POSIX__ // No unix sockets on windows
   if (first->IsString() && !second->IsString()) {
     // UNIX
+    struct sockaddr_un* un = (struct sockaddr_un*) &address->storage;
     String::Utf8Value path(first->ToString());
 
-    if ((size_t) path.length() >= ARRAY_SIZE(un.sun_path)) {
+    if ((size_t) path.length() >= ARRAY_SIZE(un->sun_path)) {
       return Exception::Error(String::New("Socket path too long"));
     }
 
-    memset(&un, 0, sizeof un);
-    un.sun_family = AF_UNIX;
-    memcpy(un.sun_path, *path, path.length());
+    un->sun_family = AF_UNIX;
+    memcpy(un->sun_path, *path, path.length());
 
-    addr = (struct sockaddr*)&un;
-    addrlen = sizeof(un) - sizeof(un.sun_path) + path.length() + 1;
+    address->len = sizeof(*un) - sizeof(un->sun_path) + path.length() + 1;
 
   } else {
 #else // __MINGW32__
@@ -314,37 +328,104 @@ static inline Handle<Value> ParseAddressArgs(Handle<Value> first,
   } else {
 #endif
     // TCP or UDP
-    memset(&in, 0, sizeof in);
-    memset(&in6, 0, sizeof in6);
+    struct sockaddr_in* in = (struct sockaddr_in*) &address->storage;
+    struct sockaddr_in6* in6 = (struct sockaddr_in6*) &address->storage;
 
     int port = first->Int32Value();
-    in.sin_port = in6.sin6_port = htons(port);
-    in.sin_family = AF_INET;
-    in6.sin6_family = AF_INET6;
-
-    bool is_ipv4 = true;
 
     if (!second->IsString()) {
-      in.sin_addr.s_addr = htonl(is_bind ? INADDR_ANY : INADDR_LOOPBACK);
-      in6.sin6_addr = is_bind ? in6addr_any : in6addr_loopback;
+      in->sin_family = AF_INET;
+      in->sin_port = htons(port);
+      in->sin_addr.s_addr = htonl(is_bind ? INADDR_ANY : INADDR_LOOPBACK);
+      address->len = sizeof(*in);
     } else {
       String::Utf8Value ip(second->ToString());
 
-      if (inet_pton(AF_INET, *ip, &(in.sin_addr)) <= 0) {
-        is_ipv4 = false;
-        if (inet_pton(AF_INET6, *ip, &(in6.sin6_addr)) <= 0) {
-          return ErrnoException(errno, "inet_pton", "Invalid IP Address");
-        }
+      if (inet_pton(AF_INET, *ip, &(in->sin_addr)) > 0) {
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        address->len = sizeof(*in);
+      } else if (inet_pton(AF_INET6, *ip, &(in6->sin6_addr)) > 0) {
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        address->len = sizeof(*in6);
+      } else {
+        return ErrnoException(errno, "inet_pton", "Invalid IP Address");
       }
     }
-
-    addr = is_ipv4 ? (struct sockaddr*)&in : (struct sockaddr*)&in6;
-    addrlen = is_ipv4 ? sizeof in : sizeof in6;
   }
   return Handle<Value>();
 }
 
 
+// An address parsed once by JavaScript and then handed to bind(),
+// connect(), sendto() or sendmmsg() any number of times:
+//
+//   var a = new t.SocketAddress(80, "192.168.11.2");
+//   var b = new t.SocketAddress("/tmp/socket");
+//   t.sendto(fd, buffer, 0, buffer.length, 0, a);
+class SocketAddress : public ObjectWrap {
+ public:
+  static void Initialize(Handle<Object> target) {
+    HandleScope scope;
+
+    Local<FunctionTemplate> t = FunctionTemplate::New(New);
+    constructor_template = Persistent<FunctionTemplate>::New(t);
+    constructor_template->InstanceTemplate()->SetInternalFieldCount(1);
+    constructor_template->SetClassName(String::NewSymbol("SocketAddress"));
+
+    target->Set(String::NewSymbol("SocketAddress"),
+                constructor_template->GetFunction());
+  }
+
+  static bool HasInstance(Handle<Value> val) {
+    return val->IsObject() && constructor_template->HasInstance(val);
+  }
+
+  address_t address_;
+
+ private:
+  static Persistent<FunctionTemplate> constructor_template;
+
+  // new SocketAddress(port, [ip], [isBind]) or new SocketAddress(path)
+  static Handle<Value> New(const Arguments& args) {
+    HandleScope scope;
+
+    if (!args.IsConstructCall()) {
+      return ThrowException(Exception::TypeError(
+            String::New("Use the new operator to create a SocketAddress")));
+    }
+
+    SocketAddress* a = new SocketAddress();
+
+    Handle<Value> error = ParseAddress(args[0], args[1], args[2]->IsTrue(),
+                                       &a->address_);
+    if (!error.IsEmpty()) {
+      delete a;
+      return ThrowException(error);
+    }
+
+    a->Wrap(args.This());
+    return args.This();
+  }
+};
+
+Persistent<FunctionTemplate> SocketAddress::constructor_template;
+
+
+// Takes either a SocketAddress or the port and ip (or path) arguments.
+static inline Handle<Value> ParseAddressArgs(Handle<Value> first,
+                                             Handle<Value> second,
+                                             bool is_bind,
+                                             address_t* address) {
+  if (SocketAddress::HasInstance(first)) {
+    *address = ObjectWrap::Unwrap<SocketAddress>(first->ToObject())->address_;
+    return Handle<Value>();
+  }
+  return ParseAddress(first, second, is_bind, address);
+}
+
+
 // Bind with UNIX
 //   t.bind(fd, "/tmp/socket")
 // Bind with TCP
@@ -360,7 +441,8 @@ static Handle<Value> Bind(const Arguments& args) {
 
   FD_ARG(args[0])
 
-  Handle<Value> error = ParseAddressArgs(args[1], args[2], true);
+  address_t address;
+  Handle<Value> error = ParseAddressArgs(args[1], args[2], true, &address);
   if (!error.IsEmpty()) return ThrowException(error);
 
   int flags = 1;
@@ -368,7 +450,7 @@ static Handle<Value> Bind(const Arguments& args) {
 #ifdef __POSIX__
   setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (void *)&flags, sizeof(flags));
 
-  if (0 > bind(fd, addr, addrlen)) {
+  if (0 > bind(fd, ADDR(address), address.len)) {
     return ThrowException(ErrnoException(errno, "bind"));
   }
 
@@ -376,7 +458,7 @@ static Handle<Value> Bind(const Arguments& args) {
   SOCKET handle =  _get_osfhandle(fd);
   setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, (char *)&flags, sizeof(flags));
 
-  if (SOCKET_ERROR == bind(handle, addr, addrlen)) {
+  if (SOCKET_ERROR == bind(handle, ADDR(address), address.len)) {
     return ThrowException(ErrnoException(WSAGetLastError(), "bind"));
   }
 #endif // __MINGW32__
@@ -456,17 +538,18 @@ static Handle<Value> Connect(const Arguments& args) {
 
   FD_ARG(args[0])
 
-  Handle<Value> error = ParseAddressArgs(args[1], args[2], false);
+  address_t address;
+  Handle<Value> error = ParseAddressArgs(args[1], args[2], false, &address);
   if (!error.IsEmpty()) return ThrowException(error);
 
 #ifdef __POSIX__
-  int r = connect(fd, addr, addrlen);
+  int r = connect(fd, ADDR(address), address.len);
 
   if (r < 0 && errno != EINPROGRESS) {
     return ThrowException(ErrnoException(errno, "connect"));
   }
 #else // __MINGW32__
-  int r = connect(_get_osfhandle(fd), addr, addrlen);
+  int r = connect(_get_osfhandle(fd), ADDR(address), address.len);
 
   if (r == SOCKET_ERROR) {
     int wsaErrno = WSAGetLastError();
@@ -1150,7 +1233,8 @@ static Handle<Value> SendMsg(const Arguments& args) {
 // The 'flags' parameter is a number representing a bitmask of MSG_* values.
 // This is passed directly to sendmsg().
 //
-// The destination port can either be an int port, or a path.
+// The destination port can either be an int port, or a path, or a
+// SocketAddress in which case the address argument is ignored.
 //
 // Returns null on EAGAIN or EINTR, raises an exception on all other errors
 static Handle<Value> SendTo(const Arguments& args) {
@@ -1212,12 +1296,13 @@ static Handle<Value> SendTo(const Arguments& args) {
     flags = args[4]->Uint32Value();
   }
 
-  Handle<Value> error = ParseAddressArgs(args[5], args[6], false);
+  address_t address;
+  Handle<Value> error = ParseAddressArgs(args[5], args[6], false, &address);
   if (!error.IsEmpty()) return ThrowException(error);
 
 #ifdef __POSIX__
-  ssize_t written = sendto(fd, buffer_data + offset, length, flags, addr,
-      addrlen);
+  ssize_t written = sendto(fd, buffer_data + offset, length, flags,
+      ADDR(address), address.len);
 
   if (written < 0) {
     if (errno == EAGAIN || errno == EINTR) return Null();
@@ -1226,7 +1311,7 @@ static Handle<Value> SendTo(const Arguments& args) {
 
 #else // __MINGW32__
   ssize_t written = sendto(_get_osfhandle(fd), buffer_data + offset, length,
-      flags, addr, addrlen);
+      flags, ADDR(address), address.len);
 
   if (written == SOCKET_ERROR) {
     int wsaErrno = WSAGetLastError();
@@ -1242,6 +1327,299 @@ static Handle<Value> SendTo(const Arguments& args) {
 }
 
 
+#ifdef __POSIX__
+
+// Upper bound on the datagrams moved by one recvmmsg / sendmmsg call.
+#define MMSG_MAX 64
+
+// Linux >= 2.6.33 has recvmmsg, >= 3.0 sendmmsg. Go through syscall()
+// since not every libc (e.g. bionic) has wrappers for them. On other
+// platforms, and on kernels that return ENOSYS, we fall back to a loop
+// of recvfrom / sendto so that the binding works everywhere.
+#if defined(__linux__) && defined(__NR_recvmmsg)
+# define HAVE_RECVMMSG 1
+#endif
+#if defined(__linux__) && defined(__NR_sendmmsg)
+# define HAVE_SENDMMSG 1
+#endif
+
+#if defined(HAVE_RECVMMSG) || defined(HAVE_SENDMMSG)
+struct node_mmsghdr {
+  struct msghdr msg_hdr;
+  unsigned int msg_len;
+};
+#endif
+
+#ifdef HAVE_RECVMMSG
+static bool recvmmsg_unsupported = false;
+#endif
+#ifdef HAVE_SENDMMSG
+static bool sendmmsg_unsupported = false;
+#endif
+
+
+//  var records = t.recvmmsg(fd, buffer, offset, length, count);
+//    Receives up to count datagrams of at most length bytes each into
+//    buffer, starting at offset. The datagrams are packed back to back, so
+//    the last record tells how much of the buffer was used.
+//    records[i].offset // where the datagram starts in buffer
+//    records[i].length // bytes read
+//    records[i].port // from port
+//    records[i].address // from address
+//  returns null on EAGAIN or EINTR, raises an exception on all other errors
+static Handle<Value> RecvMMsg(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() < 5) {
+    return ThrowException(Exception::TypeError(
+          String::New("Takes 5 parameters")));
+  }
+
+  FD_ARG(args[0])
+
+  if (!Buffer::HasInstance(args[1])) {
+    return ThrowException(Exception::TypeError(
+          String::New("Second argument should be a buffer")));
+  }
+
+  Local<Object> buffer_obj = args[1]->ToObject();
+  char *buffer_data = Buffer::Data(buffer_obj);
+  size_t buffer_length = Buffer::Length(buffer_obj);
+
+  size_t off = args[2]->Int32Value();
+  if (off >= buffer_length) {
+    return ThrowException(Exception::Error(
+          String::New("Offset is out of bounds")));
+  }
+
+  size_t len = args[3]->Int32Value();
+  if (len == 0 || off + len > buffer_length) {
+    return ThrowException(Exception::Error(
+          String::New("Length is extends beyond buffer")));
+  }
+
+  int count = args[4]->Int32Value();
+  if (count < 1) count = 1;
+  if (count > MMSG_MAX) count = MMSG_MAX;
+  if ((size_t) count > (buffer_length - off) / len) {
+    count = (buffer_length - off) / len;
+  }
+
+  struct sockaddr_storage address_storage[MMSG_MAX];
+  socklen_t addrlens[MMSG_MAX];
+  size_t bytes_read[MMSG_MAX];
+  int n = -1;
+
+#ifdef HAVE_RECVMMSG
+  if (!recvmmsg_unsupported) {
+    struct iovec iov[MMSG_MAX];
+    struct node_mmsghdr msgs[MMSG_MAX];
+
+    memset(msgs, 0, sizeof(msgs[0]) * count);
+    for (int i = 0; i < count; i++) {
+      iov[i].iov_base = buffer_data + off + i * len;
+      iov[i].iov_len = len;
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_name = &address_storage[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(address_storage[i]);
+    }
+
+    n = syscall(__NR_recvmmsg, fd, msgs, count, 0, NULL);
+
+    if (n < 0) {
+      if (errno == ENOSYS) {
+        recvmmsg_unsupported = true;
+      } else if (errno == EAGAIN || errno == EINTR) {
+        return Null();
+      } else {
+        return ThrowException(ErrnoException(errno, "recvmmsg"));
+      }
+    }
+
+    for (int i = 0; i < n; i++) {
+      bytes_read[i] = msgs[i].msg_len;
+      addrlens[i] = msgs[i].msg_hdr.msg_namelen;
+    }
+  }
+#endif
+
+  if (n < 0) {
+    for (n = 0; n < count; n++) {
+      addrlens[n] = sizeof(address_storage[n]);
+
+      ssize_t r = recvfrom(fd, buffer_data + off + n * len, len, 0,
+          (struct sockaddr*) &address_storage[n], &addrlens[n]);
+
+      if (r < 0) {
+        if (n > 0 || errno == EAGAIN || errno == EINTR) break;
+        return ThrowException(ErrnoException(errno, "recvfrom"));
+      }
+
+      bytes_read[n] = r;
+    }
+  }
+
+  if (n == 0) return Null();
+
+  Local<Array> records = Array::New(n);
+  size_t pos = off;
+
+  for (int i = 0; i < n; i++) {
+    // Close the gap left by the previous datagram if it didn't fill
+    // its slot.
+    if (pos != off + i * len) {
+      memmove(buffer_data + pos, buffer_data + off + i * len, bytes_read[i]);
+    }
+
+    Local<Object> info = Object::New();
+    info->Set(offset_symbol, Integer::New(pos));
+    info->Set(length_symbol, Integer::New(bytes_read[i]));
+    ADDRESS_TO_JS(info, address_storage[i], addrlens[i]);
+    records->Set(i, info);
+
+    pos += bytes_read[i];
+  }
+
+  return scope.Close(records);
+}
+
+
+//  var sent = t.sendmmsg(fd, messages, flags);
+//    messages[i].buffer
+//    messages[i].offset // optional, defaults to 0
+//    messages[i].length // optional, defaults to the rest of the buffer
+//    messages[i].port // port or, for unix sockets, path
+//    messages[i].address // ip, unused for unix sockets
+//
+// Sends up to 64 messages with one system call. Returns the number of
+// messages sent, which can be less than messages.length.
+//
+// Returns null on EAGAIN or EINTR, raises an exception on all other errors
+static Handle<Value> SendMMsg(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() < 2 || !args[1]->IsArray()) {
+    return ThrowException(Exception::TypeError(
+          String::New("Expected an array of messages")));
+  }
+
+  FD_ARG(args[0])
+
+  Local<Array> messages = Local<Array>::Cast(args[1]);
+
+  int flags = 0;
+  if (args.Length() >= 3 && !args[2]->IsUndefined()) {
+    if (!args[2]->IsUint32()) {
+      return ThrowException(Exception::TypeError(
+        String::New("Expected unsigned integer for a flags argument")));
+    }
+
+    flags = args[2]->Uint32Value();
+  }
+
+  int count = messages->Length();
+  if (count > MMSG_MAX) count = MMSG_MAX;
+  if (count == 0) return scope.Close(Integer::New(0));
+
+  struct iovec iov[MMSG_MAX];
+  address_t addresses[MMSG_MAX];
+
+  for (int i = 0; i < count; i++) {
+    if (!messages->Get(i)->IsObject()) {
+      return ThrowException(Exception::TypeError(
+        String::New("Expected an array of messages")));
+    }
+
+    Local<Object> message = messages->Get(i)->ToObject();
+    Local<Value> buffer_v = message->Get(buffer_symbol);
+
+    if (!Buffer::HasInstance(buffer_v)) {
+      return ThrowException(Exception::TypeError(
+        String::New("Expected a buffer")));
+    }
+
+    Local<Object> buffer_obj = buffer_v->ToObject();
+    char *buffer_data = Buffer::Data(buffer_obj);
+    size_t buffer_length = Buffer::Length(buffer_obj);
+
+    size_t offset = 0;
+    Local<Value> offset_v = message->Get(offset_symbol);
+    if (!offset_v->IsUndefined()) {
+      offset = offset_v->Uint32Value();
+      if (offset >= buffer_length) {
+        return ThrowException(Exception::Error(
+          String::New("Offset into buffer too large")));
+      }
+    }
+
+    size_t length = buffer_length - offset;
+    Local<Value> length_v = message->Get(length_symbol);
+    if (!length_v->IsUndefined()) {
+      length = length_v->Uint32Value();
+      if (offset + length > buffer_length) {
+        return ThrowException(Exception::Error(
+          String::New("offset + length beyond buffer length")));
+      }
+    }
+
+    Handle<Value> error = ParseAddressArgs(message->Get(port_symbol),
+                                           message->Get(address_symbol),
+                                           false,
+                                           &addresses[i]);
+    if (!error.IsEmpty()) return ThrowException(error);
+
+    iov[i].iov_base = buffer_data + offset;
+    iov[i].iov_len = length;
+  }
+
+  int sent = -1;
+
+#ifdef HAVE_SENDMMSG
+  if (!sendmmsg_unsupported) {
+    struct node_mmsghdr msgs[MMSG_MAX];
+
+    memset(msgs, 0, sizeof(msgs[0]) * count);
+    for (int i = 0; i < count; i++) {
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_name = ADDR(addresses[i]);
+      msgs[i].msg_hdr.msg_namelen = addresses[i].len;
+    }
+
+    sent = syscall(__NR_sendmmsg, fd, msgs, count, flags);
+
+    if (sent < 0) {
+      if (errno == ENOSYS) {
+        sendmmsg_unsupported = true;
+      } else if (errno == EAGAIN || errno == EINTR) {
+        return Null();
+      } else {
+        return ThrowException(ErrnoException(errno, "sendmmsg"));
+      }
+    }
+  }
+#endif
+
+  if (sent < 0) {
+    for (sent = 0; sent < count; sent++) {
+      ssize_t r = sendto(fd, iov[sent].iov_base, iov[sent].iov_len, flags,
+          ADDR(addresses[sent]), addresses[sent].len);
+
+      if (r < 0) {
+        if (sent > 0) break;
+        if (errno == EAGAIN || errno == EINTR) return Null();
+        return ThrowException(ErrnoException(errno, "sendto"));
+      }
+    }
+  }
+
+  return scope.Close(Integer::New(sent));
+}
+
+#endif // __POSIX__
+
+
 // Probably only works for Linux TCP sockets?
 // Returns the amount of data on the read queue.
 static Handle<Value> ToRead(const Arguments& args) {
@@ -1342,6 +1720,73 @@ static Handle<Value> SetKeepAlive(const Arguments& args) {
 }
 
 
+#ifdef __POSIX__
+
+// Sets an integer socket option, booleans are passed as 0 or 1.
+// Shared by the TCP tuning setters below.
+static Handle<Value> SetIntOption(const Arguments& args,
+                                  int level,
+                                  int option) {
+  HandleScope scope;
+
+  FD_ARG(args[0])
+
+  int value = args[1]->IsBoolean() ? args[1]->IsTrue() : args[1]->Int32Value();
+
+  if (0 > setsockopt(fd, level, option, (void *)&value, sizeof(value))) {
+    return ThrowException(ErrnoException(errno, "setsockopt"));
+  }
+
+  return Undefined();
+}
+
+
+// t.setRecvBufferSize(fd, bytes)
+static Handle<Value> SetRecvBufferSize(const Arguments& args) {
+  return SetIntOption(args, SOL_SOCKET, SO_RCVBUF);
+}
+
+
+// t.setSendBufferSize(fd, bytes)
+static Handle<Value> SetSendBufferSize(const Arguments& args) {
+  return SetIntOption(args, SOL_SOCKET, SO_SNDBUF);
+}
+
+
+#ifdef TCP_CORK
+// t.setCork(fd, true) holds back partial frames until t.setCork(fd, false)
+static Handle<Value> SetCork(const Arguments& args) {
+  return SetIntOption(args, IPPROTO_TCP, TCP_CORK);
+}
+#endif
+
+
+#ifdef TCP_QUICKACK
+// t.setQuickAck(fd, true)
+static Handle<Value> SetQuickAck(const Arguments& args) {
+  return SetIntOption(args, IPPROTO_TCP, TCP_QUICKACK);
+}
+#endif
+
+
+#ifdef TCP_DEFER_ACCEPT
+// t.setDeferAccept(fd, seconds) only wakes up a listener once data arrives
+static Handle<Value> SetDeferAccept(const Arguments& args) {
+  return SetIntOption(args, IPPROTO_TCP, TCP_DEFER_ACCEPT);
+}
+#endif
+
+
+#ifdef TCP_FASTOPEN
+// t.setFastOpen(fd, queueLength) must be called before t.listen(fd)
+static Handle<Value> SetFastOpen(const Arguments& args) {
+  return SetIntOption(args, IPPROTO_TCP, TCP_FASTOPEN);
+}
+#endif
+
+#endif // __POSIX__
+
+
 static Handle<Value> SetBroadcast(const Arguments& args) {
   HandleScope scope;
 
@@ -1723,6 +2168,8 @@ void InitNet(Handle<Object> target) {
   NODE_SET_METHOD(target, "recvfrom", RecvFrom);
 
 #ifdef __POSIX__
+  NODE_SET_METHOD(target, "sendmmsg", SendMMsg);
+  NODE_SET_METHOD(target, "recvmmsg", RecvMMsg);
   NODE_SET_METHOD(target, "sendMsg", SendMsg);
 
   recv_msg_template =
@@ -1750,6 +2197,20 @@ void InitNet(Handle<Object> target) {
   NODE_SET_METHOD(target, "setTTL", SetTTL);
   NODE_SET_METHOD(target, "setKeepAlive", SetKeepAlive);
 #ifdef __POSIX__
+  NODE_SET_METHOD(target, "setRecvBufferSize", SetRecvBufferSize);
+  NODE_SET_METHOD(target, "setSendBufferSize", SetSendBufferSize);
+#ifdef TCP_CORK
+  NODE_SET_METHOD(target, "setCork", SetCork);
+#endif
+#ifdef TCP_QUICKACK
+  NODE_SET_METHOD(target, "setQuickAck", SetQuickAck);
+#endif
+#ifdef TCP_DEFER_ACCEPT
+  NODE_SET_METHOD(target, "setDeferAccept", SetDeferAccept);
+#endif
+#ifdef TCP_FASTOPEN
+  NODE_SET_METHOD(target, "setFastOpen", SetFastOpen);
+#endif
   NODE_SET_METHOD(target, "setMulticastTTL", SetMulticastTTL);
   NODE_SET_METHOD(target, "setMulticastLoopback", SetMulticastLoopback);
   NODE_SET_METHOD(target, "addMembership", AddMembership);
@@ -1761,12 +2222,17 @@ void InitNet(Handle<Object> target) {
   NODE_SET_METHOD(target, "isIP", IsIP);
   NODE_SET_METHOD(target, "errnoException", CreateErrnoException);
 
+  SocketAddress::Initialize(target);
+
   errno_symbol          = NODE_PSYMBOL("errno");
   syscall_symbol        = NODE_PSYMBOL("syscall");
   fd_symbol             = NODE_PSYMBOL("fd");
   size_symbol           = NODE_PSYMBOL("size");
   address_symbol        = NODE_PSYMBOL("address");
   port_symbol           = NODE_PSYMBOL("port");
+  offset_symbol         = NODE_PSYMBOL("offset");
+  length_symbol         = NODE_PSYMBOL("length");
+  buffer_symbol         = NODE_PSYMBOL("buffer");
 }
 
 }  // namespace node
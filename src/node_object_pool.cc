@@ -0,0 +1,145 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <node.h>
+
+#include <v8.h>
+
+// The JavaScript face of a bounded LIFO free list, used by lib/freelist.js.
+// The items live in one JavaScript array held by the pool object, so
+// alloc() and free() don't create or dispose of a handle each.
+//
+//   var pool = new ObjectPool(max);
+//   var obj = pool.alloc();   // undefined when the pool is empty
+//   var kept = pool.free(obj);  // false when the pool is full
+//   pool.stats();  // { length, max, hits, misses }
+
+namespace node {
+
+using namespace v8;
+
+static Persistent<String> length_sym;
+static Persistent<String> max_sym;
+static Persistent<String> hits_sym;
+static Persistent<String> misses_sym;
+
+// Internal field 0 is the ObjectWrap pointer.
+static const int kItemsField = 1;
+
+
+class JSObjectPool : public ObjectWrap {
+ public:
+  static void Initialize(Handle<Object> target) {
+    HandleScope scope;
+
+    Local<FunctionTemplate> t = FunctionTemplate::New(New);
+    t->InstanceTemplate()->SetInternalFieldCount(2);
+    t->SetClassName(String::NewSymbol("ObjectPool"));
+
+    NODE_SET_PROTOTYPE_METHOD(t, "alloc", Alloc);
+    NODE_SET_PROTOTYPE_METHOD(t, "free", Free);
+    NODE_SET_PROTOTYPE_METHOD(t, "stats", Stats);
+
+    target->Set(String::NewSymbol("ObjectPool"), t->GetFunction());
+
+    length_sym = NODE_PSYMBOL("length");
+    max_sym = NODE_PSYMBOL("max");
+    hits_sym = NODE_PSYMBOL("hits");
+    misses_sym = NODE_PSYMBOL("misses");
+  }
+
+ private:
+  explicit JSObjectPool(uint32_t max)
+      : ObjectWrap(), length_(0), max_(max), hits_(0), misses_(0) {
+  }
+
+  static Local<Array> Items(const Arguments& args) {
+    return Local<Array>::Cast(args.This()->GetInternalField(kItemsField));
+  }
+
+  static Handle<Value> New(const Arguments& args) {
+    HandleScope scope;
+
+    if (!args[0]->IsUint32()) {
+      return ThrowException(Exception::TypeError(
+            String::New("Argument must be a non-negative integer")));
+    }
+
+    JSObjectPool* pool = new JSObjectPool(args[0]->Uint32Value());
+    pool->Wrap(args.This());
+    args.This()->SetInternalField(kItemsField, Array::New());
+
+    return args.This();
+  }
+
+  static Handle<Value> Alloc(const Arguments& args) {
+    HandleScope scope;
+
+    JSObjectPool* pool = ObjectWrap::Unwrap<JSObjectPool>(args.This());
+
+    if (pool->length_ == 0) {
+      pool->misses_++;
+      return Undefined();
+    }
+    pool->hits_++;
+
+    // Let go of the slot, the pool must not keep the object alive.
+    Local<Array> items = Items(args);
+    Local<Value> obj = items->Get(--pool->length_);
+    items->Set(pool->length_, Undefined());
+    return scope.Close(obj);
+  }
+
+  // Takes anything, like the Array based free list did.
+  static Handle<Value> Free(const Arguments& args) {
+    HandleScope scope;
+
+    JSObjectPool* pool = ObjectWrap::Unwrap<JSObjectPool>(args.This());
+
+    if (pool->length_ == pool->max_) return False();
+
+    Items(args)->Set(pool->length_++, args[0]);
+    return True();
+  }
+
+  static Handle<Value> Stats(const Arguments& args) {
+    HandleScope scope;
+
+    JSObjectPool* pool = ObjectWrap::Unwrap<JSObjectPool>(args.This());
+
+    Local<Object> stats = Object::New();
+    stats->Set(length_sym, Integer::NewFromUnsigned(pool->length_));
+    stats->Set(max_sym, Integer::NewFromUnsigned(pool->max_));
+    stats->Set(hits_sym, Number::New(pool->hits_));
+    stats->Set(misses_sym, Number::New(pool->misses_));
+    return scope.Close(stats);
+  }
+
+  uint32_t length_;
+  uint32_t max_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
+
+
+}  // namespace node
+
+NODE_MODULE(node_object_pool, node::JSObjectPool::Initialize);
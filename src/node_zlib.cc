@@ -0,0 +1,388 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <node.h>
+#include <node_buffer.h>
+
+#include <v8.h>
+#include <zlib.h>
+
+#include <assert.h>
+#include <string.h>
+
+// Streaming deflate/inflate. lib/zlib.js drives it:
+//
+//   var z = new binding.Zlib(binding.GZIP);
+//   z.init(windowBits, level, memLevel, strategy);
+//   z.callback = function(availInAfter, availOutAfter) { ... };
+//   z.onerror = function(message, errno) { ... };
+//   z.write(flush, in, in_off, in_len, out, out_off, out_len);
+//
+// write() returns right away. deflate() or inflate() runs on the eio thread
+// pool, and z.callback is called on the loop thread when it is done. Only
+// one write may be in progress at a time, and the buffers must not be
+// touched until the callback.
+
+namespace node {
+
+using namespace v8;
+
+enum node_zlib_mode {
+  NONE,
+  DEFLATE,
+  INFLATE,
+  GZIP,
+  GUNZIP,
+  DEFLATERAW,
+  INFLATERAW,
+  UNZIP
+};
+
+
+class ZCtx : public ObjectWrap {
+ public:
+  static void Initialize(Handle<Object> target) {
+    HandleScope scope;
+
+    Local<FunctionTemplate> t = FunctionTemplate::New(New);
+    t->InstanceTemplate()->SetInternalFieldCount(1);
+    t->SetClassName(String::NewSymbol("Zlib"));
+
+    NODE_SET_PROTOTYPE_METHOD(t, "init", Init);
+    NODE_SET_PROTOTYPE_METHOD(t, "write", Write);
+    NODE_SET_PROTOTYPE_METHOD(t, "reset", Reset);
+    NODE_SET_PROTOTYPE_METHOD(t, "close", Close);
+
+    target->Set(String::NewSymbol("Zlib"), t->GetFunction());
+
+    NODE_DEFINE_CONSTANT(target, Z_NO_FLUSH);
+    NODE_DEFINE_CONSTANT(target, Z_PARTIAL_FLUSH);
+    NODE_DEFINE_CONSTANT(target, Z_SYNC_FLUSH);
+    NODE_DEFINE_CONSTANT(target, Z_FULL_FLUSH);
+    NODE_DEFINE_CONSTANT(target, Z_FINISH);
+
+    NODE_DEFINE_CONSTANT(target, Z_OK);
+    NODE_DEFINE_CONSTANT(target, Z_STREAM_END);
+    NODE_DEFINE_CONSTANT(target, Z_NEED_DICT);
+    NODE_DEFINE_CONSTANT(target, Z_ERRNO);
+    NODE_DEFINE_CONSTANT(target, Z_STREAM_ERROR);
+    NODE_DEFINE_CONSTANT(target, Z_DATA_ERROR);
+    NODE_DEFINE_CONSTANT(target, Z_MEM_ERROR);
+    NODE_DEFINE_CONSTANT(target, Z_BUF_ERROR);
+    NODE_DEFINE_CONSTANT(target, Z_VERSION_ERROR);
+
+    NODE_DEFINE_CONSTANT(target, Z_NO_COMPRESSION);
+    NODE_DEFINE_CONSTANT(target, Z_BEST_SPEED);
+    NODE_DEFINE_CONSTANT(target, Z_BEST_COMPRESSION);
+    NODE_DEFINE_CONSTANT(target, Z_DEFAULT_COMPRESSION);
+    NODE_DEFINE_CONSTANT(target, Z_FILTERED);
+    NODE_DEFINE_CONSTANT(target, Z_HUFFMAN_ONLY);
+    NODE_DEFINE_CONSTANT(target, Z_RLE);
+    NODE_DEFINE_CONSTANT(target, Z_FIXED);
+    NODE_DEFINE_CONSTANT(target, Z_DEFAULT_STRATEGY);
+
+    NODE_DEFINE_CONSTANT(target, DEFLATE);
+    NODE_DEFINE_CONSTANT(target, INFLATE);
+    NODE_DEFINE_CONSTANT(target, GZIP);
+    NODE_DEFINE_CONSTANT(target, GUNZIP);
+    NODE_DEFINE_CONSTANT(target, DEFLATERAW);
+    NODE_DEFINE_CONSTANT(target, INFLATERAW);
+    NODE_DEFINE_CONSTANT(target, UNZIP);
+
+    target->Set(String::NewSymbol("ZLIB_VERSION"),
+                String::New(ZLIB_VERSION));
+  }
+
+ private:
+  ZCtx(node_zlib_mode mode) : ObjectWrap() {
+    mode_ = mode;
+    init_done_ = false;
+    write_in_progress_ = false;
+    flush_ = Z_NO_FLUSH;
+    err_ = Z_OK;
+    memset(&strm_, 0, sizeof(strm_));
+  }
+
+  ~ZCtx() {
+    assert(!write_in_progress_);
+    End();
+  }
+
+  bool IsDeflate() const {
+    return mode_ == DEFLATE || mode_ == GZIP || mode_ == DEFLATERAW;
+  }
+
+  void End() {
+    if (!init_done_) return;
+    if (IsDeflate()) {
+      deflateEnd(&strm_);
+    } else {
+      inflateEnd(&strm_);
+    }
+    init_done_ = false;
+  }
+
+  static Handle<Value> New(const Arguments& args) {
+    HandleScope scope;
+
+    int mode = args[0]->Int32Value();
+    if (mode < DEFLATE || mode > UNZIP) {
+      return ThrowException(Exception::TypeError(String::New("Bad argument")));
+    }
+
+    ZCtx *ctx = new ZCtx(static_cast<node_zlib_mode>(mode));
+    ctx->Wrap(args.This());
+
+    return args.This();
+  }
+
+  // z.init(windowBits, level, memLevel, strategy)
+  static Handle<Value> Init(const Arguments& args) {
+    HandleScope scope;
+
+    ZCtx *ctx = ObjectWrap::Unwrap<ZCtx>(args.This());
+
+    if (ctx->init_done_) {
+      return ThrowException(Exception::Error(
+            String::New("Already initialized")));
+    }
+
+    int windowBits = args[0]->Int32Value();
+    int level = args[1]->Int32Value();
+    int memLevel = args[2]->Int32Value();
+    int strategy = args[3]->Int32Value();
+
+    // zlib picks the header from windowBits: +16 for gzip, +32 to detect
+    // gzip or zlib from the stream, negative for a raw stream without one.
+    switch (ctx->mode_) {
+      case GZIP:
+      case GUNZIP:
+        windowBits += 16;
+        break;
+      case DEFLATERAW:
+      case INFLATERAW:
+        windowBits = -windowBits;
+        break;
+      case UNZIP:
+        windowBits += 32;
+        break;
+      default:
+        break;
+    }
+
+    int err;
+    if (ctx->IsDeflate()) {
+      err = deflateInit2(&ctx->strm_, level, Z_DEFLATED, windowBits,
+                         memLevel, strategy);
+    } else {
+      err = inflateInit2(&ctx->strm_, windowBits);
+    }
+
+    if (err != Z_OK) {
+      return ThrowException(Exception::Error(
+            String::New(ctx->strm_.msg ? ctx->strm_.msg : "Init error")));
+    }
+
+    ctx->init_done_ = true;
+    return Undefined();
+  }
+
+  // z.write(flush, in, in_off, in_len, out, out_off, out_len)
+  static Handle<Value> Write(const Arguments& args) {
+    HandleScope scope;
+
+    ZCtx *ctx = ObjectWrap::Unwrap<ZCtx>(args.This());
+
+    if (!ctx->init_done_) {
+      return ThrowException(Exception::Error(String::New("Not initialized")));
+    }
+    if (ctx->write_in_progress_) {
+      return ThrowException(Exception::Error(
+            String::New("Write already in progress")));
+    }
+
+    int flush = args[0]->Int32Value();
+    if (flush != Z_NO_FLUSH && flush != Z_PARTIAL_FLUSH &&
+        flush != Z_SYNC_FLUSH && flush != Z_FULL_FLUSH && flush != Z_FINISH) {
+      return ThrowException(Exception::TypeError(
+            String::New("Invalid flush value")));
+    }
+
+    char *in = NULL;
+    size_t in_len = 0;
+
+    // The input may be null when all that is wanted is a flush.
+    if (!args[1]->IsNull() && !args[1]->IsUndefined()) {
+      if (!Buffer::HasInstance(args[1])) {
+        return ThrowException(Exception::TypeError(
+              String::New("Input must be a buffer")));
+      }
+      Local<Object> in_buf = args[1]->ToObject();
+      size_t in_off = args[2]->Uint32Value();
+      in_len = args[3]->Uint32Value();
+      if (in_off > Buffer::Length(in_buf) ||
+          in_len > Buffer::Length(in_buf) - in_off) {
+        return ThrowException(Exception::Error(
+              String::New("Input offset or length out of bounds")));
+      }
+      in = Buffer::Data(in_buf) + in_off;
+      ctx->in_ = Persistent<Object>::New(in_buf);
+    }
+
+    if (!Buffer::HasInstance(args[4])) {
+      ctx->in_.Dispose();
+      ctx->in_.Clear();
+      return ThrowException(Exception::TypeError(
+            String::New("Output must be a buffer")));
+    }
+    Local<Object> out_buf = args[4]->ToObject();
+    size_t out_off = args[5]->Uint32Value();
+    size_t out_len = args[6]->Uint32Value();
+    if (out_off > Buffer::Length(out_buf) ||
+        out_len > Buffer::Length(out_buf) - out_off) {
+      ctx->in_.Dispose();
+      ctx->in_.Clear();
+      return ThrowException(Exception::Error(
+            String::New("Output offset or length out of bounds")));
+    }
+    ctx->out_ = Persistent<Object>::New(out_buf);
+
+    ctx->strm_.next_in = reinterpret_cast<Bytef*>(in);
+    ctx->strm_.avail_in = in_len;
+    ctx->strm_.next_out =
+        reinterpret_cast<Bytef*>(Buffer::Data(out_buf) + out_off);
+    ctx->strm_.avail_out = out_len;
+    ctx->flush_ = flush;
+    ctx->write_in_progress_ = true;
+
+    // Keep the object alive until AfterProcess(), and the loop running:
+    // there is no watcher on it while the thread pool works.
+    ctx->Ref();
+    eio_custom(Process, EIO_PRI_DEFAULT, AfterProcess, ctx);
+    uv_ref();
+
+    return Undefined();
+  }
+
+  static int Process(eio_req *req) {
+    // Note: this function is executed in the thread pool! CAREFUL
+    ZCtx *ctx = static_cast<ZCtx*>(req->data);
+
+    if (ctx->IsDeflate()) {
+      ctx->err_ = deflate(&ctx->strm_, ctx->flush_);
+    } else {
+      ctx->err_ = inflate(&ctx->strm_, ctx->flush_);
+    }
+
+    return 0;
+  }
+
+  static int AfterProcess(eio_req *req) {
+    ZCtx *ctx = static_cast<ZCtx*>(req->data);
+
+    uv_unref();
+    ctx->write_in_progress_ = false;
+    ctx->in_.Dispose();
+    ctx->in_.Clear();
+    ctx->out_.Dispose();
+    ctx->out_.Clear();
+
+    HandleScope scope;
+    Context::Scope cscope(ctx->handle_->CreationContext());
+
+    switch (ctx->err_) {
+      case Z_OK:
+      case Z_STREAM_END:
+      // Z_BUF_ERROR only means that no progress was possible, e.g. the
+      // output buffer was full. The caller will come back with more room.
+      case Z_BUF_ERROR: {
+        Local<Value> argv[2] = {
+          Integer::NewFromUnsigned(ctx->strm_.avail_in),
+          Integer::NewFromUnsigned(ctx->strm_.avail_out)
+        };
+        Node::MakeCallback(ctx->handle_, "callback", 2, argv);
+        break;
+      }
+
+      default: {
+        const char *message = ctx->strm_.msg ? ctx->strm_.msg : "Zlib error";
+        Local<Value> argv[2] = {
+          String::New(message),
+          Integer::New(ctx->err_)
+        };
+        Node::MakeCallback(ctx->handle_, "onerror", 2, argv);
+        break;
+      }
+    }
+
+    ctx->Unref();
+    return 0;
+  }
+
+  static Handle<Value> Reset(const Arguments& args) {
+    HandleScope scope;
+
+    ZCtx *ctx = ObjectWrap::Unwrap<ZCtx>(args.This());
+
+    if (!ctx->init_done_ || ctx->write_in_progress_) {
+      return ThrowException(Exception::Error(String::New("Cannot reset")));
+    }
+
+    if (ctx->IsDeflate()) {
+      deflateReset(&ctx->strm_);
+    } else {
+      inflateReset(&ctx->strm_);
+    }
+
+    return Undefined();
+  }
+
+  // Frees the zlib state right away instead of waiting for the GC.
+  static Handle<Value> Close(const Arguments& args) {
+    HandleScope scope;
+
+    ZCtx *ctx = ObjectWrap::Unwrap<ZCtx>(args.This());
+
+    if (ctx->write_in_progress_) {
+      return ThrowException(Exception::Error(
+            String::New("Write in progress")));
+    }
+
+    ctx->End();
+    return Undefined();
+  }
+
+  z_stream strm_;
+  node_zlib_mode mode_;
+  bool init_done_;
+  bool write_in_progress_;
+  int flush_;
+  int err_;
+
+  // The buffers of the write in progress.
+  Persistent<Object> in_;
+  Persistent<Object> out_;
+};
+
+
+}  // namespace node
+
+NODE_MODULE(node_zlib, node::ZCtx::Initialize);
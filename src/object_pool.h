@@ -0,0 +1,78 @@
+#ifndef OBJECT_POOL_H_
+#define OBJECT_POOL_H_
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace node {
+
+// A bounded free list kept as a stack. Alloc() hands back the most recently
+// freed item, which is also the one most likely to still be in the cache,
+// and both Alloc() and Free() are O(1).
+//
+// Items are stored by value, so keep pointers for C++ objects. JavaScript
+// objects are better kept in a JavaScript array than in a Persistent each,
+// see node_object_pool.cc. The pool never creates or destroys items itself.
+// On a miss the caller makes a new one, and when the pool is full the
+// caller disposes of the item it tried to free.
+template <typename T>
+class ObjectPool {
+ public:
+  explicit ObjectPool(size_t max)
+      : items_(max ? new T[max] : NULL),
+        length_(0),
+        max_(max),
+        hits_(0),
+        misses_(0) {
+  }
+
+  ~ObjectPool() {
+    delete [] items_;
+  }
+
+  // Returns false when the pool is empty.
+  bool Alloc(T* item) {
+    if (length_ == 0) {
+      misses_++;
+      return false;
+    }
+    hits_++;
+    *item = items_[--length_];
+    return true;
+  }
+
+  // Returns false when the pool is full.
+  bool Free(const T& item) {
+    if (length_ == max_) return false;
+    items_[length_++] = item;
+    return true;
+  }
+
+  // Takes an item out without counting it, for draining the pool.
+  bool Take(T* item) {
+    if (length_ == 0) return false;
+    *item = items_[--length_];
+    return true;
+  }
+
+  size_t length() const { return length_; }
+  size_t max() const { return max_; }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+ private:
+  // Not copyable.
+  ObjectPool(const ObjectPool&);
+  void operator=(const ObjectPool&);
+
+  T* items_;
+  size_t length_;
+  size_t max_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
+
+}  // namespace node
+
+#endif  // OBJECT_POOL_H_
@@ -1,6 +1,16 @@
 #include <node.h>
 #include <node_buffer.h>
 
+#ifdef __POSIX__
+# include <sys/socket.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+#endif
+
+#if defined(__linux__) && !defined(TCP_FASTOPEN)
+# define TCP_FASTOPEN 23
+#endif
+
 #define SLAB_SIZE (1024 * 1024)
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
@@ -81,6 +91,21 @@ class TCPWrap {
 
     NODE_SET_PROTOTYPE_METHOD(t, "bind", Bind);
     NODE_SET_PROTOTYPE_METHOD(t, "listen", Listen);
+    NODE_SET_PROTOTYPE_METHOD(t, "setAcceptBatch", SetAcceptBatch);
+    NODE_SET_PROTOTYPE_METHOD(t, "setRecvBufferSize", SetRecvBufferSize);
+    NODE_SET_PROTOTYPE_METHOD(t, "setSendBufferSize", SetSendBufferSize);
+#ifdef TCP_CORK
+    NODE_SET_PROTOTYPE_METHOD(t, "setCork", SetCork);
+#endif
+#ifdef TCP_QUICKACK
+    NODE_SET_PROTOTYPE_METHOD(t, "setQuickAck", SetQuickAck);
+#endif
+#ifdef TCP_DEFER_ACCEPT
+    NODE_SET_PROTOTYPE_METHOD(t, "setDeferAccept", SetDeferAccept);
+#endif
+#ifdef TCP_FASTOPEN
+    NODE_SET_PROTOTYPE_METHOD(t, "setFastOpen", SetFastOpen);
+#endif
     NODE_SET_PROTOTYPE_METHOD(t, "readStart", ReadStart);
     NODE_SET_PROTOTYPE_METHOD(t, "readStop", ReadStop);
     NODE_SET_PROTOTYPE_METHOD(t, "write", Write);
@@ -124,11 +149,15 @@ class TCPWrap {
     object_ = v8::Persistent<v8::Object>::New(object);
     object_->SetPointerInInternalField(0, this);
 
+    accept_batch_ = 0;
+    pending_count_ = 0;
+
     UpdateWriteQueueSize();
   }
 
   ~TCPWrap() {
     assert(object_.IsEmpty());
+    assert(pending_connections_.IsEmpty());
   }
 
   // Free the C++ object on the close callback.
@@ -149,6 +178,13 @@ class TCPWrap {
     String::AsciiValue ip_address(args[0]->ToString());
     int port = args[1]->Int32Value();
 
+    // Optional third argument asks for SO_REUSEPORT so that several
+    // processes can each own a listening socket on the same port.
+    if (args[2]->IsTrue() && uv_tcp_reuseport(&wrap->handle_, 1)) {
+      SetErrno(uv_last_error().code);
+      return scope.Close(Integer::New(-1));
+    }
+
     struct sockaddr_in address = uv_ip4_addr(*ip_address, port);
     int r = uv_tcp_bind(&wrap->handle_, address);
 
@@ -166,6 +202,11 @@ class TCPWrap {
     String::AsciiValue ip6_address(args[0]->ToString());
     int port = args[1]->Int32Value();
 
+    if (args[2]->IsTrue() && uv_tcp_reuseport(&wrap->handle_, 1)) {
+      SetErrno(uv_last_error().code);
+      return scope.Close(Integer::New(-1));
+    }
+
     struct sockaddr_in6 address = uv_ip6_addr(*ip6_address, port);
     int r = uv_tcp_bind6(&wrap->handle_, address);
 
@@ -190,6 +231,82 @@ class TCPWrap {
     return scope.Close(Integer::New(r));
   }
 
+  // server.setAcceptBatch(n)
+  //
+  // Accept up to n connections per readiness event and hand them to
+  // JavaScript as one array through 'onconnections' instead of calling
+  // 'onconnection' once per connection. 0 or 1 restores the default.
+  static Handle<Value> SetAcceptBatch(const Arguments& args) {
+    HandleScope scope;
+
+    UNWRAP
+
+    int batch = args[0]->Int32Value();
+    if (batch == 1) batch = 0;
+
+    int r = uv_tcp_accept_batch(&wrap->handle_, batch);
+
+    if (r) {
+      SetErrno(uv_last_error().code);
+    } else {
+      wrap->accept_batch_ = batch;
+    }
+
+    return scope.Close(Integer::New(r));
+  }
+
+  // Sets an integer socket option, booleans are passed as 0 or 1.
+  static Handle<Value> SetSockOpt(const Arguments& args,
+                                  int level,
+                                  int option) {
+    HandleScope scope;
+
+    UNWRAP
+
+    int value = args[0]->IsBoolean() ? args[0]->IsTrue()
+                                     : args[0]->Int32Value();
+
+    int r = uv_tcp_setsockopt(&wrap->handle_, level, option, value);
+
+    if (r) SetErrno(uv_last_error().code);
+
+    return scope.Close(Integer::New(r));
+  }
+
+  static Handle<Value> SetRecvBufferSize(const Arguments& args) {
+    return SetSockOpt(args, SOL_SOCKET, SO_RCVBUF);
+  }
+
+  static Handle<Value> SetSendBufferSize(const Arguments& args) {
+    return SetSockOpt(args, SOL_SOCKET, SO_SNDBUF);
+  }
+
+#ifdef TCP_CORK
+  static Handle<Value> SetCork(const Arguments& args) {
+    return SetSockOpt(args, IPPROTO_TCP, TCP_CORK);
+  }
+#endif
+
+#ifdef TCP_QUICKACK
+  static Handle<Value> SetQuickAck(const Arguments& args) {
+    return SetSockOpt(args, IPPROTO_TCP, TCP_QUICKACK);
+  }
+#endif
+
+#ifdef TCP_DEFER_ACCEPT
+  // server.setDeferAccept(seconds), call before listen()
+  static Handle<Value> SetDeferAccept(const Arguments& args) {
+    return SetSockOpt(args, IPPROTO_TCP, TCP_DEFER_ACCEPT);
+  }
+#endif
+
+#ifdef TCP_FASTOPEN
+  // server.setFastOpen(queueLength), call before listen()
+  static Handle<Value> SetFastOpen(const Arguments& args) {
+    return SetSockOpt(args, IPPROTO_TCP, TCP_FASTOPEN);
+  }
+#endif
+
   static void OnConnection(uv_handle_t* handle, int status) {
     HandleScope scope;
 
@@ -201,6 +318,12 @@ class TCPWrap {
     // time as calling uv_close() we can test for this here.
     assert(wrap->object_.IsEmpty() == false);
 
+    if (status == 1) {
+      // End of an accept batch.
+      wrap->FlushConnections();
+      return;
+    }
+
     if (status != 0) {
       // TODO Handle server error (call onerror?)
       assert(0);
@@ -225,11 +348,35 @@ class TCPWrap {
     // uv_accept should always work.
     assert(r == 0);
 
+    if (wrap->accept_batch_ > 0) {
+      // Hold on to the client until libuv tells us the batch is complete.
+      if (wrap->pending_connections_.IsEmpty()) {
+        wrap->pending_connections_ = Persistent<Array>::New(Array::New());
+        wrap->pending_count_ = 0;
+      }
+      wrap->pending_connections_->Set(wrap->pending_count_++, client_obj);
+      return;
+    }
+
     // Successful accept. Call the onconnection callback in JavaScript land.
     Local<Value> argv[1] = { client_obj };
     Node::MakeCallback(wrap->object_, "onconnection", 1, argv);
   }
 
+  void FlushConnections() {
+    if (pending_connections_.IsEmpty()) return;
+
+    Context::Scope context(object_->CreationContext());
+    NODE_ASSERT(Context::InContext());
+
+    Local<Array> clients = Local<Array>::New(pending_connections_);
+    pending_connections_.Dispose();
+    pending_connections_.Clear();
+
+    Local<Value> argv[1] = { clients };
+    Node::MakeCallback(object_, "onconnections", 1, argv);
+  }
+
   static Handle<Value> ReadStart(const Arguments& args) {
     HandleScope scope;
 
@@ -365,6 +512,23 @@ class TCPWrap {
 
     if (r) SetErrno(uv_last_error().code);
 
+    // Connections of an unfinished accept batch never made it to
+    // JavaScript, nobody else is going to close them.
+    if (!wrap->pending_connections_.IsEmpty()) {
+      for (uint32_t i = 0; i < wrap->pending_count_; i++) {
+        Local<Object> client_obj =
+            wrap->pending_connections_->Get(i)->ToObject();
+        TCPWrap* client_wrap =
+            static_cast<TCPWrap*>(client_obj->GetPointerFromInternalField(0));
+        uv_close((uv_handle_t*) &client_wrap->handle_, OnClose);
+        client_obj->SetPointerInInternalField(0, NULL);
+        client_wrap->object_.Dispose();
+        client_wrap->object_.Clear();
+      }
+      wrap->pending_connections_.Dispose();
+      wrap->pending_connections_.Clear();
+    }
+
     assert(!wrap->object_.IsEmpty());
     wrap->object_->SetPointerInInternalField(0, NULL);
     wrap->object_.Dispose();
@@ -573,6 +737,9 @@ class TCPWrap {
   uv_tcp_t handle_;
   Persistent<Object> object_;
   size_t slab_offset_;
+  int accept_batch_;
+  Persistent<Array> pending_connections_;
+  uint32_t pending_count_;
   friend class ReqWrap;
 };
 
@@ -492,6 +492,20 @@ var b4 = b.toString('hex', 1);
 assert.equal(b2, b3);
 assert.equal(b2, b4);
 
+// Hex digits of either case, no more than fits, and nothing that is not hex.
+b = new Buffer([0, 0, 0, 0]);
+assert.equal(2, b.write('ABcd', 0, 'hex'));
+assert.equal('abcd0000', b.toString('hex'));
+assert.equal(1, b.slice(3).write('eeff', 0, 'hex'));
+assert.equal('abcd00ee', b.toString('hex'));
+assert.throws(function() {
+  b.write('abc', 0, 'hex');
+});
+assert.throws(function() {
+  b.write('zz', 0, 'hex');
+});
+assert.equal('abcd00ee', b.toString('hex'));
+
 
 // Test slice on SlowBuffer GH-843
 var SlowBuffer = process.binding('buffer').SlowBuffer;
@@ -0,0 +1,95 @@
+var common = require('../common');
+var assert = require('assert');
+
+try {
+  var crypto = require('crypto');
+} catch (e) {
+  console.log('Not compiled with OPENSSL support.');
+  process.exit();
+}
+
+// Cipher and Decipher with callbacks: Buffers in, Buffers out, on the
+// thread pool.
+
+var key = '0123456789abcdef';
+var iv = 'fedcba9876543210';
+var done = 0;
+
+function concat(buffers) {
+  var length = 0;
+  buffers.forEach(function(b) { length += b.length; });
+  var result = new Buffer(length);
+  var pos = 0;
+  buffers.forEach(function(b) {
+    b.copy(result, pos);
+    pos += b.length;
+  });
+  return result;
+}
+
+function roundTrip(algorithm, input) {
+  var sync = crypto.createCipheriv(algorithm, key, iv);
+  var expected = sync.update(input) + sync.final();
+
+  var cipher = crypto.createCipheriv(algorithm, key, iv);
+  var out = [];
+  // In pieces, to go through both the shared slab and big buffers.
+  var pieces = [input.slice(0, 100), input.slice(100, 70000),
+                input.slice(70000)];
+  pieces.forEach(function(piece) {
+    cipher.update(piece, function(err, b) {
+      assert.equal(null, err);
+      assert.ok(Buffer.isBuffer(b));
+      out.push(b);
+    });
+  });
+
+  assert.throws(function() {
+    cipher.update(input);
+  }, /in progress/);
+
+  cipher.final(function(err, b) {
+    assert.equal(null, err);
+    out.push(b);
+    var encrypted = concat(out);
+    assert.equal(expected, encrypted.toString('binary'));
+
+    var decipher = crypto.createDecipheriv(algorithm, key, iv);
+    var plain = [];
+    decipher.update(encrypted, function(err, b) {
+      assert.equal(null, err);
+      plain.push(b);
+    });
+    decipher.final(function(err, b) {
+      assert.equal(null, err);
+      plain.push(b);
+      assert.equal(input.toString('binary'), concat(plain).toString('binary'));
+      done++;
+    });
+  });
+}
+
+var input = new Buffer(100000);
+for (var i = 0; i < input.length; i++) input[i] = (i * 7) & 0xff;
+
+roundTrip('aes-128-cbc', input);
+roundTrip('aes-128-ctr', input);
+
+// Input that is not a whole number of blocks.
+var decipher = crypto.createDecipheriv('aes-128-cbc', key, iv);
+decipher.update(new Buffer(5), function(err, b) {
+  assert.equal(null, err);
+  assert.equal(0, b.length);
+});
+decipher.final(function(err) {
+  assert.ok(err instanceof Error);
+  done++;
+});
+
+assert.throws(function() {
+  crypto.createCipher('aes192', 'key').update('a string', function() {});
+}, TypeError);
+
+process.on('exit', function() {
+  assert.equal(3, done);
+});
@@ -0,0 +1,94 @@
+var common = require('../common');
+var assert = require('assert');
+var path = require('path');
+var fs = require('fs');
+
+try {
+  var crypto = require('crypto');
+} catch (e) {
+  console.log('Not compiled with OPENSSL support.');
+  process.exit();
+}
+
+// update() and digest() with a callback run on the thread pool, in order.
+
+var done = 0;
+
+var hash = crypto.createHash('sha1');
+var order = [];
+hash.update('Test', function(err) {
+  assert.equal(null, err);
+  order.push(1);
+});
+hash.update(new Buffer('123'), function(err) {
+  assert.equal(null, err);
+  order.push(2);
+});
+
+// Nothing synchronous while updates are pending.
+assert.throws(function() {
+  hash.update('more');
+}, /in progress/);
+
+hash.digest('hex', function(err, d) {
+  assert.equal(null, err);
+  assert.deepEqual([1, 2], order);
+  assert.equal('8308651804facb7b9af8ffc53a33a22d6a1c8ac2', d);
+  done++;
+});
+
+crypto.createHmac('sha1', 'Node')
+      .update('some data', function() {})
+      .update('to hmac', function() {})
+      .digest('hex', function(err, d) {
+        assert.equal(null, err);
+        assert.equal('19fd6e1ba73d9ed2224dd5094a71babe85d9a892', d);
+        done++;
+      });
+
+// A large buffer, compared with the synchronous result.
+var big = new Buffer(8 * 1024 * 1024);
+for (var i = 0; i < big.length; i++) big[i] = i & 0xff;
+var expected = crypto.createHash('sha256').update(big).digest('base64');
+crypto.createHash('sha256').update(big, function() {
+}).digest('base64', function(err, d) {
+  assert.equal(expected, d);
+  done++;
+});
+
+// hashFile
+var fn = path.join(common.fixturesDir, 'sample.png');
+crypto.hashFile(fn, 'sha1', 'hex', function(err, d) {
+  assert.equal(null, err);
+  assert.equal('22723e553129a336ad96e10f6aecdf0f45e4149e', d);
+  done++;
+});
+
+crypto.hashFile(fn, 'md5', function(err, d) {
+  assert.equal(null, err);
+  assert.equal(crypto.createHash('md5').update(fs.readFileSync(fn))
+                     .digest('binary'), d);
+  done++;
+});
+
+crypto.hashFile(fn + '.does-not-exist', 'sha1', 'hex', function(err, d) {
+  assert.ok(err instanceof Error);
+  assert.equal('ENOENT', err.code);
+  done++;
+});
+
+assert.throws(function() {
+  crypto.hashFile(fn, 'no-such-digest', function() {});
+}, /Unknown message digest/);
+
+// Unknown output encodings are refused before anything is queued.
+assert.throws(function() {
+  crypto.createHash('sha1').update('x').digest('utf8', function() {});
+}, TypeError);
+assert.throws(function() {
+  crypto.hashFile(fn, 'sha1', 'utf8', function() {});
+}, TypeError);
+
+process.on('exit', function() {
+  assert.equal(6, done);
+});
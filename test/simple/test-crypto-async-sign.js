@@ -0,0 +1,102 @@
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+
+try {
+  var crypto = require('crypto');
+} catch (e) {
+  console.log('Not compiled with OPENSSL support.');
+  process.exit();
+}
+
+// sign(), verify(), createDiffieHellman() and generateKeys() with a
+// callback run on the thread pool.
+
+var rsaPubPem = fs.readFileSync(common.fixturesDir + '/test_rsa_pubkey.pem',
+                                'ascii');
+var rsaKeyPem = fs.readFileSync(common.fixturesDir + '/test_rsa_privkey.pem',
+                                'ascii');
+
+var done = 0;
+
+var expected = crypto.createSign('RSA-SHA1')
+                     .update(rsaPubPem)
+                     .sign(rsaKeyPem, 'hex');
+
+var signer = crypto.createSign('RSA-SHA1');
+signer.update(rsaPubPem);
+signer.sign(rsaKeyPem, 'hex', function(err, signature) {
+  assert.equal(null, err);
+  assert.equal(expected, signature);
+
+  var verifier = crypto.createVerify('RSA-SHA1');
+  verifier.update(rsaPubPem);
+  verifier.verify(rsaPubPem, signature, 'hex', function(err, valid) {
+    assert.equal(null, err);
+    assert.strictEqual(true, valid);
+    done++;
+  });
+  assert.throws(function() {
+    verifier.update('more');
+  }, /asynchronous call/);
+
+  var tampered = crypto.createVerify('RSA-SHA1');
+  tampered.update(rsaPubPem + 'x');
+  tampered.verify(rsaPubPem, signature, 'hex', function(err, valid) {
+    assert.equal(null, err);
+    assert.strictEqual(false, valid);
+    done++;
+  });
+});
+
+// Nothing synchronous while the signature is computed.
+assert.throws(function() {
+  signer.sign(rsaKeyPem);
+}, /asynchronous call/);
+
+assert.throws(function() {
+  crypto.createSign('RSA-SHA1').update('x').sign(rsaKeyPem, 'utf8',
+                                                 function() {});
+}, TypeError);
+
+crypto.createSign('RSA-SHA1').update('x').sign('junk', function(err, sig) {
+  assert.ok(err instanceof Error);
+  done++;
+});
+
+
+crypto.createDiffieHellman(256, function(err, dh1) {
+  assert.equal(null, err);
+  var p1 = dh1.getPrime('base64');
+
+  // The second one of that length comes from the cache.
+  var dh2 = crypto.createDiffieHellman(256);
+  assert.equal(p1, dh2.getPrime('base64'));
+
+  assert.throws(function() {
+    dh2.generateKeys('utf8', function() {});
+  }, TypeError);
+
+  dh1.generateKeys('base64', function(err, key1) {
+    assert.equal(null, err);
+    assert.equal(key1, dh1.getPublicKey('base64'));
+
+    var key2 = dh2.generateKeys();
+    var secret1 = dh1.computeSecret(key2, 'binary', 'base64');
+    var secret2 = dh2.computeSecret(key1, 'base64', 'base64');
+    assert.equal(secret1, secret2);
+    done++;
+  });
+  assert.throws(function() {
+    dh1.getPublicKey();
+  }, /asynchronous call/);
+});
+
+assert.throws(function() {
+  crypto.createDiffieHellman('prime', 'base64', function() {});
+}, TypeError);
+
+
+process.on('exit', function() {
+  assert.equal(4, done);
+});
@@ -0,0 +1,91 @@
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+var tls = require('tls');
+
+try {
+  var crypto = require('crypto');
+} catch (e) {
+  console.log('Not compiled with OPENSSL support.');
+  process.exit();
+}
+
+// Algorithms and engines.
+assert.notEqual(-1, crypto.getCiphers().indexOf('aes-128-cbc'));
+assert.notEqual(-1, crypto.getHashes().indexOf('sha1'));
+crypto.getHashes().forEach(function(name) {
+  assert.equal(name.toLowerCase(), name);
+});
+
+var engines = crypto.getEngines();
+assert.ok(Array.isArray(engines));
+engines.forEach(function(e) {
+  assert.equal('string', typeof e.id);
+  assert.equal('string', typeof e.name);
+});
+assert.throws(function() {
+  crypto.setEngine('no-such-engine');
+});
+
+// What the device offers.
+var caps = crypto.getCapabilities();
+['aes', 'clmul', 'sha1', 'sha256', 'neon'].forEach(function(f) {
+  assert.equal('boolean', typeof caps.cpu[f]);
+});
+assert.ok(caps.throughput['sha1'] > 0);
+assert.ok(caps.throughput['aes-128-cbc'] > 0);
+
+// Measured once per process.
+assert.deepEqual(caps.throughput, crypto.getCapabilities().throughput);
+
+// The default cipher suites follow the CPU.
+if (caps.cpu.aes) {
+  assert.equal(0, crypto.DEFAULT_CIPHERS.indexOf('AES'));
+} else {
+  assert.equal(0, crypto.DEFAULT_CIPHERS.indexOf('RC4'));
+}
+assert.equal(tls.getCiphers(crypto.DEFAULT_CIPHERS).join(),
+             tls.getCiphers().join());
+assert.deepEqual(['AES128-SHA'], tls.getCiphers('AES128-SHA'));
+assert.deepEqual([], tls.getCiphers('NO-SUCH-CIPHER'));
+assert.throws(function() {
+  crypto.createCredentials({ ciphers: 'NO-SUCH-CIPHER' });
+}, /Invalid ciphers/);
+
+
+// A server without ciphers of its own picks the first default suite the
+// client has, one with them keeps to them.
+var options = {
+  key: fs.readFileSync(common.fixturesDir + '/keys/agent2-key.pem'),
+  cert: fs.readFileSync(common.fixturesDir + '/keys/agent2-cert.pem')
+};
+
+var suites = tls.getCiphers();
+var clientCiphers = suites.slice().reverse().join(':');
+var negotiated = [];
+
+function test(serverCiphers, cb) {
+  if (serverCiphers) options.ciphers = serverCiphers;
+
+  var server = tls.createServer(options, function(s) {
+    s.end();
+  });
+
+  server.listen(common.PORT, function() {
+    var client = tls.connect(common.PORT, { ciphers: clientCiphers },
+                             function() {
+      negotiated.push(client.getCipher().name);
+      client.end();
+      server.close();
+      cb();
+    });
+  });
+}
+
+test(null, function() {
+  test('AES256-SHA', function() {});
+});
+
+process.on('exit', function() {
+  assert.deepEqual([suites[0], 'AES256-SHA'], negotiated);
+});
@@ -0,0 +1,61 @@
+var common = require('../common');
+var assert = require('assert');
+
+try {
+  var crypto = require('crypto');
+} catch (e) {
+  console.log('Not compiled with OPENSSL support.');
+  process.exit();
+}
+
+var fs = require('fs');
+
+// Hex and base64 output and input of the crypto classes.
+
+assert.equal('a9993e364706816aba3e25717850c26c9cd0d89d',
+             crypto.createHash('sha1').update('abc').digest('hex'));
+assert.equal('qZk+NkcGgWq6PiVxeFDCbJzQ2J0=',
+             crypto.createHash('sha1').update('abc').digest('base64'));
+assert.equal('5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843',
+             crypto.createHmac('sha256', 'Jefe')
+                   .update('what do ya want for nothing?')
+                   .digest('hex'));
+
+
+// Hex output across updates, base64 input from a Buffer.
+var plaintext = new Array(100).join('Hello node world! ');
+var cipher = crypto.createCipher('aes192', 'key');
+var hex = '';
+for (var i = 0; i < plaintext.length; i += 37) {
+  hex += cipher.update(plaintext.slice(i, i + 37), 'utf8', 'hex');
+}
+hex += cipher.final('hex');
+
+var decipher = crypto.createDecipher('aes192', 'key');
+var b64 = new Buffer(new Buffer(hex, 'hex').toString('base64'));
+var txt = decipher.update(b64, 'base64', 'utf8');
+txt += decipher.final('utf8');
+assert.equal(plaintext, txt);
+
+// Hex input split at odd places, from strings and from Buffers.
+decipher = crypto.createDecipher('aes192', 'key');
+txt = decipher.update(hex.slice(0, 3), 'hex', 'utf8');
+txt += decipher.update(new Buffer(hex.slice(3, 6)), 'hex', 'utf8');
+txt += decipher.update(hex.slice(6), 'hex', 'utf8');
+txt += decipher.final('utf8');
+assert.equal(plaintext, txt);
+
+
+// Signatures in hex and base64.
+var keyPem = fs.readFileSync(common.fixturesDir + '/test_rsa_privkey.pem',
+                             'ascii');
+var pubPem = fs.readFileSync(common.fixturesDir + '/test_rsa_pubkey.pem',
+                             'ascii');
+
+['hex', 'base64'].forEach(function(enc) {
+  var sig = crypto.createSign('RSA-SHA256').update('data').sign(keyPem, enc);
+  assert.ok(crypto.createVerify('RSA-SHA256').update('data')
+                  .verify(pubPem, sig, enc));
+  assert.ok(!crypto.createVerify('RSA-SHA256').update('other')
+                   .verify(pubPem, sig, enc));
+});
@@ -0,0 +1,81 @@
+var common = require('../common');
+var assert = require('assert');
+
+try {
+  var crypto = require('crypto');
+} catch (e) {
+  console.log('Not compiled with OPENSSL support.');
+  process.exit();
+}
+
+// randomBytes() with and without a callback, and pbkdf2() against the
+// RFC 6070 vectors.
+
+var done = 0;
+
+[0, 1, 16, 1024, 64 * 1024].forEach(function(size) {
+  var buf = crypto.randomBytes(size);
+  assert.ok(Buffer.isBuffer(buf));
+  assert.equal(size, buf.length);
+  // Nothing else lives in the same parent.
+  assert.equal(size, buf.parent.length);
+
+  crypto.randomBytes(size, function(err, buf) {
+    assert.equal(null, err);
+    assert.ok(Buffer.isBuffer(buf));
+    assert.equal(size, buf.length);
+    assert.equal(size, buf.parent.length);
+    done++;
+  });
+});
+
+// Two results don't share bytes.
+var a = crypto.randomBytes(32).toString('hex');
+var b = crypto.randomBytes(32).toString('hex');
+assert.notEqual(a, b);
+
+assert.throws(function() {
+  crypto.randomBytes(-1);
+}, TypeError);
+assert.throws(function() {
+  crypto.randomBytes('10');
+}, TypeError);
+assert.throws(function() {
+  crypto.randomBytes(10, 'not a function');
+}, TypeError);
+
+
+function hex(s) {
+  return new Buffer(s, 'binary').toString('hex');
+}
+
+crypto.pbkdf2('password', 'salt', 1, 20, function(err, key) {
+  assert.equal(null, err);
+  assert.equal('0c60c80f961f0e71f3a9b524af6012062fe037a6', hex(key));
+  done++;
+});
+
+crypto.pbkdf2(new Buffer('password'), new Buffer('salt'), 2, 20,
+              function(err, key) {
+  assert.equal(null, err);
+  assert.equal('ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957', hex(key));
+  done++;
+});
+
+crypto.pbkdf2('password', 'salt', 4096, 20, function(err, key) {
+  assert.equal(null, err);
+  assert.equal('4b007901b765489abead49d926f721d065a429c1', hex(key));
+  done++;
+});
+
+assert.throws(function() {
+  crypto.pbkdf2('password', 'salt', 0, 20, function() {});
+}, TypeError);
+assert.throws(function() {
+  crypto.pbkdf2('password', 'salt', 1, 20);
+}, TypeError);
+
+
+process.on('exit', function() {
+  assert.equal(8, done);
+});
@@ -0,0 +1,57 @@
+var common = require('../common');
+var assert = require('assert');
+var dgram = require('dgram');
+
+var N = 50;
+var received = {};
+var receivedCount = 0;
+var sentCount = 0;
+
+var server = dgram.createSocket('udp4');
+server.setRecvBatch(16);
+
+server.on('message', function(msg, rinfo) {
+  assert.strictEqual(rinfo.address, '127.0.0.1');
+  assert.strictEqual(rinfo.size, msg.length);
+  var s = msg.toString();
+  assert.ok(/^message \d+$/.test(s));
+  assert.ok(!received[s]);
+  received[s] = true;
+
+  if (++receivedCount == N) {
+    server.close();
+    client.close();
+    clearTimeout(timer);
+  }
+});
+
+var client = dgram.createSocket('udp4');
+
+server.on('listening', function() {
+  var messages = [];
+  for (var i = 0; i < N; i++) {
+    var buf = new Buffer('message ' + i);
+    messages.push({ buffer: buf, offset: 0, length: buf.length,
+                    port: common.PORT, address: '127.0.0.1' });
+  }
+
+  client.sendBatch(messages, function(err, sent) {
+    assert.ifError(err);
+    sentCount = sent;
+  });
+});
+
+server.bind(common.PORT, '127.0.0.1');
+
+assert.throws(function() {
+  server.setRecvBatch(0);
+});
+
+var timer = setTimeout(function() {
+  throw new Error('Timeout');
+}, 1000);
+
+process.on('exit', function() {
+  assert.equal(N, sentCount);
+  assert.equal(N, receivedCount);
+});
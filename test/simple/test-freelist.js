@@ -0,0 +1,38 @@
+var common = require('../common');
+var assert = require('assert');
+var FreeList = require('freelist').FreeList;
+
+// The free list is a stack with a fixed size, backed by a native pool that
+// counts hits and misses.
+
+var created = 0;
+var list = new FreeList('test', 2, function() {
+  return { id: created++ };
+});
+
+var a = list.alloc();
+var b = list.alloc();
+var c = list.alloc();
+assert.equal(3, created);
+
+assert.equal(true, list.free(a));
+assert.equal(true, list.free(b));
+assert.equal(false, list.free(c));
+
+// Last in, first out.
+assert.strictEqual(b, list.alloc());
+assert.strictEqual(a, list.alloc());
+assert.equal(0, list.alloc().id - 3);
+
+assert.deepEqual({ length: 0, max: 2, hits: 2, misses: 4 }, list.stats());
+
+// Anything can be freed, as with the old Array based list.
+assert.equal(true, list.free(42));
+assert.equal(42, list.alloc());
+
+// The http parsers live in one too.
+var parsers = require('http').parsers;
+assert.equal(1000, parsers.stats().max);
+var parser = parsers.alloc();
+parsers.free(parser);
+assert.strictEqual(parser, parsers.alloc());
@@ -0,0 +1,102 @@
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+var net = require('net');
+var http = require('http');
+var path = require('path');
+
+var file = path.join(common.fixturesDir, 'person.jpg');
+var expected = fs.readFileSync(file);
+
+var netStream, httpStream;
+var netReceived = [], httpReceived = [];
+var gotRange = false;
+
+function concat(bufs) {
+  var length = 0;
+  bufs.forEach(function(b) { length += b.length; });
+  var r = new Buffer(length), offset = 0;
+  bufs.forEach(function(b) { b.copy(r, offset); offset += b.length; });
+  return r;
+}
+
+// fs.ReadStream -> net.Socket. The second time something else listens for
+// 'data' as well, and gets all of it.
+var counterStream, counted = 0, counterReceived = [];
+
+var server = net.createServer(function(socket) {
+  var s = fs.createReadStream(file);
+  if (!netStream) {
+    netStream = s;
+  } else {
+    counterStream = s;
+    s.on('data', function(d) {
+      counted += d.length;
+    });
+  }
+  s.pipe(socket);
+});
+
+function get(received, cb) {
+  var c = net.createConnection(common.PORT);
+  c.on('data', function(d) {
+    received.push(d);
+  });
+  c.on('end', cb);
+}
+
+server.listen(common.PORT, function() {
+  get(netReceived, function() {
+    get(counterReceived, function() {
+      server.close();
+    });
+  });
+});
+
+// fs.ReadStream -> http.ServerResponse, with a byte range
+var httpServer = http.createServer(function(req, res) {
+  var range = req.url == '/range';
+  var options = range ? { start: 10, end: 109 } : {};
+  var s = fs.createReadStream(file, options);
+  if (!range) httpStream = s;
+  res.writeHead(200, { 'Content-Length': range ? 100 : expected.length });
+  s.pipe(res);
+});
+
+httpServer.listen(common.PORT + 1, function() {
+  http.get({ port: common.PORT + 1, path: '/' }, function(res) {
+    res.on('data', function(d) {
+      httpReceived.push(d);
+    });
+    res.on('end', function() {
+      http.get({ port: common.PORT + 1, path: '/range' }, function(res) {
+        var bufs = [];
+        res.on('data', function(d) {
+          bufs.push(d);
+        });
+        res.on('end', function() {
+          var got = concat(bufs);
+          assert.equal(100, got.length);
+          assert.equal(expected.slice(10, 110).toString('base64'),
+                       got.toString('base64'));
+          gotRange = true;
+          httpServer.close();
+        });
+      });
+    });
+  });
+});
+
+process.on('exit', function() {
+  assert.ok(netStream._sendfileSocket);
+  assert.ok(!counterStream._sendfileSocket);
+  assert.equal(expected.length, counted);
+  assert.equal(expected.toString('base64'),
+               concat(counterReceived).toString('base64'));
+  assert.ok(httpStream._sendfileSocket);
+  assert.equal(expected.toString('base64'),
+               concat(netReceived).toString('base64'));
+  assert.equal(expected.toString('base64'),
+               concat(httpReceived).toString('base64'));
+  assert.ok(gotRange);
+});
@@ -0,0 +1,71 @@
+var common = require('../common');
+var assert = require('assert');
+var http = require('http');
+
+// Keep-alive sockets are kept by the agent, reused, and evicted when the
+// agent has too many of them or they have been idle for too long.
+
+var server = http.createServer(function(req, res) {
+  res.writeHead(200, { 'Content-Length': 2 });
+  res.end('ok');
+});
+
+var agent = new http.Agent({ host: '127.0.0.1', port: common.PORT });
+agent.maxSockets = 2;
+agent.maxIdleSockets = 1;
+agent.idleTimeout = 1000;
+
+function get(cb) {
+  var req = http.get({
+    agent: agent,
+    host: '127.0.0.1',
+    port: common.PORT,
+    path: '/',
+    headers: { 'Connection': 'keep-alive' }
+  }, function(res) {
+    res.on('end', cb);
+  });
+}
+
+server.listen(common.PORT, function() {
+  // One after the other: a single socket.
+  get(function() {
+    assert.equal(1, agent.idleSockets.length);
+    get(function() {
+      get(function() {
+        assert.deepEqual({ created: 1, reused: 2, evicted: 0 }, agent.stats);
+        concurrent();
+      });
+    });
+  });
+});
+
+function concurrent() {
+  // Two at a time: a second socket is opened, and only one of the two can
+  // stay idle.
+  var n = 0;
+  function done() {
+    if (++n < 2) return;
+    process.nextTick(function() {
+      assert.equal(1, agent.idleSockets.length);
+      assert.equal(1, agent.stats.evicted);
+      assert.equal(2, agent.stats.created);
+      expire();
+    });
+  }
+  get(done);
+  get(done);
+}
+
+function expire() {
+  setTimeout(function() {
+    assert.equal(0, agent.idleSockets.length);
+    assert.equal(0, agent.sockets.length);
+    assert.equal(2, agent.stats.evicted);
+    server.close();
+  }, 2500);
+}
+
+process.on('exit', function() {
+  assert.equal(2, agent.stats.evicted);
+});
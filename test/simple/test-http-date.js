@@ -0,0 +1,56 @@
+var common = require('../common');
+var assert = require('assert');
+var http = require('http');
+
+// response.sendDate adds a Date header unless there is one already.
+
+var dates = [];
+
+var server = http.createServer(function(req, res) {
+  if (req.url == '/none') {
+    // default
+  } else if (req.url == '/own') {
+    res.sendDate = true;
+    res.setHeader('Date', 'Thu, 01 Jan 1970 00:00:00 GMT');
+  } else {
+    res.sendDate = true;
+  }
+  res.end('ok');
+});
+
+function get(path, cb) {
+  http.get({ port: common.PORT, path: path }, function(res) {
+    res.on('end', function() {
+      cb(res.headers);
+    });
+  });
+}
+
+server.listen(common.PORT, function() {
+  var before = Date.now();
+
+  get('/date', function(headers) {
+    var date = headers['date'];
+    assert.ok(/^\w{3}, \d{2} \w{3} \d{4} \d{2}:\d{2}:\d{2} GMT$/.test(date));
+    var t = new Date(date).getTime();
+    // Seconds resolution, and the cache may lag by up to a second.
+    assert.ok(t >= before - 2000);
+    assert.ok(t <= Date.now());
+    dates.push(date);
+
+    get('/own', function(headers) {
+      assert.equal('Thu, 01 Jan 1970 00:00:00 GMT', headers['date']);
+      dates.push(headers['date']);
+
+      get('/none', function(headers) {
+        assert.equal(undefined, headers['date']);
+        dates.push(null);
+        server.close();
+      });
+    });
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(3, dates.length);
+});
@@ -0,0 +1,48 @@
+var common = require('../common');
+var assert = require('assert');
+
+// Callbacks are bound when they are assigned. Assigning something that is
+// not a function unbinds them.
+
+var HTTPParser = process.binding('http_parser').HTTPParser;
+
+var request = new Buffer('POST /path?query#fragment HTTP/1.1\r\n' +
+                         'Content-Length: 4\r\n\r\nbody', 'ascii');
+
+var parser = new HTTPParser('request');
+var events = [];
+
+function onBody(b, start, len) {
+  events.push('body:' + b.toString('ascii', start, start + len));
+}
+
+parser.onMessageBegin = function() { events.push('begin'); };
+parser.onQueryString = function() { events.push('query'); };
+parser.onFragment = function() { events.push('fragment'); };
+parser.onBody = onBody;
+parser.onMessageComplete = function() { events.push('complete'); };
+
+assert.strictEqual(onBody, parser.onBody);
+assert.strictEqual(undefined, parser.onPath);
+
+parser.execute(request, 0, request.length);
+assert.deepEqual(['begin', 'query', 'fragment', 'body:body', 'complete'],
+                 events);
+
+// Unbind some of them.
+events = [];
+parser.onQueryString = null;
+parser.onFragment = undefined;
+parser.onBody = 'not a function';
+assert.strictEqual(null, parser.onQueryString);
+
+parser.reinitialize('request');
+parser.execute(request, 0, request.length);
+assert.deepEqual(['begin', 'complete'], events);
+
+// And bind them again.
+events = [];
+parser.onBody = onBody;
+parser.reinitialize('request');
+parser.execute(request, 0, request.length);
+assert.deepEqual(['begin', 'body:body', 'complete'], events);
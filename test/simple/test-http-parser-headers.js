@@ -0,0 +1,113 @@
+var common = require('../common');
+var assert = require('assert');
+
+// Header fields and values are collected by the binding and handed to
+// onHeadersComplete in one array, or in chunks through onHeaders. Field
+// names come out lowercase.
+
+var HTTPParser = process.binding('http_parser').HTTPParser;
+
+
+function execute(parser, chunks) {
+  chunks.forEach(function(chunk) {
+    var b = new Buffer(chunk, 'ascii');
+    var r = parser.execute(b, 0, b.length);
+    assert.equal(b.length, r);
+    // Make sure the binding copied what it still needs.
+    b.fill(0);
+  });
+}
+
+
+// Fast case, with fragments split across execute() calls.
+(function() {
+  var parser = new HTTPParser('request');
+  var completed = false;
+
+  parser.onHeaders = function() {
+    assert.ok(false, 'onHeaders should not be called');
+  };
+
+  parser.onHeadersComplete = function(info) {
+    assert.equal('GET', info.method);
+    assert.equal('/hello?world', info.url);
+    assert.deepEqual(['host', 'example.com',
+                      'x-split-header', 'split value',
+                      'content-length', '0',
+                      'x-mixed-case', 'Value'], info.headers);
+    completed = true;
+  };
+
+  execute(parser, ['GET /hel',
+                   'lo?world HTTP/1.1\r\nHost: example.com\r\nX-Spl',
+                   'it-Header: split ',
+                   'value\r\nCONTENT-length: 0\r\n',
+                   'X-MiXed-Case: Value\r\n\r\n']);
+
+  assert.ok(completed);
+})();
+
+
+// Lots of headers are flushed in chunks.
+(function() {
+  var parser = new HTTPParser('request');
+  var N = 100;
+  var headers = [];
+  var url = '';
+  var completed = false;
+
+  parser.onHeaders = function(h, u) {
+    headers = headers.concat(h);
+    url += u;
+  };
+
+  parser.onHeadersComplete = function(info) {
+    assert.equal(undefined, info.headers);
+    assert.equal(undefined, info.url);
+    completed = true;
+  };
+
+  var request = 'POST /many HTTP/1.1\r\n';
+  for (var i = 0; i < N; i++) {
+    request += 'X-Header-' + i + ': ' + i + '\r\n';
+  }
+  request += '\r\n';
+
+  execute(parser, [request]);
+
+  assert.ok(completed);
+  assert.equal('/many', url);
+  assert.equal(2 * N, headers.length);
+  for (var i = 0; i < N; i++) {
+    assert.equal('x-header-' + i, headers[2 * i]);
+    assert.equal(String(i), headers[2 * i + 1]);
+  }
+})();
+
+
+// Trailers show up through onHeaders before onMessageComplete.
+(function() {
+  var parser = new HTTPParser('response');
+  var trailers = null;
+  var completed = false;
+
+  parser.onHeadersComplete = function(info) {
+    assert.equal(200, info.statusCode);
+    assert.deepEqual(['transfer-encoding', 'chunked'], info.headers);
+  };
+
+  parser.onHeaders = function(headers, url) {
+    assert.equal('', url);
+    trailers = headers;
+  };
+
+  parser.onMessageComplete = function() {
+    assert.deepEqual(['x-trailer', 'done'], trailers);
+    completed = true;
+  };
+
+  execute(parser, ['HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n',
+                   '3\r\nabc\r\n0\r\nX-Trailer: done\r\n\r\n']);
+
+  assert.ok(completed);
+})();
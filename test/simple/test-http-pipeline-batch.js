@@ -0,0 +1,93 @@
+var common = require('../common');
+var assert = require('assert');
+var http = require('http');
+var net = require('net');
+
+// Pipelined requests: the parser hands over their heads in one batch and
+// the responses that are ready right away are written together.
+
+var HTTPParser = process.binding('http_parser').HTTPParser;
+
+(function() {
+  var parser = new HTTPParser('request');
+  var events = [];
+
+  parser.onMessageBegin = function() {
+    assert.ok(false, 'onMessageBegin should not be called');
+  };
+  parser.onHeadersComplete = function(info) {
+    assert.ok(false, 'onHeadersComplete should not be called');
+  };
+  parser.onHeadersBatch = function(batch) {
+    events.push(batch.map(function(info) {
+      return info.method + ' ' + info.url + (info.complete ? ' done' : '');
+    }).join(', '));
+  };
+  parser.onBody = function(b, start, len) {
+    events.push('body ' + b.toString('ascii', start, start + len));
+  };
+  parser.onMessageComplete = function() {
+    events.push('complete');
+  };
+
+  var b = new Buffer('GET /a HTTP/1.1\r\n\r\n' +
+                     'GET /b HTTP/1.1\r\n\r\n' +
+                     'POST /c HTTP/1.1\r\nContent-Length: 4\r\n\r\nbody' +
+                     'GET /d HTTP/1.1\r\n\r\n');
+  assert.equal(b.length, parser.execute(b, 0, b.length));
+
+  assert.deepEqual(['GET /a done, GET /b done, POST /c',
+                    'body body',
+                    'complete',
+                    'GET /d done'], events);
+})();
+
+
+var N = 10;
+var requests = 0;
+var chunks = [];
+
+var server = http.createServer(function(req, res) {
+  assert.equal('/' + requests, req.url);
+  requests++;
+  res.writeHead(200, { 'Content-Length': req.url.length });
+  res.end(req.url);
+});
+
+server.listen(common.PORT, function() {
+  var c = net.createConnection(common.PORT);
+  var request = '';
+  for (var i = 0; i < N; i++) {
+    request += 'GET /' + i + ' HTTP/1.1\r\n' +
+               (i == N - 1 ? 'Connection: close\r\n' : '') +
+               '\r\n';
+  }
+
+  c.on('connect', function() {
+    c.write(request);
+  });
+  c.on('data', function(d) {
+    chunks.push(d.toString());
+  });
+  c.on('end', function() {
+    c.end();
+    server.close();
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(N, requests);
+  // Every response, complete and in order.
+  var data = chunks.join('');
+  var re = /HTTP\/1\.1 200 OK\r\n[\s\S]*?\r\n\r\n(\/\d+)/g;
+  var bodies = [];
+  var m;
+  while (m = re.exec(data)) bodies.push(m[1]);
+  var expected = [];
+  for (var i = 0; i < N; i++) expected.push('/' + i);
+  assert.deepEqual(expected, bodies);
+
+  // How many reads it takes depends on timing; batching must not make it
+  // more than one per response.
+  assert.ok(chunks.length <= N);
+});
@@ -0,0 +1,102 @@
+var common = require('../common');
+var assert = require('assert');
+var http = require('http');
+
+// The header block of outgoing messages is written by the http_parser
+// binding straight into a Buffer.
+
+var binding = process.binding('http_parser');
+var serializeHeader = binding.serializeHeader;
+var FLAG_BITS = binding.HEADER_FLAG_BITS;
+
+function serialize(headers, flags) {
+  var b = new Buffer(1024);
+  var r = serializeHeader(b, 0, 'HTTP/1.1 200 OK\r\n', headers, flags);
+  assert.ok(r >= 0);
+  return {
+    header: b.toString('utf8', 0, r >> FLAG_BITS),
+    flags: r & ((1 << FLAG_BITS) - 1)
+  };
+}
+
+// Object form, with a multi-valued header.
+var r = serialize({ 'Content-Length': 5, 'Set-Cookie': ['a=1', 'b=2'] },
+                  binding.HEADER_SHOULD_KEEP_ALIVE | binding.HEADER_HAS_BODY);
+assert.equal('HTTP/1.1 200 OK\r\n' +
+             'Content-Length: 5\r\n' +
+             'Set-Cookie: a=1\r\n' +
+             'Set-Cookie: b=2\r\n' +
+             'Connection: keep-alive\r\n' +
+             '\r\n', r.header);
+assert.equal(0, r.flags);
+
+// Array form. Connection: close ends the connection, the default is
+// chunked encoding.
+r = serialize([['connection', 'Close'], ['X-Foo', 'bar']],
+              binding.HEADER_CHUNKED_BY_DEFAULT | binding.HEADER_HAS_BODY);
+assert.equal('HTTP/1.1 200 OK\r\n' +
+             'connection: Close\r\n' +
+             'X-Foo: bar\r\n' +
+             'Transfer-Encoding: chunked\r\n' +
+             '\r\n', r.header);
+assert.equal(binding.HEADER_LAST | binding.HEADER_CHUNKED, r.flags);
+
+r = serialize({ 'Transfer-Encoding': 'chunked', 'Expect': '100-continue' },
+              binding.HEADER_SHOULD_KEEP_ALIVE | binding.HEADER_HAS_BODY);
+assert.equal(binding.HEADER_LAST | binding.HEADER_CHUNKED |
+             binding.HEADER_EXPECT, r.flags);
+assert.ok(/Connection: close\r\n/.test(r.header));
+
+// Does not fit.
+assert.equal(-1, serializeHeader(new Buffer(10), 0, 'HTTP/1.1 200 OK\r\n',
+                                 {}, 0));
+
+// Header splitting.
+assert.throws(function() {
+  serialize({ 'X-Foo': 'bar\r\nX-Injected: yes' }, 0);
+}, TypeError);
+assert.throws(function() {
+  serialize({ 'X-Foo\r\n': 'bar' }, 0);
+}, TypeError);
+
+
+// End to end, with a header that is bigger than the header pool.
+var big = new Array(64 * 1024).join('x');
+var responses = 0;
+
+var server = http.createServer(function(req, res) {
+  if (req.url == '/big') {
+    res.writeHead(200, { 'X-Big': big, 'Content-Length': 2 });
+  } else {
+    res.writeHead(200, { 'Content-Type': 'text/plain' });
+  }
+  res.end('ok');
+});
+
+server.listen(common.PORT, function() {
+  http.get({ port: common.PORT, path: '/big' }, function(res) {
+    assert.equal(big, res.headers['x-big']);
+    res.on('data', function(d) {
+      assert.equal('ok', d.toString());
+    });
+    res.on('end', function() {
+      responses++;
+      http.get({ port: common.PORT, path: '/' }, function(res) {
+        assert.equal('chunked', res.headers['transfer-encoding']);
+        assert.equal('text/plain', res.headers['content-type']);
+        var body = '';
+        res.setEncoding('utf8');
+        res.on('data', function(d) { body += d; });
+        res.on('end', function() {
+          assert.equal('ok', body);
+          responses++;
+          server.close();
+        });
+      });
+    });
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(2, responses);
+});
@@ -0,0 +1,43 @@
+var common = require('../common');
+var assert = require('assert');
+var dgram = require('dgram');
+
+var binding = process.binding('net');
+var SocketAddress = binding.SocketAddress;
+
+assert.throws(function() {
+  new SocketAddress(common.PORT, 'not an ip');
+});
+
+assert.throws(function() {
+  SocketAddress(common.PORT, '127.0.0.1');
+});
+
+var a = new SocketAddress(common.PORT, '127.0.0.1');
+var N = 5;
+var received = 0;
+
+var server = dgram.createSocket('udp4', function(msg, rinfo) {
+  assert.equal('ping', msg.toString());
+  if (++received == N) {
+    server.close();
+    client.close();
+  }
+});
+
+var client = dgram.createSocket('udp4');
+
+server.on('listening', function() {
+  var buf = new Buffer('ping');
+  // The same parsed address, used over and over.
+  for (var i = 0; i < N; i++) {
+    var bytes = binding.sendto(client.fd, buf, 0, buf.length, 0, a);
+    assert.equal(buf.length, bytes);
+  }
+});
+
+server.bind(common.PORT, '127.0.0.1');
+
+process.on('exit', function() {
+  assert.equal(N, received);
+});
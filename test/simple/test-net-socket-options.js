@@ -0,0 +1,47 @@
+var common = require('../common');
+var assert = require('assert');
+var net = require('net');
+
+var received = '';
+var connected = false;
+
+var server = net.createServer({ deferAccept: 1, fastOpen: 5 }, function(s) {
+  s.setRecvBufferSize(64 * 1024);
+  s.setSendBufferSize(64 * 1024);
+  s.setQuickAck(true);
+
+  s.setEncoding('utf8');
+  s.on('data', function(d) {
+    received += d;
+  });
+  s.on('end', function() {
+    s.end();
+    server.close();
+  });
+});
+
+server.listen(common.PORT, function() {
+  var c = net.createConnection(common.PORT);
+
+  c.on('connect', function() {
+    connected = true;
+
+    // cork() nests, only the outermost uncork() releases the data.
+    c.cork();
+    c.cork();
+    c.write('hello ');
+    c.uncork();
+    c.write('world');
+    c.uncork();
+
+    // Unbalanced uncork() is harmless.
+    c.uncork();
+
+    c.end();
+  });
+});
+
+process.on('exit', function() {
+  assert.ok(connected);
+  assert.equal('hello world', received);
+});
@@ -0,0 +1,53 @@
+var common = require('../common');
+var assert = require('assert');
+var net = require('net');
+
+// Batched writes go out before anything written around the batch, and
+// their callbacks hear about it when the socket goes away first.
+
+var big = new Buffer(128 * 1024);
+for (var i = 0; i < big.length; i++) big[i] = 'b'.charCodeAt(0);
+
+var errors = [];
+var received = '';
+
+var connections = 0;
+
+var server = net.createServer(function(socket) {
+  if (connections++ == 0) {
+    socket._batchWrites();
+    socket.write('a');
+    socket.write('a');
+    // Too big for the batch, it follows the two small writes.
+    socket.write(big);
+    socket._flushBatch();
+    socket.end();
+    return;
+  }
+
+  socket._batchWrites();
+  socket.write('c', function(err) {
+    errors.push(err);
+  });
+  socket.destroy();
+  assert.equal(null, socket._batch);
+  server.close();
+});
+
+server.listen(common.PORT, function() {
+  var c = net.createConnection(common.PORT);
+  c.setEncoding('ascii');
+  c.on('data', function(d) {
+    received += d;
+  });
+  c.on('end', function() {
+    var c2 = net.createConnection(common.PORT);
+    c2.on('error', function() {});
+  });
+});
+
+process.on('exit', function() {
+  assert.equal('aa' + big.toString('ascii'), received);
+  assert.equal(1, errors.length);
+  assert.ok(errors[0] instanceof Error);
+});
@@ -0,0 +1,79 @@
+var common = require('../common');
+var assert = require('assert');
+
+var TCP = process.binding('tcp_wrap').TCP;
+
+
+// With reusePort two handles can listen on one port. Without it the second
+// one fails, when it listens since the bind error is delayed until then.
+(function() {
+  var port = common.PORT + 1;
+  var a = new TCP();
+  if (a.bind('0.0.0.0', port, true) != 0) {
+    console.log('SO_REUSEPORT not supported: ' + errno);
+    a.close();
+    return;
+  }
+  assert.equal(0, a.listen(128));
+
+  var b = new TCP();
+  assert.equal(0, b.bind('0.0.0.0', port, true));
+  assert.equal(0, b.listen(128));
+
+  var c = new TCP();
+  var r = c.bind('0.0.0.0', port);
+  if (r == 0) r = c.listen(128);
+  assert.equal(-1, r);
+  assert.equal('EADDRINUSE', errno);
+
+  a.close();
+  b.close();
+  c.close();
+})();
+
+
+var N = 10;
+
+var server = new TCP();
+
+var r = server.bind("0.0.0.0", common.PORT);
+assert.equal(0, r);
+
+r = server.setAcceptBatch(4);
+assert.equal(0, r);
+
+server.listen(128);
+
+var accepted = 0, batches = 0;
+
+server.onconnection = function(client) {
+  assert.ok(false, "onconnection should not be called in batch mode");
+};
+
+server.onconnections = function(clients) {
+  assert.ok(Array.isArray(clients));
+  assert.ok(clients.length > 0);
+  assert.ok(clients.length <= 4);
+  console.log("got batch of " + clients.length);
+
+  batches++;
+  for (var i = 0; i < clients.length; i++) {
+    assert.equal(0, clients[i].writeQueueSize);
+    clients[i].close();
+    accepted++;
+  }
+
+  if (accepted == N) server.close();
+};
+
+var net = require('net');
+
+for (var i = 0; i < N; i++) {
+  var c = net.createConnection(common.PORT);
+  c.on('error', function() { });
+}
+
+process.on('exit', function() {
+  assert.equal(N, accepted);
+  assert.ok(batches >= Math.ceil(N / 4));
+});
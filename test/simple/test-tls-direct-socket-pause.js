@@ -0,0 +1,56 @@
+var common = require('../common');
+var assert = require('assert');
+var tls = require('tls');
+var fs = require('fs');
+
+// A paused directSocket gets no 'data', not even from a record that was
+// decrypted before the pause, and resume() delivers that first.
+
+var options = {
+  key: fs.readFileSync(common.fixturesDir + '/keys/agent2-key.pem'),
+  cert: fs.readFileSync(common.fixturesDir + '/keys/agent2-cert.pem'),
+  directSocket: true
+};
+
+var big = new Buffer(256 * 1024);
+for (var i = 0; i < big.length; i++) big[i] = i % 251;
+
+var server = tls.createServer(options, function(s) {
+  s.end(big);
+});
+
+var received = 0;
+var pauses = 0;
+
+server.listen(common.PORT, function() {
+  var c = tls.connect(common.PORT, { directSocket: true });
+  var paused = false;
+
+  c.on('data', function(d) {
+    assert.ok(!paused, 'data while paused');
+    for (var i = 0; i < d.length; i++) {
+      if (d[i] != big[received + i]) {
+        assert.fail(d[i], big[received + i], 'at ' + (received + i));
+      }
+    }
+    received += d.length;
+
+    paused = true;
+    pauses++;
+    c.pause();
+    setTimeout(function() {
+      paused = false;
+      c.resume();
+    }, 1);
+  });
+
+  c.on('end', function() {
+    c.end();
+    server.close();
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(big.length, received);
+  assert.ok(pauses > 1);
+});
@@ -0,0 +1,72 @@
+var common = require('../common');
+var assert = require('assert');
+var tls = require('tls');
+var fs = require('fs');
+var net = require('net');
+
+// With directSocket the SSL connection is bound to the net.Stream, which
+// sends and receives the cleartext. Big writes go out in parts.
+
+var options = {
+  key: fs.readFileSync(common.fixturesDir + '/keys/agent2-key.pem'),
+  cert: fs.readFileSync(common.fixturesDir + '/keys/agent2-cert.pem'),
+  directSocket: true
+};
+
+var big = new Buffer(1024 * 1024);
+for (var i = 0; i < big.length; i++) big[i] = i % 251;
+
+var serverReceived = 0;
+var clientReceived = 0;
+var clients = 0;
+
+var server = tls.createServer(options, function(s) {
+  assert.ok(s instanceof net.Stream);
+  assert.ok(s.getCipher());
+  s.on('data', function(d) {
+    serverReceived += d.length;
+    if (serverReceived == big.length) s.end(big);
+  });
+});
+
+function connect(directSocket, cb) {
+  var received = [];
+  var c = tls.connect(common.PORT, { directSocket: directSocket }, function() {
+    assert.equal(directSocket, c instanceof net.Stream);
+    c.write(big);
+  });
+  c.on('data', function(d) {
+    clientReceived += d.length;
+    received.push(d);
+  });
+  c.on('end', function() {
+    var data = new Buffer(big.length);
+    var offset = 0;
+    received.forEach(function(d) {
+      d.copy(data, offset, 0, d.length);
+      offset += d.length;
+    });
+    assert.equal(big.length, offset);
+    for (var i = 0; i < big.length; i++) {
+      if (data[i] != big[i]) assert.fail(data[i], big[i], 'at ' + i);
+    }
+    clients++;
+    c.end();
+  });
+  c.on('close', cb);
+}
+
+server.listen(common.PORT, function() {
+  connect(true, function() {
+    serverReceived = 0;
+    // Against a SecurePair on the other side.
+    connect(false, function() {
+      server.close();
+    });
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(2, clients);
+  assert.equal(2 * big.length, clientReceived);
+});
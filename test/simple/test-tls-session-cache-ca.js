@@ -0,0 +1,46 @@
+var common = require('../common');
+var assert = require('assert');
+var tls = require('tls');
+var fs = require('fs');
+
+// A connection pinned to its own ca does not resume a session that was
+// made with the default roots.
+
+var cert = fs.readFileSync(common.fixturesDir + '/keys/agent2-cert.pem');
+var options = {
+  key: fs.readFileSync(common.fixturesDir + '/keys/agent2-key.pem'),
+  cert: cert
+};
+
+var reused = [];
+var authorized = [];
+
+var server = tls.createServer(options, function(s) {
+  s.end('ok');
+});
+
+function connect(options, cb) {
+  var c = tls.connect(common.PORT, '127.0.0.1', options, function() {
+    reused.push(c.isSessionReused());
+    authorized.push(c.authorized);
+  });
+  c.on('data', function() {});
+  c.on('close', cb);
+}
+
+server.listen(common.PORT, function() {
+  connect({}, function() {
+    connect({ ca: [cert] }, function() {
+      connect({ ca: [cert] }, function() {
+        server.close();
+      });
+    });
+  });
+});
+
+process.on('exit', function() {
+  // agent2 is self-signed: only the pinned connections trust it.
+  assert.deepEqual([false, false, true], reused);
+  assert.deepEqual([false, true, true], authorized);
+  assert.equal(2, tls.clientSessions.keys.length);
+});
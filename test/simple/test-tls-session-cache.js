@@ -0,0 +1,70 @@
+var common = require('../common');
+var assert = require('assert');
+var tls = require('tls');
+var fs = require('fs');
+
+// Clients resume their sessions through a SessionCache or an exported
+// session, and the server finds them in its own cache.
+
+var options = {
+  key: fs.readFileSync(common.fixturesDir + '/keys/agent2-key.pem'),
+  cert: fs.readFileSync(common.fixturesDir + '/keys/agent2-cert.pem'),
+  sessionCacheSize: 10,
+  sessionTimeout: 60
+};
+
+var cache = new tls.SessionCache(1);
+var reused = [];
+var clientReused = [];
+var firstSession;
+
+var server = tls.createServer(options, function(s) {
+  reused.push(s.isSessionReused());
+  s.end('ok');
+});
+
+function connect(options, cb) {
+  var c = tls.connect(common.PORT, '127.0.0.1', options, function() {
+    clientReused.push(c.isSessionReused());
+    if (!firstSession) firstSession = c.getSession();
+  });
+  c.on('data', function() {});
+  c.on('close', cb);
+}
+
+server.listen(common.PORT, function() {
+  connect({ sessionCache: cache }, function() {
+    assert.ok(Buffer.isBuffer(firstSession));
+    assert.equal(1, cache.keys.length);
+
+    connect({ sessionCache: cache }, function() {
+      // Exported session, without a cache.
+      connect({ session: firstSession, sessionCache: false }, function() {
+        var stats = server.getSessionStats();
+        assert.equal(10, stats.maxSize);
+        assert.equal(60, stats.timeout);
+        assert.equal(3, stats.acceptGood);
+        assert.equal(2, stats.hits);
+        server.close();
+      });
+    });
+  });
+});
+
+assert.throws(function() {
+  tls.connect(common.PORT, { session: new Buffer('junk') });
+});
+
+process.on('exit', function() {
+  assert.deepEqual([false, true, true], reused);
+  assert.deepEqual([false, true, true], clientReused);
+  assert.deepEqual({ handshakes: 2, resumed: 1 }, cache.stats);
+
+  // Only one session fits.
+  cache.set('a', new Buffer(1));
+  cache.set('b', new Buffer(1));
+  assert.equal(null, cache.get('a'));
+  assert.deepEqual(['b'], cache.keys);
+  cache.remove('b');
+  assert.deepEqual([], cache.keys);
+});
@@ -0,0 +1,62 @@
+var common = require('../common');
+var assert = require('assert');
+var tls = require('tls');
+var crypto = require('crypto');
+var fs = require('fs');
+
+// Credentials with the same content share one context.
+
+var key = fs.readFileSync(common.fixturesDir + '/keys/agent2-key.pem');
+var cert = fs.readFileSync(common.fixturesDir + '/keys/agent2-cert.pem');
+
+var cache = new crypto.CredentialsCache(2);
+
+var a = cache.get({ key: key, cert: cert });
+assert.strictEqual(a, cache.get({ key: key.toString(), cert: cert }));
+assert.strictEqual(a, cache.get({ key: new Buffer(key), cert: cert,
+                                  NPNProtocols: ['http/1.1'] }));
+assert.deepEqual({ hits: 2, misses: 1 }, cache.stats);
+
+var b = cache.get({ key: key, cert: cert, ciphers: 'AES128-SHA' });
+assert.notStrictEqual(a, b);
+assert.notStrictEqual(cache.get({ ca: [cert] }),
+                      cache.get({ ca: [cert, cert] }));
+assert.deepEqual({ hits: 2, misses: 4 }, cache.stats);
+
+// At most two, the least recently used goes.
+assert.equal(2, cache.keys.length);
+assert.notStrictEqual(a, cache.get({ key: key, cert: cert }));
+
+cache.clear();
+assert.equal(0, cache.keys.length);
+
+
+// tls.connect() takes its credentials from crypto.sharedCredentials.
+var server = tls.createServer({ key: key, cert: cert }, function(s) {
+  s.end();
+});
+
+var connections = 0;
+var misses;
+
+function connect(cb) {
+  var c = tls.connect(common.PORT, { sessionCache: false }, function() {
+    connections++;
+    c.end();
+    cb();
+  });
+}
+
+server.listen(common.PORT, function() {
+  connect(function() {
+    misses = crypto.sharedCredentials.stats.misses;
+    connect(function() {
+      assert.equal(misses, crypto.sharedCredentials.stats.misses);
+      server.close();
+    });
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(2, connections);
+});
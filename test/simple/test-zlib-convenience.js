@@ -0,0 +1,111 @@
+var common = require('../common');
+var assert = require('assert');
+var zlib = require('zlib');
+var http = require('http');
+
+// Round trips through every stream type, piped and one-shot.
+
+var text = new Array(10000).join('The quick brown fox jumps over the lazy dog. ');
+var data = new Buffer(text);
+
+var pairs = [
+  [zlib.createDeflate, zlib.createInflate],
+  [zlib.createGzip, zlib.createGunzip],
+  [zlib.createDeflateRaw, zlib.createInflateRaw],
+  [zlib.createDeflate, zlib.createUnzip],
+  [zlib.createGzip, zlib.createUnzip]
+];
+
+var roundTrips = 0;
+
+pairs.forEach(function(pair) {
+  // A small chunkSize makes the binding come back for more output.
+  var def = pair[0]({ level: zlib.Z_BEST_SPEED, chunkSize: 1024 });
+  var inf = pair[1]({ chunkSize: 512 });
+  var out = [];
+
+  def.pipe(inf);
+  inf.on('data', function(d) {
+    assert.ok(Buffer.isBuffer(d));
+    out.push(d.toString());
+  });
+  inf.on('end', function() {
+    assert.equal(text, out.join(''));
+    roundTrips++;
+  });
+
+  // Several writes, a flush in between.
+  def.write(data.slice(0, 1000));
+  def.flush();
+  def.write(data.slice(1000, 200000));
+  def.end(data.slice(200000));
+});
+
+zlib.gzip(data, function(err, compressed) {
+  assert.equal(null, err);
+  assert.ok(compressed.length < data.length / 10);
+  // gzip magic
+  assert.equal(0x1f, compressed[0]);
+  assert.equal(0x8b, compressed[1]);
+
+  zlib.gunzip(compressed, function(err, result) {
+    assert.equal(null, err);
+    assert.equal(text, result.toString());
+    roundTrips++;
+  });
+
+  zlib.unzip(compressed, function(err, result) {
+    assert.equal(null, err);
+    assert.equal(text, result.toString());
+    roundTrips++;
+  });
+});
+
+zlib.deflate(data, function(err, compressed) {
+  assert.equal(null, err);
+  zlib.unzip(compressed, function(err, result) {
+    assert.equal(null, err);
+    assert.equal(text, result.toString());
+    roundTrips++;
+  });
+});
+
+var errors = 0;
+zlib.inflate(new Buffer('this is not deflated'), function(err, result) {
+  assert.ok(err instanceof Error);
+  assert.equal(undefined, result);
+  errors++;
+});
+
+assert.throws(function() {
+  zlib.createGzip({ level: 42 });
+});
+
+
+// A gzipped HTTP response.
+var server = http.createServer(function(req, res) {
+  res.writeHead(200, { 'Content-Encoding': 'gzip' });
+  var gzip = zlib.createGzip();
+  gzip.pipe(res);
+  gzip.end(data);
+});
+
+server.listen(common.PORT, function() {
+  http.get({ port: common.PORT, path: '/' }, function(res) {
+    assert.equal('gzip', res.headers['content-encoding']);
+    var out = [];
+    var gunzip = zlib.createGunzip();
+    res.pipe(gunzip);
+    gunzip.on('data', function(d) { out.push(d.toString()); });
+    gunzip.on('end', function() {
+      assert.equal(text, out.join(''));
+      roundTrips++;
+      server.close();
+    });
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(9, roundTrips);
+  assert.equal(1, errors);
+});